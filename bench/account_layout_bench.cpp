@@ -0,0 +1,217 @@
+/*
+    Account layout benchmark
+    --------------------------------
+    Creates N accounts twice, once as Account and once in the layout
+    Account had before it was split (every field inline, 104 bytes on
+    8-byte alignment), and runs the same random-access balance reads and
+    locked deposits over both. Reports ns/op and, where the kernel
+    allows perf_event_open, cache misses per op.
+
+    A read touches only the Account line. A deposit also appends to the
+    history, which is in AccountCold for the split layout, so writes
+    gain less than reads.
+
+    Usage: account_layout_bench [accounts] [ops]
+*/
+
+#include "account.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Counts cache misses for the calling thread; inert if unavailable.
+class MissCounter
+{
+private:
+    int fd = -1;
+
+public:
+    MissCounter()
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~MissCounter()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start()
+    {
+        if (fd < 0)
+            return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+        if (fd < 0)
+            return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+};
+
+// Account's fields in their order before the hot/cold split.
+struct LegacyAccount
+{
+    int id;
+    string owner;
+    atomic<double> balance{0.0};
+    Currency currency = Currency::USD;
+    vector<Transaction> history;
+    atomic<uint64_t> version{0};
+    unique_ptr<SplitBalance> split;
+    size_t foldMark = 0;
+
+    LegacyAccount(int id, string owner) : id(id), owner(move(owner)) {}
+    LegacyAccount(LegacyAccount&& other) noexcept
+        : id(other.id), owner(move(other.owner)), balance(other.balance.load()),
+          history(move(other.history)), split(move(other.split)) {}
+
+    double getBalance() const
+    {
+        double b = balance.load(memory_order_relaxed);
+        return split ? b + split->total() : b;
+    }
+
+    void lock()
+    {
+        uint64_t v = version.load(memory_order_relaxed);
+        while ((v & 1) || !version.compare_exchange_weak(v, v + 1, memory_order_acquire))
+            v = version.load(memory_order_relaxed);
+    }
+    void unlock() { version.fetch_add(1, memory_order_release); }
+
+    void replay(const Transaction& t)
+    {
+        balance.store(balance.load(memory_order_relaxed) + balanceEffect(t), memory_order_relaxed);
+        history.push_back(t);
+    }
+};
+
+struct Timing
+{
+    double ns = 0.0;
+    double misses = -1.0;
+};
+
+template <typename F>
+static Timing measure(size_t ops, MissCounter& misses, F&& body)
+{
+    misses.start();
+    auto start = chrono::steady_clock::now();
+    body();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t count = misses.stop();
+
+    Timing t;
+    t.ns = secs * 1e9 / ops;
+    if (misses.available())
+        t.misses = static_cast<double>(count) / ops;
+    return t;
+}
+
+// Returns {balance reads, deposits}.
+template <typename A>
+static pair<Timing, Timing> run(vector<A>& accounts, const vector<int>& ids, MissCounter& misses)
+{
+    double sum = 0.0;
+    Timing reads = measure(ids.size(), misses, [&] {
+        for (int id : ids)
+            sum += accounts[static_cast<size_t>(id)].getBalance();
+    });
+
+    const Transaction t{"2024-01-01 00:00:00", "DEPOSIT", 1.0};
+    Timing deposits = measure(ids.size(), misses, [&] {
+        for (int id : ids)
+        {
+            A& acc = accounts[static_cast<size_t>(id)];
+            acc.lock();
+            acc.replay(t);
+            acc.unlock();
+        }
+    });
+
+    if (sum != 0.0)
+        fprintf(stderr, "unexpected starting balance\n");
+    return {reads, deposits};
+}
+
+static void report(const char* name, const Timing& legacy, const Timing& split)
+{
+    char legacyMisses[32] = "n/a";
+    char splitMisses[32] = "n/a";
+    if (legacy.misses >= 0.0)
+        snprintf(legacyMisses, sizeof(legacyMisses), "%.2f", legacy.misses);
+    if (split.misses >= 0.0)
+        snprintf(splitMisses, sizeof(splitMisses), "%.2f", split.misses);
+    printf("%-10s %12.1f %12.1f %14s %14s\n", name, legacy.ns, split.ns, legacyMisses, splitMisses);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t ops = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000000;
+
+    // Built in the same order, so both sets interleave alike with their
+    // owner strings and cold records.
+    vector<LegacyAccount> legacy;
+    vector<Account> split;
+    legacy.reserve(n);
+    split.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string owner = "owner-" + to_string(i);
+        split.emplace_back(static_cast<int>(i), owner);
+        legacy.emplace_back(static_cast<int>(i), move(owner));
+    }
+
+    mt19937 rng(42);
+    uniform_int_distribution<int> pick(0, static_cast<int>(n) - 1);
+    vector<int> ids(ops);
+    for (auto& id : ids)
+        id = pick(rng);
+
+    printf("accounts = %zu, sizeof(LegacyAccount) = %zu (align %zu), sizeof(Account) = %zu (align %zu)\n",
+           n, sizeof(LegacyAccount), alignof(LegacyAccount), sizeof(Account), alignof(Account));
+    printf("%-10s %12s %12s %14s %14s\n", "op", "legacy ns", "split ns", "legacy miss/op", "split miss/op");
+
+    MissCounter misses;
+    auto [splitReads, splitDeposits] = run(split, ids, misses);
+    auto [legacyReads, legacyDeposits] = run(legacy, ids, misses);
+    report("balance", legacyReads, splitReads);
+    report("deposit", legacyDeposits, splitDeposits);
+    return 0;
+}
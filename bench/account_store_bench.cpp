@@ -0,0 +1,185 @@
+/*
+    Account store benchmark
+    --------------------------------
+    Builds a disk-backed AccountStore far larger than its cache, then
+    runs deposits from several threads through caches of different
+    sizes and policies:
+
+        skewed  90% of deposits go to a hot 2% of accounts
+        scan    the skewed load, while another thread keeps reading
+                every account in order (a report or backup)
+
+    Reports operations per second, the cache hit rate, mean and
+    longest fault and p99 deposit latency for LRU and ARC. The scan
+    row shows whether the hot pages survive the scan.
+
+    Faults are served from the OS page cache here, not the device, so
+    fault latencies are a lower bound.
+
+    At the end the store is reopened with a tiny cache and every
+    balance is summed, which must equal the deposits made.
+
+    Usage: account_store_bench [accounts] [threads] [dir]
+*/
+
+#include "accountstore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct RunResult
+{
+    uint64_t deposits = 0;
+    double seconds = 0.0;
+    double p99Us = 0.0;
+    BufferPoolStats cache;
+};
+
+static RunResult runDeposits(const string& path, int accounts, size_t cachePages, CachePolicy policy,
+                             size_t threads, bool scan, double seconds)
+{
+    AccountStore store;
+    store.open(path, cachePages, policy);
+
+    int hot = max(1, accounts / 50);
+    atomic<bool> stop{false};
+    atomic<uint64_t> deposits{0};
+    mutex latencyMutex;
+    vector<double> latencies;
+
+    vector<thread> pool;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&, t] {
+            mt19937 rng(static_cast<unsigned>(t + 1));
+            uniform_int_distribution<int> hotId(1, hot);
+            uniform_int_distribution<int> anyId(1, accounts);
+            vector<double> mine;
+            uint64_t n = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                int id = rng() % 10 ? hotId(rng) : anyId(rng);
+                auto start = Clock::now();
+                store.deposit(id, 1.0);
+                if (n % 16 == 0)
+                    mine.push_back(secondsSince(start) * 1e6);
+                ++n;
+            }
+            deposits.fetch_add(n);
+            lock_guard<mutex> lock(latencyMutex);
+            latencies.insert(latencies.end(), mine.begin(), mine.end());
+        });
+    }
+
+    thread scanner;
+    if (scan)
+    {
+        scanner = thread([&] {
+            StoredAccount acc;
+            while (!stop.load(memory_order_relaxed))
+            {
+                for (int id = 1; id <= accounts && !stop.load(memory_order_relaxed); ++id)
+                    store.find(id, acc);
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    for (auto& t : pool)
+        t.join();
+    if (scan)
+        scanner.join();
+
+    RunResult r;
+    r.seconds = secondsSince(start);
+    r.deposits = deposits.load();
+    r.cache = store.cacheStats();
+    sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+        r.p99Us = latencies[latencies.size() * 99 / 100];
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4;
+    string dir = argc > 3 ? argv[3] : "/tmp";
+    string path = dir + "/account_store_bench.pages";
+    remove(path.c_str());
+
+    auto start = Clock::now();
+    {
+        AccountStore store;
+        if (!store.open(path, 1024))
+        {
+            fprintf(stderr, "cannot open %s\n", path.c_str());
+            return 1;
+        }
+        for (int i = 0; i < accounts; ++i)
+            store.createAccount("Customer " + to_string(i));
+        store.flush();
+    }
+    size_t pages = (static_cast<size_t>(accounts) + 63) / 64 + 1;
+    printf("%d accounts, %zu pages (%.1f MiB) created in %.2f s\n\n", accounts, pages,
+           pages * PAGE_SIZE / 1048576.0, secondsSince(start));
+
+    printf("%-7s %-6s %8s %12s %9s %10s %10s %10s\n", "load", "policy", "cache", "deposits/s",
+           "hit rate", "fault us", "max us", "p99 us");
+    uint64_t total = 0;
+    for (size_t percent : {2, 10})
+    {
+        size_t cachePages = max<size_t>(pages * percent / 100, 4 * threads);
+        for (bool scan : {false, true})
+        {
+            for (CachePolicy policy : {CachePolicy::Lru, CachePolicy::Arc})
+            {
+                RunResult r = runDeposits(path, accounts, cachePages, policy, threads, scan, 1.0);
+                total += r.deposits;
+                char cache[16];
+                snprintf(cache, sizeof(cache), "%zu%%", percent);
+                printf("%-7s %-6s %8s %12.0f %8.1f%% %10.2f %10.1f %10.1f\n", scan ? "scan" : "skewed",
+                       policy == CachePolicy::Arc ? "ARC" : "LRU", cache, r.deposits / r.seconds,
+                       100.0 * r.cache.hitRate(), r.cache.meanFaultUs(), r.cache.maxFaultNs / 1e3, r.p99Us);
+            }
+        }
+    }
+
+    // Every deposit must have reached the file.
+    AccountStore store;
+    store.open(path, 8);
+    double sum = 0.0;
+    StoredAccount acc;
+    for (int id = 1; id <= accounts; ++id)
+    {
+        if (store.find(id, acc))
+            sum += acc.balance;
+    }
+    store.close();
+    remove(path.c_str());
+
+    bool ok = sum == static_cast<double>(total);
+    printf("\nbalances after reopen: %.0f of %llu deposits\n", sum, static_cast<unsigned long long>(total));
+    if (!ok)
+        fprintf(stderr, "deposits were lost\n");
+    return ok ? 0 : 1;
+}
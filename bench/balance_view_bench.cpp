@@ -0,0 +1,125 @@
+/*
+    Shared-memory balance view benchmark
+    --------------------------------
+    Publishes a bank's balances as a shared-memory view, forks a reader
+    process that maps it read-only and reads random balances while the
+    parent keeps depositing, and reports ns per read. Also reports the
+    cost the view adds to each deposit.
+
+    Usage: balance_view_bench [accounts] [reads]
+*/
+
+#include "bank.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static double depositNs(Bank& bank, const vector<int>& ids)
+{
+    auto start = chrono::steady_clock::now();
+    for (int id : ids)
+        bank.deposit(id, 1.0);
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ids.size();
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    size_t reads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000000;
+    string name = "/balance_view_bench." + to_string(getpid());
+
+    Bank bank("", "");
+    for (size_t i = 0; i < n; ++i)
+        bank.createAccount("reader-" + to_string(i));
+
+    mt19937 rng(1);
+    uniform_int_distribution<int> pick(1, static_cast<int>(n));
+    vector<int> ids(200000);
+    for (auto& id : ids)
+        id = pick(rng);
+
+    double plain = depositNs(bank, ids);
+    if (!bank.publishBalanceView(name))
+    {
+        fprintf(stderr, "cannot create shared memory segment %s\n", name.c_str());
+        return 1;
+    }
+    double published = depositNs(bank, ids);
+
+    int pipeFd[2];
+    if (pipe(pipeFd) != 0)
+        return 1;
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(pipeFd[0]);
+        BalanceViewReader view;
+        if (!view.open(name))
+            _exit(1);
+
+        // Precomputed ids, so the loop measures the read alone.
+        vector<int> order(1 << 16);
+        mt19937 r(2);
+        for (auto& id : order)
+            id = pick(r);
+
+        double sum = 0.0;
+        size_t found = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < reads; ++i)
+        {
+            double balance;
+            Currency currency;
+            if (view.read(order[i & (order.size() - 1)], balance, currency))
+            {
+                sum += balance;
+                ++found;
+            }
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / reads;
+
+        char line[128];
+        int len = snprintf(line, sizeof(line), "%.1f %zu %.0f\n", ns, found, sum);
+        if (write(pipeFd[1], line, static_cast<size_t>(len)) != len)
+            _exit(1);
+        _exit(0);
+    }
+    close(pipeFd[1]);
+
+    // Keep writing while the child reads.
+    size_t rounds = 0;
+    int status = 0;
+    while (waitpid(child, &status, WNOHANG) == 0)
+    {
+        depositNs(bank, ids);
+        ++rounds;
+    }
+
+    char line[128] = {};
+    if (read(pipeFd[0], line, sizeof(line) - 1) <= 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "reader failed\n");
+        return 1;
+    }
+
+    double readNs;
+    size_t found;
+    sscanf(line, "%lf %zu", &readNs, &found);
+    printf("accounts %zu, reader process %zu reads (%zu found) during %zu deposit rounds\n",
+           n, reads, found, rounds);
+    printf("read from view      %8.1f ns\n", readNs);
+    printf("deposit             %8.1f ns\n", plain);
+    printf("deposit + publish   %8.1f ns\n", published);
+    return found == reads ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+/*
+    Account filter benchmark
+    --------------------------------
+    First measures BlockedBloomFilter alone at several sizes: lookups
+    per second for present and absent keys, the false-positive rate
+    and the memory per key. Every inserted key must test present.
+
+    Then runs a SessionServer where half of all deposits name ids that
+    do not exist, as a batch of stale references would. Reports p50/p99
+    latency of the hits and of the misses separately; misses are
+    answered from the filter without queueing for the bank lock. Checks
+    that every miss returned AccountNotFound and every hit was credited.
+
+    Usage: bloom_filter_bench [keys] [threads]
+*/
+
+#include "bloom.h"
+#include "session.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool filterRun(size_t keys, double bitsPerKey)
+{
+    BlockedBloomFilter filter(keys, bitsPerKey);
+    for (size_t k = 0; k < keys; ++k)
+        filter.insert(k + 1);
+
+    // Present keys in random order, so lookups are not sequential.
+    vector<uint64_t> probes(keys);
+    mt19937_64 rng(7);
+    for (auto& p : probes)
+        p = rng() % keys + 1;
+
+    auto start = Clock::now();
+    size_t present = 0;
+    for (uint64_t p : probes)
+        present += filter.mayContain(p);
+    double hitSeconds = secondsSince(start);
+
+    start = Clock::now();
+    size_t falsePositives = 0;
+    for (uint64_t p : probes)
+        falsePositives += filter.mayContain(p + keys);
+    double missSeconds = secondsSince(start);
+
+    printf("%10zu %8.1f %14.0f %14.0f %9.3f%% %10.2f\n", keys, bitsPerKey, keys / hitSeconds,
+           keys / missSeconds, 100.0 * falsePositives / keys, 8.0 * filter.bytes() / keys);
+    return present == keys;
+}
+
+// ========================================
+// Session server
+// ========================================
+
+struct Latencies
+{
+    mutex latencyMutex;
+    vector<double> hitsUs;
+    vector<double> missesUs;
+    atomic<uint64_t> wrongMisses{0};
+};
+
+static Task<void> session(SessionServer& server, int accounts, uint64_t seed, int deposits,
+                          Latencies& out)
+{
+    mt19937_64 rng(seed);
+    vector<double> hits, misses;
+    for (int i = 0; i < deposits; ++i)
+    {
+        bool miss = rng() & 1;
+        int id = miss ? accounts + 1 + static_cast<int>(rng() % 1000000)
+                      : 1 + static_cast<int>(rng() % static_cast<uint64_t>(accounts));
+        auto start = Clock::now();
+        Result r = co_await server.deposit(id, 1.0);
+        (miss ? misses : hits).push_back(secondsSince(start) * 1e6);
+        if (miss != (r == Result::AccountNotFound))
+            out.wrongMisses.fetch_add(1);
+    }
+    lock_guard<mutex> lock(out.latencyMutex);
+    out.hitsUs.insert(out.hitsUs.end(), hits.begin(), hits.end());
+    out.missesUs.insert(out.missesUs.end(), misses.begin(), misses.end());
+}
+
+static void printLatencies(const char* name, vector<double>& us)
+{
+    sort(us.begin(), us.end());
+    if (us.empty())
+        return;
+    printf("%-8s %10zu %10.1f %10.1f\n", name, us.size(), us[us.size() / 2], us[us.size() * 99 / 100]);
+}
+
+static bool serverRun(int accounts, size_t threads)
+{
+    const int SESSIONS = 2000;
+    const int DEPOSITS = 100;
+
+    Bank bank("", "");
+    for (int i = 0; i < accounts; ++i)
+        bank.createAccount("Customer " + to_string(i));
+
+    Latencies lat;
+    double seconds;
+    {
+        SessionServer server(bank, threads);
+        auto start = Clock::now();
+        for (int s = 0; s < SESSIONS; ++s)
+            server.spawn(session(server, accounts, s + 1, DEPOSITS, lat));
+        server.waitIdle();
+        seconds = secondsSince(start);
+    }
+
+    double credited = 0.0;
+    for (int id = 1; id <= accounts; ++id)
+        credited += bank.findAccount(id)->getBalance();
+
+    printf("\n%d accounts, %d deposits in %.3f s (%.0f/s), half to missing ids\n", accounts,
+           SESSIONS * DEPOSITS, seconds, SESSIONS * DEPOSITS / seconds);
+    printf("%-8s %10s %10s %10s\n", "deposit", "count", "p50 us", "p99 us");
+    printLatencies("hit", lat.hitsUs);
+    printLatencies("miss", lat.missesUs);
+    return lat.wrongMisses.load() == 0 && credited == static_cast<double>(lat.hitsUs.size());
+}
+
+int main(int argc, char** argv)
+{
+    size_t keys = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4;
+
+    printf("%10s %8s %14s %14s %10s %10s\n", "keys", "bits/key", "hits/s", "misses/s", "false pos",
+           "bits used");
+    bool ok = true;
+    for (double bits : {8.0, 10.0, 16.0})
+        ok = filterRun(keys, bits) && ok;
+    ok = filterRun(keys * 10, 10.0) && ok;
+    if (!ok)
+        fprintf(stderr, "an inserted key tested absent\n");
+
+    if (!serverRun(static_cast<int>(min<size_t>(keys, 100000)), threads))
+    {
+        fprintf(stderr, "a deposit was misclassified or lost\n");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+    Change feed benchmark
+    --------------------------------
+    A producer thread makes deposits against a journaled bank with the
+    change feed enabled, syncing the journal every `batch` deposits,
+    while a consumer tails the feed. Reports end-to-end latency from a
+    sync returning to the consumer holding its events, and consumer
+    throughput. The consumer also checks that sequence numbers arrive
+    in order with no gaps.
+
+    Usage: changefeed_bench [deposits] [batch]
+*/
+
+#include "bank.h"
+#include "changefeed.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+int main(int argc, char** argv)
+{
+    size_t deposits = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t batch = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100;
+    batch = max<size_t>(batch, 1);
+
+    char dir[] = "/tmp/changefeed_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    string data = string(dir) + "/bank_data.txt";
+    string rates = string(dir) + "/fx_rates.txt";
+    string feed = data + ".cdc";
+    string offsets = string(dir) + "/consumer.offset";
+
+    vector<double> latencies;
+    size_t received = 0;
+    size_t gaps = 0;
+    double consumeSecs = 0.0;
+    {
+        Bank bank(data, rates);
+        bank.enableChangeFeed();
+        int id = bank.createAccount("feed");
+        bank.syncJournal();
+        uint64_t firstSeq = bank.journalSeq() + 1;
+
+        // Time each sync returned, indexed by the last seq it covered.
+        size_t syncs = (deposits + batch - 1) / batch;
+        vector<uint64_t> syncSeq(syncs);
+        vector<atomic<int64_t>> syncTime(syncs);
+        atomic<size_t> published{0};
+
+        thread consumer([&] {
+            ChangeConsumer c;
+            c.open(feed, offsets);
+            vector<ChangeEvent> events;
+            uint64_t expect = 0;
+            size_t nextSync = 0;
+            auto start = Clock::now();
+            while (received < deposits + 1)
+            {
+                c.wait(100);
+                events.clear();
+                c.poll(events);
+                int64_t now = Clock::now().time_since_epoch().count();
+                for (const auto& e : events)
+                {
+                    if (expect && e.seq != expect)
+                        ++gaps;
+                    expect = e.seq + 1;
+                    ++received;
+
+                    while (nextSync < published.load(memory_order_acquire) && syncSeq[nextSync] <= e.seq)
+                    {
+                        if (syncSeq[nextSync] == e.seq)
+                            latencies.push_back((now - syncTime[nextSync].load()) / 1e3);
+                        ++nextSync;
+                    }
+                }
+                c.commit();
+            }
+            consumeSecs = chrono::duration<double>(Clock::now() - start).count();
+        });
+
+        for (size_t s = 0; s < syncs; ++s)
+        {
+            size_t n = min(batch, deposits - s * batch);
+            for (size_t i = 0; i < n; ++i)
+                bank.deposit(id, 1.0);
+            syncSeq[s] = bank.journalSeq();
+            uint64_t durable = bank.syncJournal();
+            syncTime[s].store(Clock::now().time_since_epoch().count());
+            published.store(s + 1, memory_order_release);
+            if (durable < syncSeq[s])
+                fprintf(stderr, "sync did not cover seq %llu\n", static_cast<unsigned long long>(syncSeq[s]));
+        }
+        consumer.join();
+        (void)firstSeq;
+    }
+
+    sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    printf("events %zu, gaps %zu, consumer %.0f events/s\n", received, gaps, received / consumeSecs);
+    printf("sync -> consumer latency (us): p50 %.0f  p99 %.0f  max %.0f\n",
+           pct(0.50), pct(0.99), latencies.empty() ? 0.0 : latencies.back());
+
+    unlink(data.c_str());
+    unlink(rates.c_str());
+    unlink((data + ".journal").c_str());
+    unlink(feed.c_str());
+    unlink(offsets.c_str());
+    rmdir(dir);
+    return gaps == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+    Checkpoint benchmark
+    --------------------------------
+    Builds a journaled bank of N accounts with some history, keeps a
+    thread depositing into it, and takes a snapshot twice: with the
+    blocking save() and with checkpointInBackground(). For each it
+    reports how long the bank was paused, how long the snapshot took to
+    become durable, and the deposits completed and the slowest single
+    deposit meanwhile. Afterwards the bank is reloaded from the
+    checkpoint and its journals to check that no deposit was lost.
+
+    Usage: checkpoint_bench [accounts]
+*/
+
+#include "bank.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+struct Depositor
+{
+    Bank& bank;
+    int accounts;
+    atomic<bool> stop{false};
+    atomic<uint64_t> deposits{0};
+    atomic<uint64_t> slowestNs{0};
+    thread worker;
+
+    Depositor(Bank& bank, int accounts) : bank(bank), accounts(accounts)
+    {
+        worker = thread([this]() {
+            uint64_t i = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                auto start = chrono::steady_clock::now();
+                this->bank.deposit(static_cast<int>(i++ % this->accounts) + 1, 1.0);
+                uint64_t ns = static_cast<uint64_t>(
+                    chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+                if (ns > slowestNs.load(memory_order_relaxed))
+                    slowestNs.store(ns, memory_order_relaxed);
+                deposits.fetch_add(1, memory_order_relaxed);
+            }
+        });
+    }
+
+    ~Depositor()
+    {
+        stop.store(true);
+        worker.join();
+    }
+
+    void resetWindow()
+    {
+        deposits.store(0);
+        slowestNs.store(0);
+    }
+};
+
+static void report(const char* mode, double pauseMs, double totalMs, const Depositor& d)
+{
+    printf("%-12s %10.2f %10.1f %12llu %14.2f\n", mode, pauseMs, totalMs,
+           static_cast<unsigned long long>(d.deposits.load()), d.slowestNs.load() / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+
+    char dir[] = "/tmp/checkpoint_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    string data = string(dir) + "/bank_data.txt";
+    string rates = string(dir) + "/fx_rates.txt";
+
+    double expected = 0.0;
+    {
+        Bank bank(data, rates);
+        for (int i = 0; i < n; ++i)
+        {
+            int id = bank.createAccount("Customer " + to_string(i), static_cast<Currency>(i % CURRENCY_COUNT));
+            for (int t = 0; t < 4; ++t)
+                bank.deposit(id, 25.0);
+        }
+        bank.save();
+
+        printf("%-12s %10s %10s %12s %14s\n", "snapshot", "pause ms", "total ms", "deposits", "slowest ms");
+        {
+            Depositor depositor(bank, n);
+            this_thread::sleep_for(chrono::milliseconds(50));
+
+            depositor.resetWindow();
+            auto start = chrono::steady_clock::now();
+            bank.save();
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            report("save", ms, ms, depositor);
+
+            depositor.resetWindow();
+            start = chrono::steady_clock::now();
+            CheckpointReport checkpoint = bank.checkpointInBackground();
+            bool ok = checkpoint.started && bank.waitForCheckpoint();
+            ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            report("background", checkpoint.pauseMs, ms, depositor);
+            if (!ok)
+                fprintf(stderr, "background checkpoint failed\n");
+
+            this_thread::sleep_for(chrono::milliseconds(50));
+        }
+
+        // Keep the files as a crash would leave them: the checkpoint plus
+        // the journal written after it.
+        bank.syncJournal();
+        for (const auto& acc : bank.getAccounts())
+            expected += acc.getBalance();
+        filesystem::copy_file(data, data + ".recover");
+        filesystem::copy_file(data + ".journal", data + ".recover.journal");
+    }
+
+    {
+        Bank recovered(data + ".recover", rates);
+        double total = 0.0;
+        for (const auto& acc : recovered.getAccounts())
+            total += acc.getBalance();
+        if (recovered.getAccounts().size() != static_cast<size_t>(n) || fabs(total - expected) > 1e-6 * expected)
+            fprintf(stderr, "recovery: %zu accounts, total %.2f, expected %.2f\n",
+                    recovered.getAccounts().size(), total, expected);
+        else
+            printf("recovered %zu accounts from checkpoint + journal\n", recovered.getAccounts().size());
+    }
+
+    filesystem::remove_all(dir);
+    return 0;
+}
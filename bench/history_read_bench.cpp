@@ -0,0 +1,191 @@
+/*
+    History read benchmark and reclamation stress
+    --------------------------------
+    Reader threads copy the histories of random accounts while writer
+    threads keep depositing into them, first through the account lock
+    (how Bank::history() used to read) and then through the lock-free
+    epoch-protected path. Reports reads, entries copied and deposits
+    per second for each.
+
+    Every read is checked: each writer deposits 1, 2, 3, ... into its
+    own accounts, so a history must be exactly that sequence and never
+    shorter than an earlier read of the same account. A final stress
+    run adds a thread creating accounts (replacing the history index)
+    and a hot account whose folds rewrite history chunks under a
+    reader. At the end every retired object must have been freed.
+
+    Usage: history_read_bench [readers] [seconds]
+*/
+
+#include "bank.h"
+#include "epoch.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const int ACCOUNTS = 4096;
+static const int WRITERS = 2;
+
+enum class Mode
+{
+    Locked,
+    Epoch,
+    Stress
+};
+
+struct Totals
+{
+    atomic<uint64_t> reads{0};
+    atomic<uint64_t> entries{0};
+    atomic<uint64_t> deposits{0};
+    atomic<uint64_t> errors{0};
+};
+
+static bool checkSequence(const vector<Transaction>& history, size_t& lastSize)
+{
+    if (history.size() < lastSize)
+        return false;
+    lastSize = history.size();
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        if (history[i].type != "DEPOSIT" || history[i].amount != static_cast<double>(i + 1))
+            return false;
+    }
+    return true;
+}
+
+static void run(Mode mode, size_t readers, double seconds)
+{
+    Bank bank("", "");
+    for (int i = 0; i < ACCOUNTS; ++i)
+        bank.createAccount("Customer " + to_string(i));
+    int hotId = bank.createAccount("Merchant");
+    bank.setHotAccount(hotId, true);
+
+    Totals totals;
+    atomic<bool> stop{false};
+    vector<thread> threads;
+
+    for (int w = 0; w < WRITERS; ++w)
+    {
+        threads.emplace_back([&, w] {
+            vector<int> next(ACCOUNTS, 1);
+            uint64_t n = 0;
+            for (int i = w; !stop.load(memory_order_relaxed); i = (i + WRITERS) % ACCOUNTS)
+            {
+                bank.deposit(i + 1, next[i]++);
+                ++n;
+            }
+            totals.deposits.fetch_add(n);
+        });
+    }
+
+    for (size_t r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&, r] {
+            mt19937 rng(static_cast<unsigned>(r + 1));
+            uniform_int_distribution<int> pick(1, ACCOUNTS);
+            vector<size_t> seen(ACCOUNTS + 1, 0);
+            vector<Transaction> history;
+            uint64_t n = 0;
+            uint64_t entries = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                int id = pick(rng);
+                if (mode != Mode::Locked)
+                {
+                    bank.history(id, history);
+                }
+                else
+                {
+                    Account* acc = bank.findAccount(id);
+                    acc->lock();
+                    history.clear();
+                    acc->getHistory().forEach([&](const Transaction& t) { history.push_back(t); });
+                    acc->unlock();
+                }
+                if (!checkSequence(history, seen[id]))
+                    totals.errors.fetch_add(1);
+                ++n;
+                entries += history.size();
+            }
+            totals.reads.fetch_add(n);
+            totals.entries.fetch_add(entries);
+        });
+    }
+
+    if (mode == Mode::Stress)
+    {
+        // Grows the history index while it is being read.
+        threads.emplace_back([&] {
+            for (int i = 0; !stop.load(memory_order_relaxed); ++i)
+            {
+                bank.createAccount("Late " + to_string(i));
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+        });
+
+        // Deposits into the hot account's slots and withdrawals through
+        // its lock interleave, so each fold rewrites the history tail.
+        threads.emplace_back([&] {
+            while (!stop.load(memory_order_relaxed))
+            {
+                bank.deposit(hotId, 2.0);
+                bank.deposit(hotId, 2.0);
+                bank.withdraw(hotId, 1.0);
+            }
+        });
+        threads.emplace_back([&] {
+            const HistoryLog& log = bank.findAccount(hotId)->getHistory();
+            vector<Transaction> history;
+            size_t last = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                log.read(history);
+                bool ok = history.size() >= last;
+                for (const auto& t : history)
+                    ok = ok && (t.type == "DEPOSIT" || t.type == "WITHDRAW");
+                if (!ok)
+                    totals.errors.fetch_add(1);
+                last = history.size();
+            }
+        });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    for (auto& t : threads)
+        t.join();
+
+    const char* name = mode == Mode::Locked ? "locked" : mode == Mode::Epoch ? "epoch" : "stress";
+    printf("%-8s %8zu %12.0f %14.0f %12.0f %8llu\n", name, readers,
+           totals.reads.load() / seconds, totals.entries.load() / seconds,
+           totals.deposits.load() / seconds, static_cast<unsigned long long>(totals.errors.load()));
+}
+
+int main(int argc, char** argv)
+{
+    size_t readers = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+    printf("%-8s %8s %12s %14s %12s %8s\n", "reads", "readers", "reads/s", "entries/s",
+           "deposits/s", "errors");
+    run(Mode::Locked, readers, seconds);
+    run(Mode::Epoch, readers, seconds);
+    run(Mode::Stress, readers, seconds);
+
+    EpochDomain& domain = EpochDomain::shared();
+    domain.collect();
+    printf("retired %llu, freed %llu\n", static_cast<unsigned long long>(domain.retired()),
+           static_cast<unsigned long long>(domain.freed()));
+    if (domain.freed() != domain.retired())
+        fprintf(stderr, "retired objects were not freed\n");
+    return 0;
+}
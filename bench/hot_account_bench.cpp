@@ -0,0 +1,61 @@
+/*
+    Hot-account deposit benchmark
+    --------------------------------
+    All threads deposit into one account, first as a regular account
+    (every deposit takes the account lock) and then with the account
+    designated hot (per-core split balance). Reports deposits per second
+    for each thread count.
+
+    Usage: hot_account_bench [max_threads] [deposits_per_thread]
+*/
+
+#include "bank.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static double run(bool hot, size_t threads, size_t deposits)
+{
+    Bank bank("", "");
+    int id = bank.createAccount("merchant");
+    if (hot)
+        bank.setHotAccount(id, true);
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&] {
+            for (size_t i = 0; i < deposits; ++i)
+                bank.deposit(id, 1.0);
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<Transaction> history;
+    bank.history(id, history);
+    double expected = static_cast<double>(threads * deposits);
+    if (fabs(bank.findAccount(id)->getBalance() - expected) > 0.5 || history.size() != threads * deposits)
+        fprintf(stderr, "lost deposits (hot=%d, threads=%zu)\n", hot, threads);
+
+    return expected / secs;
+}
+
+int main(int argc, char** argv)
+{
+    size_t maxThreads = argc > 1 ? strtoul(argv[1], nullptr, 10) : thread::hardware_concurrency();
+    size_t deposits = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000;
+
+    printf("%8s %14s %14s\n", "threads", "regular ops/s", "hot ops/s");
+    for (size_t t = 1; t <= max<size_t>(maxThreads, 1); t *= 2)
+        printf("%8zu %14.0f %14.0f\n", t, run(false, t, deposits), run(true, t, deposits));
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+    Bulk import benchmark
+    --------------------------------
+    Generates an onboarding file of N accounts in CSV and in binary form,
+    imports each into a fresh bank (in-memory, then journaled) and
+    reports accounts per second. The journaled import is reloaded from
+    its journal to check that every account and balance came back.
+
+    Usage: import_bench [accounts]
+*/
+
+#include "bank.h"
+#include "import.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+static void writeFile(const string& path, const string& data)
+{
+    ofstream out(path, ios::binary);
+    out << data;
+}
+
+static void run(const char* format, const string& path, size_t n, const string& dir, bool journaled)
+{
+    string data = journaled ? dir + "/bank_data.txt" : "";
+    string rates = journaled ? dir + "/fx_rates.txt" : "";
+
+    double secs;
+    size_t imported;
+    {
+        Bank bank(data, rates);
+        auto start = chrono::steady_clock::now();
+        ImportReport report = bank.importAccounts(path);
+        bank.syncJournal();
+        secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        imported = report.imported;
+        if (report.rejected != 0 || imported != n)
+            fprintf(stderr, "%s: imported %zu, rejected %zu\n", format, imported, report.rejected);
+
+        // Keep the journal as a crash would leave it, before the
+        // destructor's snapshot supersedes it.
+        if (journaled)
+            filesystem::copy_file(data + ".journal", data + ".recover.journal");
+    }
+
+    if (journaled)
+    {
+        {
+            Bank recovered(data + ".recover", rates);
+            double total = 0.0;
+            for (const auto& acc : recovered.getAccounts())
+                total += acc.getBalance();
+            if (recovered.getAccounts().size() != n || fabs(total - n * 10.0) > 1e-3 * n)
+                fprintf(stderr, "%s: journal replay recovered %zu accounts\n", format,
+                        recovered.getAccounts().size());
+        }
+        unlink((data + ".recover").c_str());
+        unlink((data + ".recover.journal").c_str());
+    }
+
+    printf("%-8s %-10s %10zu %10.1f %14.0f\n", format, journaled ? "journaled" : "memory",
+           imported, secs * 1e3, imported / secs);
+
+    unlink(data.c_str());
+    unlink(rates.c_str());
+    unlink((data + ".journal").c_str());
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+
+    char dir[] = "/tmp/import_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+
+    // Every account opens with 10.00, so balances can be checked after
+    // replay.
+    string csv = "owner,balance,currency\n";
+    string bin(BINARY_IMPORT_MAGIC);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string owner = "Partner Customer " + to_string(i % 50000);
+        Currency c = static_cast<Currency>(i % CURRENCY_COUNT);
+        csv += owner + ",10.00," + currencyCode(c) + "\n";
+        appendBinaryImportRecord(bin, owner, 10.0, c);
+    }
+
+    string csvPath = string(dir) + "/accounts.csv";
+    string binPath = string(dir) + "/accounts.bin";
+    writeFile(csvPath, csv);
+    writeFile(binPath, bin);
+
+    printf("%-8s %-10s %10s %10s %14s\n", "format", "bank", "accounts", "ms", "accounts/s");
+    run("csv", csvPath, n, dir, false);
+    run("binary", binPath, n, dir, false);
+    run("csv", csvPath, n, dir, true);
+    run("binary", binPath, n, dir, true);
+
+    unlink(csvPath.c_str());
+    unlink(binPath.c_str());
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+    Journal buffer benchmark
+    --------------------------------
+    Runs deposits, withdrawals and transfers from several threads
+    against a journaled bank, while a flusher thread syncs the journal
+    every millisecond the way PersistenceQueue does. Reports
+    throughput, per-operation latency percentiles, and how the
+    per-thread journal buffers batched: records per batch, batches
+    handed off early to keep an account's records in order, and the
+    batching window (how long a record waited before it reached the
+    journal).
+
+    Then it reads the journal file back and checks that every account's
+    records appear in the same order as its history.
+
+    Usage: journal_buffer_bench [threads] [accounts] [ops_per_thread]
+*/
+
+#include "bank.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double percentile(vector<double>& v, double p)
+{
+    if (v.empty())
+        return 0.0;
+    size_t k = static_cast<size_t>(p * (v.size() - 1));
+    nth_element(v.begin(), v.begin() + static_cast<long>(k), v.end());
+    return v[k];
+}
+
+// (type, amount) per account, in journal order.
+using Entries = vector<vector<pair<string, double>>>;
+
+static vector<string> fields(const string& line)
+{
+    vector<string> f;
+    size_t pos = 0;
+    while (true)
+    {
+        size_t bar = line.find('|', pos);
+        f.push_back(line.substr(pos, bar - pos));
+        if (bar == string::npos)
+            return f;
+        pos = bar + 1;
+    }
+}
+
+static Entries journalEntries(const string& path, int accounts)
+{
+    Entries entries(static_cast<size_t>(accounts) + 1);
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+    {
+        vector<string> f = fields(line);
+        if (f.size() == 6 && f[1] == "X")
+            entries[static_cast<size_t>(stoi(f[2]))].emplace_back(f[4], stod(f[5]));
+        else if (f.size() == 7 && f[1] == "T")
+        {
+            entries[static_cast<size_t>(stoi(f[2]))].emplace_back("TRANSFER_OUT", stod(f[5]));
+            entries[static_cast<size_t>(stoi(f[3]))].emplace_back("TRANSFER_IN", stod(f[6]));
+        }
+    }
+    return entries;
+}
+
+int main(int argc, char** argv)
+{
+    size_t threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+    int accounts = argc > 2 ? atoi(argv[2]) : 1000;
+    size_t ops = argc > 3 ? strtoul(argv[3], nullptr, 10) : 200000;
+
+    char dir[] = "/tmp/journal_buffer_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    string data = string(dir) + "/bank_data.txt";
+    string rates = string(dir) + "/fx_rates.txt";
+
+    bool ordered = true;
+    {
+        Bank bank(data, rates);
+        for (int i = 0; i < accounts; ++i)
+            bank.createAccount("acct-" + to_string(i));
+        bank.syncJournal();
+
+        atomic<bool> running{true};
+        thread flusher([&] {
+            while (running.load())
+            {
+                bank.syncJournal();
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
+
+        vector<vector<double>> latencies(threads);
+        auto start = Clock::now();
+        vector<thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t] {
+                mt19937 rng(static_cast<unsigned>(t) * 7919 + 1);
+                auto& lat = latencies[t];
+                lat.reserve(ops);
+                for (size_t i = 0; i < ops; ++i)
+                {
+                    int a = 1 + static_cast<int>(rng() % static_cast<unsigned>(accounts));
+                    int b = 1 + static_cast<int>(rng() % static_cast<unsigned>(accounts));
+                    double amount = 1.0 + static_cast<double>(rng() % 100);
+                    unsigned kind = rng() % 10;
+
+                    auto t0 = Clock::now();
+                    if (kind < 7)
+                        bank.deposit(a, amount);
+                    else if (kind < 8)
+                        bank.withdraw(a, amount);
+                    else
+                        bank.transfer(a, b, amount);
+                    lat.push_back(chrono::duration<double, micro>(Clock::now() - t0).count());
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+        running = false;
+        flusher.join();
+        bank.syncJournal();
+
+        vector<double> all;
+        for (auto& l : latencies)
+            all.insert(all.end(), l.begin(), l.end());
+        JournalBufferStats st = bank.journalBufferStats();
+        printf("%zu threads, %d accounts, %zu ops\n", threads, accounts, all.size());
+        printf("  %.0f ops/s, latency p50 %.2f us, p99 %.2f us, max %.1f us\n", all.size() / seconds,
+               percentile(all, 0.50), percentile(all, 0.99), *max_element(all.begin(), all.end()));
+        printf("  %llu batches, %.1f records/batch, %llu handoffs, window mean %.1f us, max %.1f us\n",
+               static_cast<unsigned long long>(st.batches), st.recordsPerBatch(),
+               static_cast<unsigned long long>(st.handoffs), st.meanWindowUs(), st.maxWindowNs / 1e3);
+
+        // Every account's journal records must follow its history.
+        Entries journaled = journalEntries(data + ".journal", accounts);
+        size_t checked = 0;
+        for (int id = 1; id <= accounts; ++id)
+        {
+            vector<Transaction> history;
+            bank.history(id, history);
+            const auto& records = journaled[static_cast<size_t>(id)];
+            ordered = ordered && records.size() == history.size();
+            for (size_t i = 0; ordered && i < history.size(); ++i)
+                ordered = records[i].first == history[i].type && records[i].second == history[i].amount;
+            checked += records.size();
+        }
+        printf("  journal order per account: %s (%zu records)\n", ordered ? "ok" : "WRONG", checked);
+    }
+
+    for (const char* name : {"/bank_data.txt", "/bank_data.txt.journal", "/bank_data.txt.journal.old",
+                             "/bank_data.txt.index", "/fx_rates.txt", "/bank_data.txt.tmp"})
+        remove((string(dir) + name).c_str());
+    rmdir(dir);
+    return ordered ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/*
+    LSM history benchmark
+    --------------------------------
+    Appends transactions to random accounts from several threads into a
+    HistoryStore, then reads whole histories back:
+
+        lsm append      appends from every thread; flushes and
+                        compactions run in the background
+        btree append    the same appends, one thread, into a
+                        StorageEngine history table for comparison
+        reads           one random account's whole history
+        absent reads    accounts that have no history: the run filters
+                        answer most of them
+        reopen          close and open again, check every history, and
+                        check that appends carry on the numbering
+
+    Reports appends per second, write amplification (bytes written by
+    flushes and compactions over bytes flushed), stalls, and the runs
+    the reads searched and skipped.
+
+    Usage: lsm_history_bench [accounts] [appends] [threads] [dir]
+*/
+
+#include "lsm.h"
+#include "storage.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The amount records who appended it, so reads can check each account's
+// transactions are in order: per thread, the counters only rise.
+static Transaction transaction(int thread, uint64_t n)
+{
+    return Transaction{"2026-01-01 00:00:00", "DEPOSIT", thread * 1e9 + static_cast<double>(n)};
+}
+
+static bool inOrder(const vector<Transaction>& history)
+{
+    vector<double> last(64, -1.0);
+    for (const Transaction& t : history)
+    {
+        size_t thread = static_cast<size_t>(t.amount / 1e9);
+        if (thread >= last.size() || t.amount <= last[thread])
+            return false;
+        last[thread] = t.amount;
+    }
+    return true;
+}
+
+static void removeStore(const string& dir)
+{
+    if (DIR* listing = opendir(dir.c_str()))
+    {
+        while (dirent* e = readdir(listing))
+        {
+            if (e->d_name[0] != '.')
+                remove((dir + "/" + e->d_name).c_str());
+        }
+        closedir(listing);
+    }
+    rmdir(dir.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 100000;
+    uint64_t appends = argc > 2 ? strtoull(argv[2], nullptr, 10) : 4000000;
+    int threads = argc > 3 ? atoi(argv[3]) : 4;
+    string base = argc > 4 ? argv[4] : "/tmp";
+    string dir = base + "/lsm_history_bench";
+    string dbPath = base + "/lsm_history_bench.db";
+    removeStore(dir);
+    for (const char* suffix : {"", ".wal", ".dwb"})
+        remove((dbPath + suffix).c_str());
+
+    HistoryStoreOptions options;
+    options.memtableBytes = 8 << 20;
+    HistoryStore store;
+    if (!store.open(dir, options))
+    {
+        fprintf(stderr, "cannot open %s\n", dir.c_str());
+        return 1;
+    }
+    printf("%d accounts, %llu appends, %d threads, %zu MiB memtable\n\n", accounts,
+           static_cast<unsigned long long>(appends), threads, options.memtableBytes >> 20);
+    printf("%-14s %10s %8s %12s\n", "phase", "ops", "seconds", "ops/s");
+
+    // Each thread's appends, with their account ids, for the comparison.
+    vector<vector<int>> targets(static_cast<size_t>(threads));
+    for (int t = 0; t < threads; ++t)
+    {
+        mt19937 rng(static_cast<unsigned>(t + 1));
+        uniform_int_distribution<int> pick(1, accounts);
+        targets[static_cast<size_t>(t)].resize(appends / static_cast<uint64_t>(threads));
+        for (int& id : targets[static_cast<size_t>(t)])
+            id = pick(rng);
+    }
+
+    auto start = Clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            const vector<int>& ids = targets[static_cast<size_t>(t)];
+            for (size_t i = 0; i < ids.size(); ++i)
+                store.append(ids[i], transaction(t, i));
+        });
+    }
+    for (thread& w : workers)
+        w.join();
+    double appendSeconds = secondsSince(start);
+    uint64_t appended = appends / static_cast<uint64_t>(threads) * static_cast<uint64_t>(threads);
+    printf("%-14s %10llu %8.3f %12.0f\n", "lsm append", static_cast<unsigned long long>(appended),
+           appendSeconds, appended / appendSeconds);
+    store.flush();
+    store.waitIdle();
+
+    // The B+tree gets its sequence numbers from the same counters.
+    {
+        StorageEngine engine;
+        engine.open(dbPath, {40}, 2048);
+        vector<uint32_t> next(static_cast<size_t>(accounts) + 1, 0);
+        char value[40] = {};
+        uint64_t count = min<uint64_t>(appended, 1000000);
+        start = Clock::now();
+        uint64_t done = 0;
+        for (int t = 0; t < threads && done < count; ++t)
+        {
+            for (int id : targets[static_cast<size_t>(t)])
+            {
+                if (done++ == count)
+                    break;
+                engine.put(0, historyKey(id, next[static_cast<size_t>(id)]++), value);
+            }
+        }
+        engine.sync();
+        double seconds = secondsSince(start);
+        printf("%-14s %10llu %8.3f %12.0f\n", "btree append", static_cast<unsigned long long>(count),
+               seconds, count / seconds);
+        engine.close();
+        for (const char* suffix : {"", ".wal", ".dwb"})
+            remove((dbPath + suffix).c_str());
+    }
+
+    bool ok = true;
+    mt19937 rng(99);
+    uniform_int_distribution<int> pick(1, accounts);
+    const int READS = 100000;
+    HistoryStoreStats before = store.stats();
+    start = Clock::now();
+    uint64_t readBack = 0;
+    for (int i = 0; i < READS; ++i)
+    {
+        vector<Transaction> history;
+        readBack += store.read(pick(rng), history);
+        ok = ok && inOrder(history);
+    }
+    double readSeconds = secondsSince(start);
+    HistoryStoreStats after = store.stats();
+    printf("%-14s %10d %8.3f %12.0f   %.1f transactions, %.2f runs searched, %.2f skipped per read\n",
+           "reads", READS, readSeconds, READS / readSeconds, double(readBack) / READS,
+           double(after.runsSearched - before.runsSearched) / READS,
+           double(after.runsSkipped - before.runsSkipped) / READS);
+
+    before = after;
+    start = Clock::now();
+    for (int i = 0; i < READS; ++i)
+    {
+        vector<Transaction> history;
+        ok = ok && store.read(accounts + 1 + i, history) == 0;
+    }
+    readSeconds = secondsSince(start);
+    after = store.stats();
+    printf("%-14s %10d %8.3f %12.0f   %.2f runs searched, %.2f skipped per read\n", "absent reads", READS,
+           readSeconds, READS / readSeconds, double(after.runsSearched - before.runsSearched) / READS,
+           double(after.runsSkipped - before.runsSkipped) / READS);
+
+    HistoryStoreStats stats = store.stats();
+    printf("\n%llu flushes, %llu compactions, %zu runs, write amplification %.2f, "
+           "%llu stalls (%.1f ms)\n",
+           static_cast<unsigned long long>(stats.flushes), static_cast<unsigned long long>(stats.compactions),
+           stats.runs, stats.writeAmplification(), static_cast<unsigned long long>(stats.stalls),
+           stats.stallNs / 1e6);
+
+    // Every history must come back, and appends must carry on from it.
+    vector<uint32_t> lengths(static_cast<size_t>(accounts) + 1, 0);
+    for (const vector<int>& ids : targets)
+    {
+        for (int id : ids)
+            ++lengths[static_cast<size_t>(id)];
+    }
+    store.close();
+    start = Clock::now();
+    store.open(dir, options);
+    double openSeconds = secondsSince(start);
+    uint64_t total = 0;
+    for (int id = 1; id <= accounts; ++id)
+    {
+        vector<Transaction> history;
+        size_t n = store.read(id, history);
+        ok = ok && n == lengths[static_cast<size_t>(id)] && inOrder(history);
+        total += n;
+    }
+    ok = ok && total == appended;
+    for (int id = 1; id <= 100; ++id)
+        ok = ok && store.append(id, transaction(0, 0)) == lengths[static_cast<size_t>(id)];
+    printf("reopen %.4f s, %llu transactions read back: %s\n", openSeconds,
+           static_cast<unsigned long long>(total), ok ? "ok" : "WRONG");
+    store.close();
+    removeStore(dir);
+
+    if (!ok)
+        fprintf(stderr, "history store returned wrong data\n");
+    return ok ? 0 : 1;
+}
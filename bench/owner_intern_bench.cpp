@@ -0,0 +1,162 @@
+/*
+    Owner interning benchmark
+    --------------------------------
+    Creates N accounts whose owners follow a skewed, realistic mix of
+    personal names (Zipf-distributed first and last names) and business
+    entity strings, then reports the memory spent on owner names with
+    one std::string per account versus the shared StringPool, and the
+    cost of finding an owner's accounts by string versus by id.
+
+    The pool pays a map entry per distinct owner, so it saves memory
+    only when owners repeat: a small book of mostly distinct names costs
+    more than plain strings. The by-string scan walks a packed array of
+    names while findByOwner() walks the 64-byte Accounts, so the id scan
+    is bounded by the account array, not by the compare; the pool lookup
+    itself is timed separately.
+
+    Usage: owner_intern_bench [accounts]
+*/
+
+#include "bank.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* FIRST[] = {
+    "James", "Mary", "Robert", "Patricia", "John", "Jennifer", "Michael", "Linda",
+    "David", "Elizabeth", "William", "Barbara", "Richard", "Susan", "Joseph", "Jessica",
+    "Thomas", "Sarah", "Christopher", "Karen", "Charles", "Lisa", "Daniel", "Nancy",
+    "Matthew", "Betty", "Anthony", "Margaret", "Mark", "Sandra", "Donald", "Ashley",
+    "Steven", "Kimberly", "Paul", "Emily", "Andrew", "Donna", "Joshua", "Michelle",
+    "Kenneth", "Carol", "Kevin", "Amanda", "Brian", "Dorothy", "George", "Melissa",
+};
+
+static const char* LAST[] = {
+    "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis",
+    "Rodriguez", "Martinez", "Hernandez", "Lopez", "Gonzalez", "Wilson", "Anderson",
+    "Thomas", "Taylor", "Moore", "Jackson", "Martin", "Lee", "Perez", "Thompson",
+    "White", "Harris", "Sanchez", "Clark", "Ramirez", "Lewis", "Robinson", "Walker",
+    "Young", "Allen", "King", "Wright", "Scott", "Torres", "Nguyen", "Hill", "Flores",
+    "Green", "Adams", "Nelson", "Baker", "Hall", "Rivera", "Campbell", "Mitchell",
+    "Carter", "Roberts", "Gomez", "Phillips", "Evans", "Turner", "Diaz", "Parker",
+    "Cruz", "Edwards", "Collins", "Reyes", "Stewart", "Morris", "Morales", "Murphy",
+};
+
+static const char* ENTITY[] = {
+    "Northwind Trading Company Limited",
+    "Contoso Pharmaceuticals International Holdings Inc.",
+    "Fabrikam Industrial Supply & Logistics LLC",
+    "Adventure Works Outdoor Equipment Cooperative",
+    "Tailspin Toys Retail Partners LP",
+    "Wide World Importers Wholesale Distribution GmbH",
+    "Litware Software Consulting Services Ltd.",
+    "Proseware Municipal Pension Fund Trustees",
+};
+
+// Picks from `words` with Zipf (s = 1) weights by rank.
+template <size_t N>
+static const char* zipf(const char* (&words)[N], mt19937& rng)
+{
+    static vector<double> cdf;
+    if (cdf.size() != N)
+    {
+        cdf.assign(N, 0.0);
+        double sum = 0.0;
+        for (size_t i = 0; i < N; ++i)
+            cdf[i] = (sum += 1.0 / (i + 1));
+        for (auto& c : cdf)
+            c /= sum;
+    }
+    double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+    size_t i = lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return words[min(i, N - 1)];
+}
+
+static size_t stringBytes(const string& s)
+{
+    return sizeof(string) + (s.capacity() > string().capacity() ? s.capacity() + 1 : 0);
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500000;
+
+    // One in ten accounts belongs to a business; people get a middle
+    // initial so the name space is realistically wide.
+    mt19937 rng(7);
+    vector<string> owners;
+    owners.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (rng() % 10 == 0)
+        {
+            owners.push_back(ENTITY[rng() % size(ENTITY)]);
+            continue;
+        }
+        string name = zipf(FIRST, rng);
+        name += ' ';
+        name += static_cast<char>('A' + rng() % 26);
+        name += ". ";
+        name += zipf(LAST, rng);
+        owners.push_back(name);
+    }
+
+    StringPool& pool = StringPool::owners();
+    size_t poolBefore = pool.memoryBytes();
+
+    Bank bank("", "");
+    for (const auto& owner : owners)
+        bank.createAccount(owner);
+
+    size_t perAccount = 0;
+    for (const auto& owner : owners)
+        perAccount += stringBytes(string(owner));
+    size_t pooled = n * sizeof(uint32_t) + pool.memoryBytes() - poolBefore;
+
+    printf("accounts            %12zu\n", n);
+    printf("distinct owners     %12zu\n", pool.size() - 1);
+    printf("string per account  %12zu bytes (%.1f B/account)\n", perAccount,
+           static_cast<double>(perAccount) / n);
+    printf("interned            %12zu bytes (%.1f B/account)\n", pooled,
+           static_cast<double>(pooled) / n);
+    printf("saved               %11.1f%%\n", 100.0 * (1.0 - static_cast<double>(pooled) / perAccount));
+
+    // Owner lookup: string compare over a plain copy of the names versus
+    // the interned-id scan Bank does.
+    const string target = ENTITY[0];
+    const auto& accounts = bank.getAccounts();
+
+    auto start = chrono::steady_clock::now();
+    size_t byString = 0;
+    for (const auto& owner : owners)
+        byString += owner == target;
+    double stringSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    size_t byId = bank.findByOwner(target).size();
+    double idSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const size_t LOOKUPS = 100000;
+    start = chrono::steady_clock::now();
+    size_t found = 0;
+    for (size_t i = 0; i < LOOKUPS; ++i)
+        found += pool.find(owners[i % n]) != StringPool::NONE;
+    double findSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("find by string      %12.2f ms (%zu matches, names only)\n", stringSecs * 1e3, byString);
+    printf("find by owner id    %12.2f ms (%zu matches, account scan)\n", idSecs * 1e3, byId);
+    printf("pool lookup         %12.1f ns\n", findSecs * 1e9 / LOOKUPS);
+
+    if (byString != byId || accounts.size() != n || found != LOOKUPS)
+        fprintf(stderr, "owner lookup mismatch\n");
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+    Priority lane benchmark
+    --------------------------------
+    Measures interactive latency with and without bulk work running.
+
+    Bank: one thread makes single deposits and balance checks at a
+    steady pace and records each one's latency. Meanwhile bulk threads
+    run interest accruals and payroll batches (transferBatch) back to
+    back. Reports p50/p99/max of the interactive operations with the
+    bank idle and under bulk load, and the bulk throughput.
+
+    Executor: interactive tasks are submitted while a bulk parallelFor
+    keeps every worker busy; reports how long they waited to start.
+
+    Usage: priority_bench [accounts] [seconds]
+*/
+
+#include "bank.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double usSince(Clock::time_point start)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+static void printLatencies(const char* name, vector<double>& us, const char* extra)
+{
+    sort(us.begin(), us.end());
+    if (us.empty())
+        return;
+    printf("%-22s %8zu %10.1f %10.1f %10.1f   %s\n", name, us.size(), us[us.size() / 2],
+           us[us.size() * 99 / 100], us.back(), extra);
+}
+
+// ========================================
+// Bank
+// ========================================
+
+static void bankRun(Bank& bank, int accounts, double seconds, bool bulk)
+{
+    atomic<bool> stop{false};
+    atomic<uint64_t> credited{0};
+    atomic<uint64_t> transferred{0};
+    thread interest;
+    thread payroll;
+
+    if (bulk)
+    {
+        interest = thread([&] {
+            while (!stop.load())
+                credited.fetch_add(bank.accrueInterest(1e-9));
+        });
+        payroll = thread([&] {
+            // Payroll: the employer (account 1) pays everyone else.
+            vector<TransferOrder> payroll;
+            for (int id = 2; id <= accounts; ++id)
+                payroll.push_back({1, id, 0.01});
+            while (!stop.load())
+            {
+                vector<Result> results = bank.transferBatch(payroll);
+                transferred.fetch_add(count(results.begin(), results.end(), Result::Ok));
+            }
+        });
+    }
+
+    vector<double> latencies;
+    mt19937 rng(42);
+    uniform_int_distribution<int> pick(2, accounts);
+    auto start = Clock::now();
+    while (usSince(start) < seconds * 1e6)
+    {
+        int id = pick(rng);
+        auto t0 = Clock::now();
+        bank.deposit(id, 1.0);
+        latencies.push_back(usSince(t0));
+
+        t0 = Clock::now();
+        vector<Transaction> history;
+        bank.history(id, history);
+        latencies.push_back(usSince(t0));
+
+        this_thread::sleep_for(chrono::microseconds(200));
+    }
+    stop.store(true);
+    if (bulk)
+    {
+        interest.join();
+        payroll.join();
+    }
+
+    char extra[128] = "";
+    if (bulk)
+        snprintf(extra, sizeof(extra), "bulk: %.0f interest credits/s, %.0f payroll transfers/s",
+                 credited.load() / seconds, transferred.load() / seconds);
+    printLatencies(bulk ? "bank, bulk running" : "bank, idle", latencies, extra);
+}
+
+// ========================================
+// Executor
+// ========================================
+
+static void executorRun(double seconds)
+{
+    Executor& executor = Executor::shared();
+    atomic<bool> stop{false};
+
+    // Bulk job: slices of busy work, as long as the run lasts.
+    thread bulk([&] {
+        while (!stop.load())
+        {
+            executor.parallelFor(4096, 1, [](size_t, size_t) {
+                auto until = Clock::now() + chrono::microseconds(50);
+                while (Clock::now() < until)
+                {
+                }
+            }, Priority::Bulk);
+        }
+    });
+
+    vector<double> waits;
+    auto start = Clock::now();
+    while (usSince(start) < seconds * 1e6)
+    {
+        atomic<bool> done{false};
+        auto submitted = Clock::now();
+        double wait = 0.0;
+        executor.submit([&] {
+            wait = usSince(submitted);
+            done.store(true, memory_order_release);
+        }, Priority::Interactive);
+        while (!done.load(memory_order_acquire))
+            this_thread::yield();
+        waits.push_back(wait);
+        this_thread::sleep_for(chrono::microseconds(500));
+    }
+    stop.store(true);
+    bulk.join();
+
+    char extra[64];
+    snprintf(extra, sizeof(extra), "%zu threads", executor.threadCount());
+    printLatencies("executor, bulk running", waits, extra);
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 100000;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+    Bank bank("", "");
+    for (int i = 0; i < accounts; ++i)
+        bank.createAccount("Customer " + to_string(i));
+    bank.deposit(1, 1e12);
+    for (int id = 2; id <= accounts; ++id)
+        bank.deposit(id, 1000.0);
+
+    printf("%-22s %8s %10s %10s %10s\n", "interactive", "ops", "p50 us", "p99 us", "max us");
+    bankRun(bank, accounts, seconds, false);
+    bankRun(bank, accounts, seconds, true);
+    executorRun(seconds);
+    return 0;
+}
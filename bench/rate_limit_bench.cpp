@@ -0,0 +1,165 @@
+/*
+    Rate limit benchmark
+    --------------------------------
+    First measures RateLimiter alone: token acquisitions per second from
+    N threads, spread over many keys and all on one key.
+
+    Then floods a SessionServer. One abusive client runs many sessions
+    depositing into a single account as fast as it can. Meanwhile
+    well-behaved clients each make a few deposits into their own
+    accounts. The run is repeated without admission control and with
+    per-client, per-account and in-flight limits. Reports the
+    well-behaved clients' throughput and p99 latency, and checks that
+    the abusive client got no more than its rate and burst allow.
+
+    Usage: rate_limit_bench [threads]
+*/
+
+#include "session.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const uint64_t ABUSER = 1;
+
+static void limiterThroughput(size_t threads, bool oneKey)
+{
+    RateLimiter limiter({1e9, 1e6}, 1 << 16);
+    atomic<bool> stop{false};
+    atomic<uint64_t> total{0};
+    vector<thread> pool;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&, t] {
+            mt19937_64 rng(t + 1);
+            uint64_t n = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                for (int i = 0; i < 256; ++i)
+                    n += limiter.tryAcquire(oneKey ? 7 : rng(), admissionClock());
+            }
+            total.fetch_add(n);
+        });
+    }
+    this_thread::sleep_for(chrono::milliseconds(500));
+    stop.store(true);
+    for (auto& t : pool)
+        t.join();
+    printf("limiter %-10s %8zu threads %14.0f acquisitions/s\n", oneKey ? "one key" : "many keys",
+           threads, total.load() / 0.5);
+}
+
+// ========================================
+// Flood
+// ========================================
+
+struct Flood
+{
+    atomic<uint64_t> abuserAdmitted{0};
+    atomic<uint64_t> abuserRefused{0};
+    atomic<uint64_t> goodAdmitted{0};
+    atomic<uint64_t> goodRefused{0};
+    mutex latencyMutex;
+    vector<double> latenciesUs;
+};
+
+static Task<void> abusiveSession(SessionServer& server, int account, int deposits, Flood& flood)
+{
+    for (int i = 0; i < deposits; ++i)
+    {
+        Result r = co_await server.deposit(account, 1.0, ABUSER);
+        (r == Result::Ok ? flood.abuserAdmitted : flood.abuserRefused).fetch_add(1);
+    }
+}
+
+static Task<void> goodSession(SessionServer& server, int account, uint64_t client, int deposits,
+                              Flood& flood)
+{
+    vector<double> latencies;
+    for (int i = 0; i < deposits; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        Result r = co_await server.deposit(account, 1.0, client);
+        latencies.push_back(
+            chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        (r == Result::Ok ? flood.goodAdmitted : flood.goodRefused).fetch_add(1);
+    }
+    lock_guard<mutex> lock(flood.latencyMutex);
+    flood.latenciesUs.insert(flood.latenciesUs.end(), latencies.begin(), latencies.end());
+}
+
+static bool runFlood(size_t threads, bool limited)
+{
+    const int GOOD_CLIENTS = 200;
+    const int GOOD_DEPOSITS = 50;
+    const int ABUSIVE_SESSIONS = 4000;
+    const int ABUSIVE_DEPOSITS = 100;
+
+    AdmissionPolicy policy;
+    if (limited)
+    {
+        policy.perClient = {2000.0, 100.0};
+        policy.perAccount = {5000.0, 200.0};
+        policy.maxInFlight = 512;
+    }
+
+    Bank bank("", "");
+    for (int i = 0; i <= GOOD_CLIENTS; ++i)
+        bank.createAccount("Client " + to_string(i));
+
+    Flood flood;
+    double seconds;
+    AdmissionStats stats;
+    {
+        SessionServer server(bank, threads, policy);
+        auto start = chrono::steady_clock::now();
+        for (int s = 0; s < ABUSIVE_SESSIONS; ++s)
+            server.spawn(abusiveSession(server, 1, ABUSIVE_DEPOSITS, flood));
+        for (int c = 0; c < GOOD_CLIENTS; ++c)
+            server.spawn(goodSession(server, c + 2, 100 + c, GOOD_DEPOSITS, flood));
+        server.waitIdle();
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        stats = server.admissionControl().stats();
+    }
+
+    vector<double>& lat = flood.latenciesUs;
+    sort(lat.begin(), lat.end());
+    double p99 = lat.empty() ? 0.0 : lat[lat.size() * 99 / 100];
+
+    // The abuser may not exceed its rate over the run plus one burst.
+    bool ok = bank.findAccount(1)->getBalance() == static_cast<double>(flood.abuserAdmitted.load());
+    if (limited)
+        ok = ok && flood.abuserAdmitted.load() <= policy.perClient.perSecond * seconds + policy.perClient.burst + 1;
+
+    printf("%-8s %10.3f %12llu %12llu %12llu %12.1f %10llu\n", limited ? "limited" : "open", seconds,
+           static_cast<unsigned long long>(flood.abuserAdmitted.load()),
+           static_cast<unsigned long long>(flood.abuserRefused.load()),
+           static_cast<unsigned long long>(flood.goodAdmitted.load()), p99,
+           static_cast<unsigned long long>(stats.overloaded));
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    size_t threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+
+    limiterThroughput(threads, false);
+    limiterThroughput(threads, true);
+
+    printf("\n%-8s %10s %12s %12s %12s %12s %10s\n", "policy", "seconds", "abuser ok", "abuser shed",
+           "good ok", "good p99 us", "overloaded");
+    bool ok = runFlood(threads, false);
+    ok = runFlood(threads, true) && ok;
+    if (!ok)
+        fprintf(stderr, "the abusive client got more than its limit allows\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+/*
+    Session scaling benchmark
+    --------------------------------
+    Spawns N concurrent client conversations on a fixed-size EventLoop
+    against a journaled Bank and reports throughput, how many sessions
+    were parked at once, and the coroutine memory each one cost.
+
+    Usage: session_bench [threads] [max_sessions]
+*/
+
+#include "session.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+static Task<void> conversation(SessionServer& server, int n)
+{
+    int id = co_await server.createAccount("client-" + to_string(n), Currency::USD);
+    co_await server.deposit(id, 100.0);
+    co_await server.persist();
+    co_await server.withdraw(id, 25.0);
+    co_await server.persist();
+    vector<Transaction> history = co_await server.history(id);
+    if (history.size() != 2)
+        abort();
+}
+
+static void run(size_t threads, size_t sessions)
+{
+    char dir[] = "/tmp/session_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return;
+    string data = string(dir) + "/bank_data.txt";
+    string rates = string(dir) + "/fx_rates.txt";
+
+    {
+        Bank bank(data, rates);
+        SessionServer server(bank, threads);
+        server.eventLoop().resetPeak();
+        resetFramePeak();
+        size_t baseBytes = liveFrameBytes();
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < sessions; ++i)
+            server.spawn(conversation(server, static_cast<int>(i)));
+        server.waitIdle();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t peakSessions = server.eventLoop().peakSessions();
+        size_t frameBytes = peakFrameBytes() - baseBytes;
+
+        printf("%8zu %8zu %12.0f %12zu %14.0f\n",
+               threads, sessions, sessions / secs, peakSessions,
+               peakSessions ? static_cast<double>(frameBytes) / peakSessions : 0.0);
+    }
+
+    unlink(data.c_str());
+    unlink(rates.c_str());
+    unlink((data + ".journal").c_str());
+    rmdir(dir);
+}
+
+int main(int argc, char** argv)
+{
+    size_t threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+    size_t maxSessions = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50000;
+
+    printf("%8s %8s %12s %12s %14s\n",
+           "threads", "sessions", "sessions/s", "peak parked", "bytes/session");
+
+    for (size_t n = 1000; n < maxSessions; n *= 10)
+        run(threads, n);
+    run(threads, maxSessions);
+    return 0;
+}
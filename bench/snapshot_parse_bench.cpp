@@ -0,0 +1,269 @@
+/*
+    Snapshot parse benchmark
+    --------------------------------
+    Builds a snapshot of N accounts with H transactions each in memory
+    and parses it three ways, reporting MB/s:
+
+      legacy   getline over an istringstream, fields split into strings
+               and converted with stoi/stod (how load() used to read)
+      scan     SnapshotReader alone: account headers and block extents,
+               which is what load() needs before serving requests
+      full     SnapshotReader plus every transaction line
+
+    It then damages a saved snapshot in three places (an account header,
+    a transaction and a missing END) and checks that a Bank still loads
+    the rest, reports each problem at the right line and quarantines it.
+
+    Usage: snapshot_parse_bench [accounts] [history]
+*/
+
+#include "bank.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static string makeSnapshot(int accounts, int history)
+{
+    string out = "#seq 0\n";
+    for (int i = 1; i <= accounts; ++i)
+    {
+        double balance = 0.0;
+        string lines;
+        for (int t = 0; t < history; ++t)
+        {
+            double amount = 10.0 + (i * 7 + t) % 1000 / 100.0;
+            balance += amount;
+            Transaction tx{"2026-10-17 09:30:00", "DEPOSIT", amount};
+            lines += "T:" + tx.serialize() + "\n";
+        }
+        out += to_string(i) + ";Customer " + to_string(i) + ";";
+        appendNumber(out, balance);
+        out += ";USD\n" + lines + "END\n";
+    }
+    return out;
+}
+
+static size_t parseLegacy(const string& data, double& checksum)
+{
+    istringstream in(data);
+    string line;
+    size_t accounts = 0;
+    while (getline(in, line))
+    {
+        if (line.empty() || line.rfind("#seq ", 0) == 0)
+            continue;
+        if (line == "END")
+            continue;
+        if (line.rfind("T:", 0) == 0)
+        {
+            istringstream fields(line.substr(2));
+            string timestamp, type, amount;
+            getline(fields, timestamp, '|');
+            getline(fields, type, '|');
+            getline(fields, amount);
+            checksum += stod(amount);
+            continue;
+        }
+        istringstream fields(line);
+        string id, owner, balance;
+        getline(fields, id, ';');
+        getline(fields, owner, ';');
+        getline(fields, balance, ';');
+        checksum += stoi(id) + stod(balance);
+        ++accounts;
+    }
+    return accounts;
+}
+
+static size_t parseReader(const string& data, bool transactions, double& checksum)
+{
+    SnapshotReader reader(data);
+    SnapshotReader::Block block;
+    ParseError error;
+    size_t accounts = 0;
+    while (reader.next(block, error) == SnapshotReader::Status::Block)
+    {
+        checksum += block.account.id + block.account.balance;
+        ++accounts;
+        if (!transactions)
+            continue;
+
+        string_view history(data.data() + block.historyBegin, block.historyEnd - block.historyBegin);
+        while (!history.empty())
+        {
+            size_t eol = history.find('\n');
+            TransactionFields fields;
+            if (!parseTransactionLine(history.substr(2, eol - 2), fields))
+                checksum += fields.amount;
+            history.remove_prefix(eol + 1);
+        }
+    }
+    return accounts;
+}
+
+// ========================================
+// Recovery check
+// ========================================
+
+static vector<string> splitLines(const string& data)
+{
+    vector<string> lines;
+    istringstream in(data);
+    string line;
+    while (getline(in, line))
+        lines.push_back(line);
+    return lines;
+}
+
+// 1-based line number of the header of account `id`.
+static size_t headerLine(const vector<string>& lines, int id)
+{
+    string prefix = to_string(id) + ";";
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        if (lines[i].rfind(prefix, 0) == 0)
+            return i + 1;
+    }
+    return 0;
+}
+
+static bool checkRecovery(const string& dir, bool indexed)
+{
+    string data = dir + "/bank_data.txt";
+    string rates = dir + "/fx_rates.txt";
+    filesystem::remove_all(dir);
+    filesystem::create_directory(dir);
+
+    const int n = 100;
+    {
+        Bank bank(data, rates);
+        for (int i = 0; i < n; ++i)
+        {
+            int id = bank.createAccount("Customer " + to_string(i));
+            bank.deposit(id, 100.0 + i);
+            bank.deposit(id, 0.1);
+        }
+    }
+
+    string text;
+    {
+        ifstream file(data, ios::binary);
+        text.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    vector<string> lines = splitLines(text);
+
+    // Same-length edits keep the index valid, so the indexed run loads
+    // the damaged header from the index and only the history error and
+    // the missing END (which the index cannot see) remain.
+    size_t badHeader = headerLine(lines, 10);
+    size_t badTransaction = headerLine(lines, 20) + 2;
+    size_t noEnd = headerLine(lines, 31);
+    lines[badHeader - 1].replace(lines[badHeader - 1].rfind(';') - 3, 3, "x.y");
+    lines[badTransaction - 1].back() = 'z';
+    lines[noEnd - 2] = "T:x";
+
+    text.clear();
+    for (const auto& line : lines)
+        text += line + "\n";
+    {
+        ofstream file(data, ios::binary | ios::trunc);
+        file << text;
+    }
+    if (!indexed)
+        filesystem::remove(data + ".index");
+
+    Bank bank(data, rates);
+    bank.waitForHistory();
+    vector<ParseError> errors = bank.loadErrors();
+
+    bool ok = true;
+    auto expect = [&](size_t line, const char* what) {
+        bool found = false;
+        for (const auto& e : errors)
+            found = found || e.line == line;
+        if (!found)
+        {
+            fprintf(stderr, "%s: no error reported at line %zu\n", what, line);
+            ok = false;
+        }
+    };
+    expect(badTransaction, "bad transaction");
+    if (!indexed)
+    {
+        expect(badHeader, "bad header");
+        expect(noEnd, "missing END");
+        ok = ok && errors.size() == 3 && bank.getAccounts().size() == n - 2
+             && !bank.findAccount(10) && !bank.findAccount(30);
+    }
+    const Account* acc = bank.findAccount(20);
+    ok = ok && acc && acc->getBalance() == 100.0 + 19 + 0.1 && acc->historySize() == 1;
+
+    ifstream quarantined(data + ".quarantine");
+    string line;
+    size_t records = 0;
+    while (getline(quarantined, line))
+        records += line.rfind("# ", 0) == 0;
+    ok = ok && records == errors.size();
+
+    printf("recovery (%s index): %zu errors, %zu accounts loaded: %s\n", indexed ? "with" : "without",
+           errors.size(), bank.getAccounts().size(), ok ? "ok" : "FAILED");
+    for (const auto& e : errors)
+        printf("    line %zu (byte %zu): %s\n", e.line, e.offset, e.message);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 100000;
+    int history = argc > 2 ? atoi(argv[2]) : 20;
+
+    string data = makeSnapshot(accounts, history);
+    double mb = data.size() / 1e6;
+    printf("%d accounts x %d transactions, %.1f MB\n", accounts, history, mb);
+    printf("%-8s %10s %10s\n", "parser", "seconds", "MB/s");
+
+    struct Run
+    {
+        const char* name;
+        size_t (*parse)(const string&, double&);
+    };
+    const Run runs[] = {
+        {"legacy", parseLegacy},
+        {"scan", [](const string& d, double& c) { return parseReader(d, false, c); }},
+        {"full", [](const string& d, double& c) { return parseReader(d, true, c); }},
+    };
+    bool ok = true;
+    for (const Run& run : runs)
+    {
+        double checksum = 0.0;
+        auto start = chrono::steady_clock::now();
+        size_t parsed = run.parse(data, checksum);
+        double seconds = secondsSince(start);
+        ok = ok && parsed == static_cast<size_t>(accounts);
+        printf("%-8s %10.3f %10.1f\n", run.name, seconds, mb / seconds);
+    }
+    if (!ok)
+        fprintf(stderr, "a parser did not find every account\n");
+
+    char dir[] = "/tmp/snapshot_parse_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    ok = checkRecovery(dir, false) && ok;
+    ok = checkRecovery(dir, true) && ok;
+    filesystem::remove_all(dir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/*
+    Startup benchmark
+    --------------------------------
+    Writes snapshots of N accounts with growing amounts of history, then
+    measures how long a new Bank takes to serve its first request (the
+    constructor plus one history lookup) and how long the background
+    warm-up takes to load every history, with and without the snapshot
+    index. Time to first request should stay flat as history grows.
+
+    Each run also deposits into an account before its history is in and
+    checks that the deposit ends up last, and that audit() agrees with
+    every balance once the warm-up is done.
+
+    Usage: startup_bench [accounts]
+*/
+
+#include "bank.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+static double msSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void run(const string& data, const string& rates, int n, int history, bool indexed)
+{
+    if (!indexed)
+        filesystem::remove(data + ".index");
+
+    auto start = chrono::steady_clock::now();
+    double firstMs;
+    double warmMs;
+    bool ok = true;
+    {
+        Bank bank(data, rates);
+        int id = n / 2;
+        bank.deposit(id, 1.0);
+        vector<Transaction> out;
+        bank.history(id, out);
+        firstMs = msSince(start);
+        ok = !out.empty() && out.back().type == "DEPOSIT" && out.back().amount == 1.0;
+
+        bank.waitForHistory();
+        warmMs = msSince(start);
+        ok = ok && out.size() == bank.findAccount(id)->historySize()
+             && out.size() >= static_cast<size_t>(history) + 1
+             && bank.audit().empty() && bank.getAccounts().size() == static_cast<size_t>(n);
+
+        // Keeps the balance the same for the next run.
+        bank.withdraw(id, 1.0);
+    }
+    if (!ok)
+        fprintf(stderr, "history %d: loaded state does not match\n", history);
+
+    printf("%10d %8s %16.1f %14.1f\n", history, indexed ? "yes" : "no", firstMs, warmMs);
+}
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 10000;
+
+    char dir[] = "/tmp/startup_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    string data = string(dir) + "/bank_data.txt";
+    string rates = string(dir) + "/fx_rates.txt";
+
+    printf("%10s %8s %16s %14s\n", "history", "index", "first request ms", "all loaded ms");
+    int written = 0;
+    for (int history : {0, 20, 100})
+    {
+        {
+            Bank bank(data, rates);
+            if (bank.getAccounts().empty())
+            {
+                for (int i = 0; i < n; ++i)
+                    bank.createAccount("Customer " + to_string(i));
+            }
+            for (int i = 1; i <= n; ++i)
+            {
+                for (int t = written; t < history; ++t)
+                    bank.deposit(i, 10.0);
+            }
+            written = history;
+        }
+        run(data, rates, n, history, true);
+        run(data, rates, n, history, false);
+    }
+
+    filesystem::remove_all(dir);
+    return 0;
+}
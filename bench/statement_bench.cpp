@@ -0,0 +1,209 @@
+/*
+    Statement benchmark
+    --------------------------------
+    Loads a bank of N accounts whose histories span three months and
+    produces the middle month's statements two ways, reporting
+    statements per second:
+
+      per-account  Bank::history() for one id at a time, scanned for the
+                   period and formatted through an ostream, the way the
+                   console prints a history
+      engine       Bank::generateStatements() with 1 shard and with one
+                   shard per executor thread
+
+    Every statement the engine writes is read back and checked: opening
+    and closing balances match the generated data, the credits and
+    debits add up, and each account appears exactly once.
+
+    Usage: statement_bench [accounts]
+*/
+
+#include "bank.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const int HISTORY = 36;
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+struct Expected
+{
+    double opening = 0.0;
+    double closing = 0.0;
+    size_t transactions = 0;
+};
+
+// History entry t falls in August, September or October 2026; the
+// statements cover September.
+static void writeSnapshot(const string& path, int accounts, vector<Expected>& expected)
+{
+    string out = "#seq 0\n";
+    expected.assign(accounts + 1, Expected());
+    for (int id = 1; id <= accounts; ++id)
+    {
+        double balance = 0.0;
+        string lines;
+        for (int t = 0; t < HISTORY; ++t)
+        {
+            int month = 8 + t * 3 / HISTORY;
+            char timestamp[32];
+            snprintf(timestamp, sizeof(timestamp), "2026-%02d-%02d 12:%02d:00", month,
+                     1 + t % (HISTORY / 3), id % 60);
+            bool deposit = t % 3 != 2;
+            Transaction tx{timestamp, deposit ? "DEPOSIT" : "WITHDRAW", deposit ? 100.0 + id % 7 : 45.5};
+            lines += "T:" + tx.serialize() + "\n";
+
+            if (month < 9)
+                expected[id].opening += balanceEffect(tx);
+            if (month <= 9)
+                expected[id].closing += balanceEffect(tx);
+            expected[id].transactions += month == 9;
+            balance += balanceEffect(tx);
+        }
+        out += to_string(id) + ";Customer " + to_string(id) + ";";
+        appendNumber(out, balance);
+        out += ";USD\n" + lines + "END\n";
+    }
+    ofstream file(path, ios::binary | ios::trunc);
+    file << out;
+}
+
+static double perAccount(Bank& bank, const StatementPeriod& period, const string& path)
+{
+    auto start = chrono::steady_clock::now();
+    ofstream file(path, ios::trunc);
+    vector<Transaction> history;
+    for (const auto& acc : bank.getAccounts())
+    {
+        bank.history(acc.getId(), history);
+        double balance = acc.getBalance();
+        for (const auto& t : history)
+        {
+            if (t.timestamp >= period.from)
+                balance -= balanceEffect(t);
+        }
+
+        ostringstream ss;
+        ss << "STATEMENT " << acc.getId() << " " << acc.getOwner() << "\n"
+           << "Opening balance: " << fixed << setprecision(2) << balance << "\n";
+        for (const auto& t : history)
+        {
+            if (t.timestamp < period.from || t.timestamp >= period.to)
+                continue;
+            balance += balanceEffect(t);
+            ss << t.timestamp << " | " << setw(15) << left << t.type << " | " << t.amount
+               << " | " << balance << "\n";
+        }
+        ss << "Closing balance: " << balance << "\n\n";
+        file << ss.str();
+    }
+    return secondsSince(start);
+}
+
+// Reads every "<prefix>.<shard>.stmt" back and checks it.
+static bool verify(const string& prefix, size_t shards, const vector<Expected>& expected)
+{
+    vector<int> seen(expected.size(), 0);
+    bool ok = true;
+    for (size_t s = 0; s < shards; ++s)
+    {
+        ifstream file(prefix + "." + to_string(s) + ".stmt");
+        string line;
+        int id = 0;
+        double opening = 0.0, credits = 0.0, debits = 0.0;
+        size_t lines = 0;
+        while (getline(file, line))
+        {
+            if (line.rfind("STATEMENT ", 0) == 0)
+            {
+                id = atoi(line.c_str() + 10);
+                lines = 0;
+            }
+            else if (line.rfind("Opening balance: ", 0) == 0)
+                opening = atof(line.c_str() + 17);
+            else if (line.rfind("Credits: ", 0) == 0)
+            {
+                credits = atof(line.c_str() + 9);
+                debits = atof(line.c_str() + line.find("Debits: ") + 8);
+            }
+            else if (line.rfind("Closing balance: ", 0) == 0)
+            {
+                double closing = atof(line.c_str() + 17);
+                if (id <= 0 || id >= static_cast<int>(expected.size()))
+                    return false;
+                const Expected& e = expected[id];
+                ok = ok && fabs(opening - e.opening) < 0.005 && fabs(closing - e.closing) < 0.005
+                     && fabs(opening + credits - debits - closing) < 0.005 && lines == e.transactions;
+                ++seen[id];
+            }
+            else if (line.find(" | ") != string::npos)
+                ++lines;
+        }
+    }
+    for (size_t id = 1; id < seen.size(); ++id)
+        ok = ok && seen[id] == 1;
+    return ok;
+}
+
+static bool run(const string& dir, int accounts, const vector<Expected>& expected)
+{
+    Bank bank(dir + "/bank_data.txt", dir + "/fx_rates.txt");
+    bank.waitForHistory();
+
+    StatementPeriod period;
+    monthPeriod("2026-09", period);
+    printf("%d accounts, %d transactions each, statements for %s to %s\n", accounts, HISTORY,
+           period.from.c_str(), period.to.c_str());
+    printf("%-12s %7s %10s %14s %10s\n", "generator", "shards", "seconds", "statements/s", "MB");
+
+    double seconds = perAccount(bank, period, dir + "/baseline.txt");
+    printf("%-12s %7d %10.3f %14.0f %10.1f\n", "per-account", 1, seconds, accounts / seconds,
+           filesystem::file_size(dir + "/baseline.txt") / 1e6);
+
+    bool ok = true;
+    for (size_t shards : {size_t(1), size_t(0)})
+    {
+        string prefix = dir + "/statements";
+        StatementReport report = bank.generateStatements(period, prefix, shards);
+        bool valid = report.ok && report.statements == static_cast<size_t>(accounts)
+                     && verify(prefix, report.shards, expected);
+        ok = ok && valid;
+        printf("%-12s %7zu %10.3f %14.0f %10.1f%s\n", "engine", report.shards, report.seconds,
+               report.statementsPerSecond(), report.bytes / 1e6, valid ? "" : "  MISMATCH");
+        for (size_t s = 0; s < report.shards; ++s)
+            filesystem::remove(prefix + "." + to_string(s) + ".stmt");
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 100000;
+
+    char dir[] = "/tmp/statement_benchXXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    vector<Expected> expected;
+    writeSnapshot(string(dir) + "/bank_data.txt", accounts, expected);
+
+    bool ok = run(dir, accounts, expected);
+    if (!ok)
+        fprintf(stderr, "statements do not match the data\n");
+    filesystem::remove_all(dir);
+    return ok ? 0 : 1;
+}
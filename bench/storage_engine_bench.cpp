@@ -0,0 +1,250 @@
+/*
+    Storage engine benchmark
+    --------------------------------
+    Exercises StorageEngine on its own, with the layout a bank would
+    use: an accounts table keyed by id (64-byte records) and a history
+    table keyed by historyKey(id, seq) (40-byte records).
+
+        insert accounts   ids in ascending order
+        insert history    transactions for accounts in random order
+        point lookups     random account ids
+        range scans       one account's whole history
+        full scan         every account in id order
+        reopen            close and open again: no data is loaded
+        recovery          a child process writes and syncs, then exits
+                          without closing; the parent reopens and
+                          checks the log replay restored everything
+
+    The cache holds a fraction of the pages (cache argument), so the
+    lookups and scans fault; faults come from the OS page cache.
+
+    Usage: storage_engine_bench [accounts] [history per account] [cache pages] [dir]
+*/
+
+#include "storage.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static const size_t ACCOUNTS = 0;
+static const size_t HISTORY = 1;
+
+struct AccountValue
+{
+    int32_t id;
+    uint8_t currency;
+    uint8_t reserved[3];
+    double balance;
+    char owner[48];
+};
+static_assert(sizeof(AccountValue) == 64, "account record size");
+
+struct HistoryValue
+{
+    char timestamp[20];
+    char type[12];
+    double amount;
+};
+static_assert(sizeof(HistoryValue) == 40, "history record size");
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* phase, uint64_t ops, double seconds, const StorageEngine& engine,
+                   const BufferPoolStats& before)
+{
+    BufferPoolStats now = engine.stats().cache;
+    uint64_t hits = now.hits - before.hits;
+    uint64_t faults = now.faults - before.faults;
+    printf("%-16s %10llu %8.3f %12.0f %8.1f%%\n", phase, static_cast<unsigned long long>(ops), seconds,
+           ops / seconds, hits + faults ? 100.0 * hits / double(hits + faults) : 0.0);
+}
+
+static HistoryValue historyValue(int id, uint32_t seq)
+{
+    HistoryValue h{};
+    strcpy(h.timestamp, "2026-01-01 00:00:00");
+    strcpy(h.type, "DEPOSIT");
+    h.amount = id + seq / 1000.0;
+    return h;
+}
+
+static vector<size_t> tableSizes()
+{
+    return {sizeof(AccountValue), sizeof(HistoryValue)};
+}
+
+// Exits without closing the engine, as a crash would.
+static void crashingWriter(const string& path, size_t cachePages, int firstId, int count)
+{
+    StorageEngine engine;
+    if (!engine.open(path, tableSizes(), cachePages))
+        _exit(2);
+    for (int id = firstId; id < firstId + count; ++id)
+    {
+        AccountValue acc{};
+        acc.id = id;
+        acc.balance = id;
+        snprintf(acc.owner, sizeof(acc.owner), "Late %d", id);
+        engine.put(ACCOUNTS, static_cast<uint64_t>(id), reinterpret_cast<const char*>(&acc));
+    }
+    engine.sync();
+    _exit(0);
+}
+
+int main(int argc, char** argv)
+{
+    int accounts = argc > 1 ? atoi(argv[1]) : 200000;
+    uint32_t perAccount = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 5;
+    size_t cachePages = argc > 3 ? strtoul(argv[3], nullptr, 10) : 2048;
+    string dir = argc > 4 ? argv[4] : "/tmp";
+    string path = dir + "/storage_engine_bench.db";
+    for (const char* suffix : {"", ".wal", ".dwb"})
+        remove((path + suffix).c_str());
+
+    bool ok = true;
+    StorageEngine engine;
+    if (!engine.open(path, tableSizes(), cachePages))
+    {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+    printf("%d accounts, %u transactions each, cache %zu pages (%.1f MiB)\n\n", accounts, perAccount,
+           cachePages, cachePages * PAGE_SIZE / 1048576.0);
+    printf("%-16s %10s %8s %12s %9s\n", "phase", "ops", "seconds", "ops/s", "hit rate");
+
+    BufferPoolStats before = engine.stats().cache;
+    auto start = Clock::now();
+    for (int id = 1; id <= accounts; ++id)
+    {
+        AccountValue acc{};
+        acc.id = id;
+        acc.balance = 100.0;
+        snprintf(acc.owner, sizeof(acc.owner), "Customer %d", id);
+        engine.put(ACCOUNTS, static_cast<uint64_t>(id), reinterpret_cast<const char*>(&acc));
+    }
+    engine.sync();
+    report("insert accounts", static_cast<uint64_t>(accounts), secondsSince(start), engine, before);
+
+    // Each round gives every account one more transaction, visiting
+    // the accounts in a fresh random order.
+    mt19937 rng(11);
+    vector<int> order(static_cast<size_t>(accounts));
+    for (int i = 0; i < accounts; ++i)
+        order[static_cast<size_t>(i)] = i + 1;
+    before = engine.stats().cache;
+    start = Clock::now();
+    for (uint32_t seq = 0; seq < perAccount; ++seq)
+    {
+        shuffle(order.begin(), order.end(), rng);
+        for (int id : order)
+        {
+            HistoryValue h = historyValue(id, seq);
+            engine.put(HISTORY, historyKey(id, seq), reinterpret_cast<const char*>(&h));
+        }
+    }
+    engine.sync();
+    uint64_t historyRecords = static_cast<uint64_t>(accounts) * perAccount;
+    report("insert history", historyRecords, secondsSince(start), engine, before);
+
+    uniform_int_distribution<int> pick(1, accounts);
+    before = engine.stats().cache;
+    start = Clock::now();
+    const int LOOKUPS = 500000;
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        AccountValue acc;
+        int id = pick(rng);
+        if (!engine.get(ACCOUNTS, static_cast<uint64_t>(id), reinterpret_cast<char*>(&acc)) || acc.id != id)
+            ok = false;
+    }
+    report("point lookups", LOOKUPS, secondsSince(start), engine, before);
+
+    before = engine.stats().cache;
+    start = Clock::now();
+    const int SCANS = 100000;
+    uint64_t scanned = 0;
+    for (int i = 0; i < SCANS; ++i)
+    {
+        int id = pick(rng);
+        uint32_t expect = 0;
+        engine.scan(HISTORY, historyKey(id, 0), historyKey(id, UINT32_MAX), [&](uint64_t, const char* v) {
+            HistoryValue h;
+            memcpy(&h, v, sizeof(h));
+            ok = ok && h.amount == historyValue(id, expect).amount;
+            ++expect;
+            return true;
+        });
+        ok = ok && expect == perAccount;
+        scanned += expect;
+    }
+    report("range scans", SCANS, secondsSince(start), engine, before);
+
+    before = engine.stats().cache;
+    start = Clock::now();
+    uint64_t rows = 0;
+    engine.scan(ACCOUNTS, 0, UINT64_MAX, [&](uint64_t key, const char*) {
+        ok = ok && key == ++rows;
+        return true;
+    });
+    ok = ok && rows == static_cast<uint64_t>(accounts);
+    report("full scan", rows, secondsSince(start), engine, before);
+
+    StorageStats stats = engine.stats();
+    printf("\ncheckpoints %llu (last %.1f ms), evictions %llu, mean fault %.2f us\n",
+           static_cast<unsigned long long>(stats.checkpoints), stats.lastCheckpointMs,
+           static_cast<unsigned long long>(stats.cache.evictions), stats.cache.meanFaultUs());
+
+    start = Clock::now();
+    engine.close();
+    double closeSeconds = secondsSince(start);
+    start = Clock::now();
+    engine.open(path, tableSizes(), cachePages);
+    double openSeconds = secondsSince(start);
+    ok = ok && engine.size(ACCOUNTS) == static_cast<uint64_t>(accounts) && engine.size(HISTORY) == historyRecords;
+    printf("close %.3f s, reopen %.4f s, %llu accounts and %llu transactions on disk\n", closeSeconds,
+           openSeconds, static_cast<unsigned long long>(engine.size(ACCOUNTS)),
+           static_cast<unsigned long long>(engine.size(HISTORY)));
+    engine.close();
+
+    // Crash after sync: the log must bring back every synced put.
+    const int LATE = 20000;
+    pid_t child = fork();
+    if (child == 0)
+        crashingWriter(path, cachePages, accounts + 1, LATE);
+    int status = 0;
+    waitpid(child, &status, 0);
+    start = Clock::now();
+    engine.open(path, tableSizes(), cachePages);
+    double recoverSeconds = secondsSince(start);
+    AccountValue last;
+    bool recovered = engine.get(ACCOUNTS, static_cast<uint64_t>(accounts + LATE), reinterpret_cast<char*>(&last))
+                     && last.balance == accounts + LATE
+                     && engine.size(ACCOUNTS) == static_cast<uint64_t>(accounts + LATE);
+    stats = engine.stats();
+    printf("recovery: replayed %llu records, restored %llu pages in %.3f s: %s\n",
+           static_cast<unsigned long long>(stats.replayed), static_cast<unsigned long long>(stats.restoredPages),
+           recoverSeconds, recovered ? "ok" : "MISSING DATA");
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 && recovered;
+    engine.close();
+
+    for (const char* suffix : {"", ".wal", ".dwb"})
+        remove((path + suffix).c_str());
+    if (!ok)
+        fprintf(stderr, "storage engine returned wrong data\n");
+    return ok ? 0 : 1;
+}
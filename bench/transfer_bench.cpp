@@ -0,0 +1,102 @@
+/*
+    Transfer concurrency benchmark
+    --------------------------------
+    Runs random transfers from several threads against an in-memory Bank
+    in pessimistic and optimistic mode and reports throughput, latency
+    percentiles and the optimistic conflict/retry counts. Each thread
+    mostly transfers within its own slice of accounts; `cross` is the
+    fraction of transfers that reach into another thread's slice.
+
+    Usage: transfer_bench [threads] [accounts] [ops_per_thread] [cross]
+*/
+
+#include "bank.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void run(ConcurrencyMode mode, size_t threads, int accounts, size_t ops, double cross)
+{
+    Bank bank("", "");
+    for (int i = 0; i < accounts; ++i)
+        bank.deposit(bank.createAccount("acct-" + to_string(i)), 1000000.0);
+    bank.setConcurrencyMode(mode);
+
+    vector<vector<double>> latencies(threads);
+    int slice = max(2, accounts / static_cast<int>(threads));
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            mt19937 rng(static_cast<unsigned>(t) * 7919 + 1);
+            uniform_real_distribution<double> coin(0.0, 1.0);
+            int base = static_cast<int>(t) * slice % accounts;
+            auto& lat = latencies[t];
+            lat.reserve(ops);
+
+            for (size_t i = 0; i < ops; ++i)
+            {
+                int from = 1 + (base + static_cast<int>(rng() % slice)) % accounts;
+                int to = coin(rng) < cross
+                    ? 1 + static_cast<int>(rng() % accounts)
+                    : 1 + (base + static_cast<int>(rng() % slice)) % accounts;
+
+                auto t0 = chrono::steady_clock::now();
+                bank.transfer(from, to, 1.0);
+                lat.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    for (auto& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+
+    // Transfers move money, never create it.
+    double total = 0.0;
+    for (const auto& acc : bank.getAccounts())
+        total += acc.getBalance();
+    if (total != 1000000.0 * accounts)
+        fprintf(stderr, "balance drift: %.2f\n", total - 1000000.0 * accounts);
+
+    ConcurrencyStats st = bank.concurrencyStats();
+    printf("%-11s %12.0f %9.2f %9.2f %9.2f %10llu %10llu %9llu %7.4f\n",
+           mode == ConcurrencyMode::Optimistic ? "optimistic" : "pessimistic",
+           all.size() / secs, pct(0.5), pct(0.99), pct(0.999),
+           static_cast<unsigned long long>(st.optimisticCommits),
+           static_cast<unsigned long long>(st.optimisticConflicts),
+           static_cast<unsigned long long>(st.optimisticFallbacks),
+           st.conflictRate());
+}
+
+int main(int argc, char** argv)
+{
+    size_t threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+    int accounts = argc > 2 ? atoi(argv[2]) : 100000;
+    size_t ops = argc > 3 ? strtoul(argv[3], nullptr, 10) : 500000;
+    double cross = argc > 4 ? atof(argv[4]) : 0.01;
+
+    printf("%zu threads, %d accounts, %zu transfers/thread, %.1f%% cross-slice\n",
+           threads, accounts, ops, cross * 100);
+    printf("%-11s %12s %9s %9s %9s %10s %10s %9s %7s\n",
+           "mode", "ops/s", "p50 us", "p99 us", "p99.9 us",
+           "opt commit", "conflicts", "fallback", "c-rate");
+
+    run(ConcurrencyMode::Pessimistic, threads, accounts, ops, cross);
+    run(ConcurrencyMode::Optimistic, threads, accounts, ops, cross);
+    return 0;
+}
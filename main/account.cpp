@@ -0,0 +1,595 @@
+#include "account.h"
+#include "epoch.h"
+
+#include <algorithm>
+#include <bit>
+#include <ctime>
+#include <thread>
+
+using namespace std;
+
+// ========================================
+// Utility
+// ========================================
+
+// Called on every mutation, so it formats into a stack buffer with
+// strftime rather than going through a stringstream.
+string currentTime()
+{
+    time_t now = time(nullptr);
+    tm ltm;
+    localtime_r(&now, &ltm);
+
+    char buf[32];
+    size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &ltm);
+    return string(buf, len);
+}
+
+// ========================================
+// Transaction
+// ========================================
+
+// Amounts are written in their shortest exact form, so a snapshot
+// reloads to the same bits.
+string Transaction::serialize() const
+{
+    string out;
+    out.reserve(timestamp.size() + type.size() + 24);
+    out += timestamp;
+    out += '|';
+    out += type;
+    out += '|';
+    appendNumber(out, amount);
+    return out;
+}
+
+bool Transaction::deserialize(string_view line, Transaction& out)
+{
+    TransactionFields fields;
+    if (parseTransactionLine(line, fields))
+        return false;
+    out.timestamp.assign(fields.timestamp);
+    out.type.assign(fields.type);
+    out.amount = fields.amount;
+    return true;
+}
+
+// ========================================
+// HistoryLog
+// ========================================
+
+HistoryLog::Directory::Directory(size_t capacity)
+    : capacity(capacity), chunks(make_unique<atomic<Transaction*>[]>(capacity))
+{
+}
+
+// Chunk k holds FIRST_CHUNK << k entries, starting at entry
+// FIRST_CHUNK * (2^k - 1).
+size_t HistoryLog::chunkOf(size_t i, size_t& offset)
+{
+    size_t chunk = static_cast<size_t>(bit_width(i / FIRST_CHUNK + 1)) - 1;
+    offset = i - FIRST_CHUNK * ((size_t(1) << chunk) - 1);
+    return chunk;
+}
+
+const Transaction& HistoryLog::at(const Directory* dir, size_t i) const
+{
+    size_t offset;
+    size_t chunk = chunkOf(i, offset);
+    return dir->chunks[chunk].load(memory_order_acquire)[offset];
+}
+
+HistoryLog::Directory* HistoryLog::reserveChunks(size_t chunks)
+{
+    Directory* dir = directory.load(memory_order_relaxed);
+    if (dir && dir->capacity >= chunks)
+        return dir;
+
+    size_t capacity = dir ? dir->capacity : 4;
+    while (capacity < chunks)
+        capacity *= 2;
+
+    // Readers may still hold the old directory; it shares its chunks
+    // with the new one and only its pointer array is retired.
+    Directory* grown = new Directory(capacity);
+    if (dir)
+    {
+        for (size_t k = 0; k < dir->capacity; ++k)
+            grown->chunks[k].store(dir->chunks[k].load(memory_order_relaxed), memory_order_relaxed);
+    }
+    directory.store(grown, memory_order_release);
+    if (dir)
+        EpochDomain::shared().retire(dir);
+    return grown;
+}
+
+Transaction& HistoryLog::slotFor(size_t i)
+{
+    size_t offset;
+    size_t chunk = chunkOf(i, offset);
+    Directory* dir = reserveChunks(chunk + 1);
+
+    Transaction* entries = dir->chunks[chunk].load(memory_order_relaxed);
+    if (!entries)
+    {
+        entries = new Transaction[chunkCapacity(chunk)];
+        dir->chunks[chunk].store(entries, memory_order_release);
+    }
+    return entries[offset];
+}
+
+void HistoryLog::release()
+{
+    Directory* dir = directory.load(memory_order_relaxed);
+    if (dir)
+    {
+        for (size_t k = 0; k < dir->capacity; ++k)
+            delete[] dir->chunks[k].load(memory_order_relaxed);
+        delete dir;
+    }
+    directory.store(nullptr, memory_order_relaxed);
+    count.store(0, memory_order_relaxed);
+}
+
+HistoryLog::HistoryLog(const HistoryLog& other)
+{
+    other.forEach([this](const Transaction& t) { push_back(t); });
+}
+
+HistoryLog& HistoryLog::operator=(const HistoryLog& other)
+{
+    if (this != &other)
+    {
+        release();
+        other.forEach([this](const Transaction& t) { push_back(t); });
+    }
+    return *this;
+}
+
+HistoryLog::~HistoryLog()
+{
+    release();
+}
+
+const Transaction& HistoryLog::operator[](size_t i) const
+{
+    return at(directory.load(memory_order_acquire), i);
+}
+
+void HistoryLog::push_back(Transaction t)
+{
+    size_t n = size();
+    slotFor(n) = move(t);
+    count.store(n + 1, memory_order_release);
+}
+
+void HistoryLog::replaceFrom(size_t from, vector<Transaction> entries)
+{
+    if (entries.empty())
+        return;
+    size_t newSize = from + entries.size();
+
+    rewrites.fetch_add(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Published chunks are never written in place: each affected chunk
+    // is rebuilt and swapped in, and the old one retired.
+    size_t offset;
+    size_t first = chunkOf(from, offset);
+    size_t last = chunkOf(newSize - 1, offset);
+    Directory* dir = reserveChunks(last + 1);
+    for (size_t k = first; k <= last; ++k)
+    {
+        size_t start = FIRST_CHUNK * ((size_t(1) << k) - 1);
+        size_t end = min(start + chunkCapacity(k), newSize);
+        Transaction* old = dir->chunks[k].load(memory_order_relaxed);
+        Transaction* fresh = new Transaction[chunkCapacity(k)];
+        for (size_t j = start; j < end; ++j)
+            fresh[j - start] = j < from ? old[j - start] : move(entries[j - from]);
+
+        dir->chunks[k].store(fresh, memory_order_release);
+        if (old)
+            EpochDomain::shared().retireArray(old);
+    }
+
+    count.store(newSize, memory_order_release);
+    rewrites.fetch_add(1, memory_order_release);
+}
+
+void HistoryLog::read(vector<Transaction>& out) const
+{
+    auto guard = EpochDomain::shared().pin();
+    while (true)
+    {
+        uint64_t r = rewrites.load(memory_order_acquire);
+        if (r & 1)
+        {
+            this_thread::yield();
+            continue;
+        }
+
+        size_t n = count.load(memory_order_acquire);
+        const Directory* dir = directory.load(memory_order_acquire);
+        out.clear();
+        out.reserve(n);
+        for (size_t k = 0, start = 0; start < n; ++k)
+        {
+            const Transaction* entries = dir->chunks[k].load(memory_order_acquire);
+            size_t end = min(start + chunkCapacity(k), n);
+            out.insert(out.end(), entries, entries + (end - start));
+            start = end;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (rewrites.load(memory_order_relaxed) == r)
+            return;
+    }
+}
+
+// ========================================
+// SplitBalance
+// ========================================
+
+void SplitBalance::Slot::lock()
+{
+    for (int spins = 0; busy.exchange(true, memory_order_acquire); ++spins)
+    {
+        if (spins > 64)
+            this_thread::yield();
+    }
+}
+
+SplitBalance::SplitBalance(size_t n)
+    : count(n ? n : max<size_t>(1, thread::hardware_concurrency()))
+{
+    slots.reset(new Slot[count]);
+}
+
+SplitBalance::Slot& SplitBalance::local()
+{
+    // Threads are numbered once, in order of first use, so up to
+    // `count` threads each get a slot of their own.
+    static atomic<size_t> nextThread{0};
+    static thread_local size_t threadIndex = nextThread.fetch_add(1, memory_order_relaxed);
+    return slots[threadIndex % count];
+}
+
+double SplitBalance::total() const
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+        sum += slots[i].balance.load(memory_order_relaxed);
+    return sum;
+}
+
+// ========================================
+// Account
+// ========================================
+
+Account::Account(const Account& other)
+    : balance(other.getBalance()), id(other.id), currency(other.currency),
+      hot(other.hot), ownerId(other.ownerId), cold(make_unique<AccountCold>())
+{
+    version.store(other.version.load(memory_order_relaxed) & ~uint64_t(1),
+                  memory_order_relaxed);
+    cold->history = other.cold->history;
+
+    // The copy starts folded: slot money and pending history move into
+    // the base, and it keeps empty slots of its own.
+    if (other.hot)
+    {
+        const SplitBalance& split = *other.cold->split;
+        vector<Transaction> pending;
+        for (size_t i = 0; i < split.size(); ++i)
+        {
+            const auto& p = split.slot(i).pending;
+            pending.insert(pending.end(), p.begin(), p.end());
+        }
+        mergePending(cold->history, other.cold->foldMark, move(pending));
+        cold->split = make_unique<SplitBalance>(split.size());
+        cold->history.setPartial(true);
+    }
+    cold->foldMark = cold->history.size();
+    historyCount = static_cast<uint32_t>(cold->history.size());
+}
+
+Account::Account(Account&& other) noexcept
+    : balance(other.balance.load(memory_order_relaxed)), id(other.id),
+      currency(other.currency), hot(other.hot), historyCount(other.historyCount),
+      ownerId(other.ownerId), journalTicket(other.journalTicket), cold(move(other.cold))
+{
+    version.store(other.version.load(memory_order_relaxed) & ~uint64_t(1),
+                  memory_order_relaxed);
+}
+
+Account& Account::operator=(const Account& other)
+{
+    if (this != &other)
+        *this = Account(other);
+    return *this;
+}
+
+Account& Account::operator=(Account&& other) noexcept
+{
+    version.store(other.version.load(memory_order_relaxed) & ~uint64_t(1),
+                  memory_order_relaxed);
+    balance.store(other.balance.load(memory_order_relaxed), memory_order_relaxed);
+    id = other.id;
+    currency = other.currency;
+    hot = other.hot;
+    historyCount = other.historyCount;
+    ownerId = other.ownerId;
+    journalTicket = other.journalTicket;
+    cold = move(other.cold);
+    return *this;
+}
+
+// ========================================
+// Version lock
+// ========================================
+
+uint64_t Account::readBegin() const
+{
+    while (true)
+    {
+        uint64_t v = version.load(memory_order_acquire);
+        if ((v & 1) == 0)
+            return v;
+        this_thread::yield();
+    }
+}
+
+bool Account::validate(uint64_t v) const
+{
+    atomic_thread_fence(memory_order_acquire);
+    return version.load(memory_order_relaxed) == v;
+}
+
+bool Account::tryLock(uint64_t v)
+{
+    return (v & 1) == 0
+        && version.compare_exchange_strong(v, v + 1, memory_order_acquire,
+                                           memory_order_relaxed);
+}
+
+void Account::lock()
+{
+    for (int spins = 0;; ++spins)
+    {
+        uint64_t v = version.load(memory_order_relaxed);
+        if ((v & 1) == 0 && tryLock(v))
+            return;
+        if (spins > 64)
+            this_thread::yield();
+    }
+}
+
+void Account::unlock()
+{
+    version.fetch_add(1, memory_order_release);
+}
+
+void Account::unlockUnchanged(uint64_t v)
+{
+    version.store(v, memory_order_release);
+}
+
+// ========================================
+// Hot-account mode
+// ========================================
+
+void Account::mergePending(HistoryLog& dst, size_t mark,
+                           vector<Transaction> pending)
+{
+    if (pending.empty())
+        return;
+
+    auto byTime = [](const Transaction& a, const Transaction& b) {
+        return a.timestamp < b.timestamp;
+    };
+
+    // Each slot is already in order; base entries since `mark` may
+    // interleave with them. Usually there are none and the slots'
+    // entries are simply appended.
+    stable_sort(pending.begin(), pending.end(), byTime);
+    mark = min(mark, dst.size());
+    if (mark == dst.size())
+    {
+        for (auto& t : pending)
+            dst.push_back(move(t));
+        return;
+    }
+
+    vector<Transaction> tail;
+    for (size_t i = mark; i < dst.size(); ++i)
+        tail.push_back(dst[i]);
+    size_t middle = tail.size();
+    tail.insert(tail.end(), make_move_iterator(pending.begin()),
+                make_move_iterator(pending.end()));
+    inplace_merge(tail.begin(), tail.begin() + static_cast<ptrdiff_t>(middle), tail.end(), byTime);
+    dst.replaceFrom(mark, move(tail));
+}
+
+void Account::setHot(bool on)
+{
+    if (on == hot)
+        return;
+
+    if (on)
+    {
+        cold->split = make_unique<SplitBalance>();
+        cold->foldMark = cold->history.size();
+        cold->history.setPartial(true);
+        hot = true;
+        return;
+    }
+
+    foldSlots();
+    hot = false;
+    cold->history.setPartial(false);
+    cold->split.reset();
+}
+
+Transaction Account::hotDeposit(double amount)
+{
+    SplitBalance::Slot& slot = cold->split->local();
+    Transaction t{currentTime(), "DEPOSIT", amount};
+
+    slot.lock();
+    slot.balance.store(slot.balance.load(memory_order_relaxed) + amount,
+                       memory_order_relaxed);
+    slot.pending.push_back(t);
+    slot.unlock();
+    return t;
+}
+
+bool Account::hotWithdrawLocal(double amount, Transaction& out)
+{
+    SplitBalance::Slot& slot = cold->split->local();
+
+    slot.lock();
+    double available = slot.balance.load(memory_order_relaxed);
+    bool ok = available >= amount;
+    if (ok)
+    {
+        out = {currentTime(), "WITHDRAW", amount};
+        slot.balance.store(available - amount, memory_order_relaxed);
+        slot.pending.push_back(out);
+    }
+    slot.unlock();
+    return ok;
+}
+
+void Account::foldSlots()
+{
+    if (!hot)
+        return;
+
+    SplitBalance* split = cold->split.get();
+
+    // Slots are locked in index order and held together, so the fold
+    // sees one consistent total and no local withdrawal can spend money
+    // that is moving into the base.
+    vector<Transaction> pending;
+    double moved = 0.0;
+    for (size_t i = 0; i < split->size(); ++i)
+        split->slot(i).lock();
+
+    for (size_t i = 0; i < split->size(); ++i)
+    {
+        SplitBalance::Slot& slot = split->slot(i);
+        moved += slot.balance.load(memory_order_relaxed);
+        slot.balance.store(0.0, memory_order_relaxed);
+        for (auto& t : slot.pending)
+            pending.push_back(move(t));
+        slot.pending.clear();
+    }
+
+    addBalance(moved);
+    for (size_t i = split->size(); i-- > 0;)
+        split->slot(i).unlock();
+
+    mergePending(cold->history, cold->foldMark, move(pending));
+    cold->foldMark = cold->history.size();
+    historyCount = static_cast<uint32_t>(cold->history.size());
+}
+
+// ========================================
+// Mutations
+// ========================================
+
+void Account::deposit(double amount)
+{
+    addBalance(amount);
+    record({currentTime(), "DEPOSIT", amount});
+}
+
+bool Account::withdraw(double amount)
+{
+    if (amount > baseBalance())
+        return false;
+
+    addBalance(-amount);
+    record({currentTime(), "WITHDRAW", amount});
+    return true;
+}
+
+void Account::transferOut(double amount)
+{
+    addBalance(-amount);
+    record({currentTime(), "TRANSFER_OUT", amount});
+}
+
+void Account::transferIn(double amount)
+{
+    addBalance(amount);
+    record({currentTime(), "TRANSFER_IN", amount});
+}
+
+void Account::creditInterest(double amount)
+{
+    addBalance(amount);
+    record({currentTime(), "INTEREST", amount});
+}
+
+double balanceEffect(const Transaction& t)
+{
+    if (t.type == "DEPOSIT" || t.type == "TRANSFER_IN" || t.type == "INTEREST")
+        return t.amount;
+    if (t.type == "WITHDRAW" || t.type == "TRANSFER_OUT")
+        return -t.amount;
+    return 0.0;
+}
+
+double Account::replayedBalance() const
+{
+    double sum = 0.0;
+    cold->history.forEach([&](const Transaction& t) { sum += balanceEffect(t); });
+    return sum;
+}
+
+void Account::replay(const Transaction& t)
+{
+    addBalance(balanceEffect(t));
+    record(t);
+}
+
+string Account::serialize() const
+{
+    string out = to_string(id);
+    out += ';';
+    out += getOwner();
+    out += ';';
+    appendNumber(out, getBalance());
+    out += ';';
+    out += currencyCode(currency);
+    out += '\n';
+
+    cold->history.forEach([&](const Transaction& t) {
+        out += "T:";
+        out += t.serialize();
+        out += '\n';
+    });
+
+    out += "END\n";
+    return out;
+}
+
+void Account::prependHistory(vector<Transaction> older)
+{
+    if (older.empty())
+        return;
+
+    size_t added = older.size();
+    cold->history.forEach([&](const Transaction& t) { older.push_back(t); });
+    cold->history.replaceFrom(0, move(older));
+    cold->foldMark += added;
+    historyCount = static_cast<uint32_t>(cold->history.size());
+}
+
+Account Account::restore(const AccountHeader& header)
+{
+    Account acc(header.id, header.owner, header.currency);
+    acc.balance.store(header.balance, memory_order_relaxed);
+    return acc;
+}
@@ -0,0 +1,307 @@
+/*
+    Accounts and transactions
+*/
+
+#pragma once
+
+#include "currency.h"
+#include "intern.h"
+#include "textformat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Local time formatted as "YYYY-MM-DD HH:MM:SS".
+std::string currentTime();
+
+// ========================================
+// Transaction
+// ========================================
+
+struct Transaction
+{
+    std::string timestamp;
+    std::string type;
+    double amount;
+
+    // "<timestamp>|<type>|<amount>"; false if `line` is malformed.
+    std::string serialize() const;
+    static bool deserialize(std::string_view line, Transaction& out);
+};
+
+// Signed effect of a transaction on its account's balance.
+double balanceEffect(const Transaction& t);
+
+// ========================================
+// HistoryLog
+// ========================================
+
+// An account's transaction history. Entries live in chunks that double
+// in size and never move, so the single writer (holding the account
+// lock) appends without disturbing anyone, and read() copies the log
+// without the account lock. The chunk directory and chunks rewritten
+// by a hot-account fold are retired through EpochDomain.
+class HistoryLog
+{
+private:
+    static constexpr size_t FIRST_CHUNK = 1;
+
+    struct Directory
+    {
+        size_t capacity;
+        std::unique_ptr<std::atomic<Transaction*>[]> chunks;
+
+        explicit Directory(size_t capacity);
+    };
+
+    std::atomic<Directory*> directory{nullptr};
+    std::atomic<size_t> count{0};
+    // Odd while replaceFrom() swaps chunks; read() retries across it.
+    std::atomic<uint64_t> rewrites{0};
+    std::atomic<bool> partial{false};
+
+    static size_t chunkOf(size_t i, size_t& offset);
+    static size_t chunkCapacity(size_t chunk) { return FIRST_CHUNK << chunk; }
+    const Transaction& at(const Directory* dir, size_t i) const;
+    // Grows the directory to at least `chunks` slots.
+    Directory* reserveChunks(size_t chunks);
+    // Makes room for entry `i`; requires the writer's side.
+    Transaction& slotFor(size_t i);
+    void release();
+
+public:
+    HistoryLog() = default;
+    // Only while no other thread reads either log.
+    HistoryLog(const HistoryLog& other);
+    HistoryLog& operator=(const HistoryLog& other);
+    ~HistoryLog();
+
+    // ---- Writer side: account lock held ----
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+    const Transaction& operator[](size_t i) const;
+    const Transaction& back() const { return (*this)[size() - 1]; }
+    void push_back(Transaction t);
+    // Replaces entries from `from` on with `entries`.
+    void replaceFrom(size_t from, std::vector<Transaction> entries);
+
+    template <typename F>
+    void forEach(F&& fn) const
+    {
+        const Directory* dir = directory.load(std::memory_order_acquire);
+        for (size_t k = 0, start = 0, n = size(); start < n; ++k)
+        {
+            const Transaction* entries = dir->chunks[k].load(std::memory_order_acquire);
+            size_t end = std::min(start + chunkCapacity(k), n);
+            for (size_t i = start; i < end; ++i)
+                fn(entries[i - start]);
+            start = end;
+        }
+    }
+
+    // ---- Reader side: any thread, no lock ----
+    // Copies every published entry.
+    void read(std::vector<Transaction>& out) const;
+
+    // Set while some entries may still be parked outside the log (hot
+    // accounts); read() then misses them and callers must fold first.
+    bool isPartial() const { return partial.load(std::memory_order_acquire); }
+    void setPartial(bool on) { partial.store(on, std::memory_order_release); }
+};
+
+// ========================================
+// SplitBalance
+// ========================================
+
+// Per-core sub-balances for a designated hot account. Deposits land in
+// the calling thread's slot under that slot's own lock, so threads
+// depositing into the same account never share a cache line. Slots are
+// folded into the account's base balance and history lazily, when a
+// debit or a reader needs the whole picture.
+class SplitBalance
+{
+public:
+    struct alignas(64) Slot
+    {
+        std::atomic<bool> busy{false};
+        std::atomic<double> balance{0.0};
+        std::vector<Transaction> pending;
+
+        void lock();
+        void unlock() { busy.store(false, std::memory_order_release); }
+    };
+
+private:
+    std::unique_ptr<Slot[]> slots;
+    size_t count;
+
+public:
+    // One slot per hardware thread unless told otherwise.
+    explicit SplitBalance(size_t count = 0);
+
+    size_t size() const { return count; }
+    Slot& slot(size_t i) { return slots[i]; }
+    const Slot& slot(size_t i) const { return slots[i]; }
+
+    // The slot owned by the calling thread.
+    Slot& local();
+
+    double total() const;
+};
+
+// ========================================
+// Account
+// ========================================
+
+// Fields only needed for history reads and hot-mode bookkeeping.
+struct AccountCold
+{
+    HistoryLog history;
+    // Set for hot accounts only; getBalance() adds the slots to `balance`.
+    std::unique_ptr<SplitBalance> split;
+    // History before this index is already in timestamp order.
+    size_t foldMark = 0;
+};
+
+// An Account is one cache line holding the version lock, balance, id,
+// currency, history count and journal ticket; everything else lives in
+// a separately allocated AccountCold. Bank keeps Accounts in a dense
+// array, so a balance read or an optimistic validation costs one line
+// instead of two. Mutations still record into the cold HistoryLog, so
+// they touch the cold record as well (see account_layout_bench).
+class alignas(64) Account
+{
+private:
+    // Seqlock word: even = unlocked, odd = a writer holds the account.
+    // Every committed write bumps it by two, so an unchanged even value
+    // means nothing was modified in between.
+    std::atomic<uint64_t> version{0};
+    std::atomic<double> balance;
+    int id;
+    Currency currency;
+    bool hot = false;
+    uint32_t historyCount = 0;
+    uint32_t ownerId;  // in StringPool::owners()
+    // Where the account's last journal record is staged (see
+    // JournalBuffers); 0 if none.
+    uint64_t journalTicket = 0;
+    std::unique_ptr<AccountCold> cold;
+
+    static void mergePending(HistoryLog& dst, size_t mark,
+                             std::vector<Transaction> pending);
+
+    void addBalance(double delta)
+    {
+        balance.store(balance.load(std::memory_order_relaxed) + delta,
+                      std::memory_order_relaxed);
+    }
+
+    void record(Transaction t)
+    {
+        cold->history.push_back(std::move(t));
+        historyCount = static_cast<uint32_t>(cold->history.size());
+    }
+
+public:
+    // Placeholder for bulk loaders to assign over. It has no cold
+    // storage, so only assignment and destruction are valid on it.
+    Account() : balance(0.0), id(0), currency(Currency::USD),
+                ownerId(StringPool::EMPTY) {}
+
+    Account(int id, std::string_view owner, Currency currency = Currency::USD)
+        : balance(0.0), id(id), currency(currency),
+          ownerId(StringPool::owners().intern(owner)),
+          cold(std::make_unique<AccountCold>()) {}
+
+    // For bulk loaders that interned the owner already.
+    Account(int id, uint32_t ownerId, Currency currency)
+        : balance(0.0), id(id), currency(currency), ownerId(ownerId),
+          cold(std::make_unique<AccountCold>()) {}
+
+    // Copies and moves are only made while no other thread uses either
+    // account (loading, snapshots, growing the account store).
+    Account(const Account& other);
+    Account(Account&& other) noexcept;
+    Account& operator=(const Account& other);
+    Account& operator=(Account&& other) noexcept;
+
+    int getId() const { return id; }
+    const std::string& getOwner() const { return StringPool::owners().get(ownerId); }
+    // Two accounts have the same owner exactly when their ids match.
+    uint32_t getOwnerId() const { return ownerId; }
+    double getBalance() const
+    {
+        double b = balance.load(std::memory_order_relaxed);
+        return hot ? b + cold->split->total() : b;
+    }
+    Currency getCurrency() const { return currency; }
+    const HistoryLog& getHistory() const { return cold->history; }
+    // Number of folded history entries, without touching cold storage.
+    size_t historySize() const { return historyCount; }
+
+    // ---- Version lock ----
+    // Mutators below require the lock to be held when the account is
+    // shared between threads.
+
+    // Waits for an even version and returns it; pair with validate().
+    uint64_t readBegin() const;
+    // True if nothing was written since readBegin() returned `v`.
+    bool validate(uint64_t v) const;
+    // Locks only if the version is still `v`.
+    bool tryLock(uint64_t v);
+    void lock();
+    void unlock();
+    // Releases a lock taken with tryLock(v) without having written, so
+    // optimistic readers of `v` stay valid.
+    void unlockUnchanged(uint64_t v);
+    uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+    // Requires the version lock, like the mutators below.
+    uint64_t getJournalTicket() const { return journalTicket; }
+    void setJournalTicket(uint64_t ticket) { journalTicket = ticket; }
+
+    // ---- Hot-account mode ----
+    bool isHot() const { return hot; }
+    // Only while no other thread uses the account.
+    void setHot(bool hot);
+    // Lock-free with respect to the version lock: only the caller's slot
+    // is locked. Returns the recorded transaction.
+    Transaction hotDeposit(double amount);
+    // Withdraws from the caller's own slot if it alone covers `amount`.
+    bool hotWithdrawLocal(double amount, Transaction& out);
+    // Moves every slot into the base balance and history, merging
+    // history by timestamp. Requires the version lock.
+    void foldSlots();
+    // The part of the balance a locked debit may spend: after
+    // foldSlots() nothing else can withdraw it concurrently.
+    double baseBalance() const { return balance.load(std::memory_order_relaxed); }
+
+    void deposit(double amount);
+    bool withdraw(double amount);
+    void transferOut(double amount);
+    void transferIn(double amount);
+    void creditInterest(double amount);
+
+    // Balance obtained by replaying the full history from zero.
+    double replayedBalance() const;
+
+    // Re-applies a recorded transaction, keeping its original timestamp.
+    void replay(const Transaction& t);
+
+    // Puts entries older than everything recorded so far in front of
+    // the history, for histories loaded after the account. Requires the
+    // version lock.
+    void prependHistory(std::vector<Transaction> older);
+
+    // The snapshot block: header line, one "T:" line per transaction,
+    // "END" (see textformat.h).
+    std::string serialize() const;
+    // The account a snapshot header describes, without its history.
+    static Account restore(const AccountHeader& header);
+};
+
+static_assert(sizeof(Account) == 64, "Account must stay one cache line");
@@ -0,0 +1,280 @@
+#include "accountstore.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+using namespace std;
+
+static const char STORE_MAGIC[8] = {'B', 'A', 'N', 'K', 'A', 'C', 'C', 'T'};
+static const uint32_t STORE_VERSION = 1;
+
+// Page 0: magic, version, record size, next id.
+struct StoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    int32_t nextId;
+};
+
+struct AccountRecord
+{
+    int32_t id;
+    uint8_t currency;
+    uint8_t ownerLength;
+    uint16_t reserved;
+    double balance;
+    char owner[AccountStore::MAX_OWNER];
+};
+static_assert(sizeof(AccountRecord) == 64, "records must tile a page");
+
+static const size_t RECORDS_PER_PAGE = PAGE_SIZE / sizeof(AccountRecord);
+
+static bool validAmount(double amount)
+{
+    return isfinite(amount) && amount > 0.0;
+}
+
+static uint64_t pageOf(int id)
+{
+    return 1 + static_cast<uint64_t>(id - 1) / RECORDS_PER_PAGE;
+}
+
+static size_t offsetOf(int id)
+{
+    return static_cast<size_t>(id - 1) % RECORDS_PER_PAGE * sizeof(AccountRecord);
+}
+
+static AccountRecord readRecord(const BufferPool::PageRef& page, int id)
+{
+    AccountRecord rec;
+    memcpy(&rec, page.data() + offsetOf(id), sizeof(rec));
+    return rec;
+}
+
+static void writeRecord(BufferPool::PageRef& page, const AccountRecord& rec)
+{
+    memcpy(page.data() + offsetOf(rec.id), &rec, sizeof(rec));
+    page.markDirty();
+}
+
+AccountStore::~AccountStore()
+{
+    close();
+}
+
+bool AccountStore::open(const string& path, size_t cachePages, CachePolicy policy)
+{
+    close();
+    if (!file.open(path))
+        return false;
+
+    bool created = file.pageCount() == 0;
+    pool = make_unique<BufferPool>(file, cachePages, policy);
+    BufferPool::PageRef page = pool->fetch(0);
+    if (!page)
+    {
+        close();
+        return false;
+    }
+
+    StoreHeader header;
+    if (created)
+    {
+        memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        header.version = STORE_VERSION;
+        header.recordSize = sizeof(AccountRecord);
+        header.nextId = 1;
+        memcpy(page.data(), &header, sizeof(header));
+        page.markDirty();
+    }
+    else
+    {
+        memcpy(&header, page.data(), sizeof(header));
+        if (memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0
+            || header.version != STORE_VERSION || header.recordSize != sizeof(AccountRecord)
+            || header.nextId < 1)
+        {
+            page.release();
+            close();
+            return false;
+        }
+    }
+    nextId.store(header.nextId, memory_order_release);
+    return true;
+}
+
+void AccountStore::close()
+{
+    if (!pool)
+        return;
+    pool->flush();
+    pool.reset();
+    file.close();
+    nextId.store(1, memory_order_release);
+}
+
+int AccountStore::createAccount(string_view owner, Currency currency)
+{
+    if (!pool || owner.empty() || owner.size() > MAX_OWNER)
+        return 0;
+
+    lock_guard<mutex> lock(createMutex);
+    int id = nextId.load(memory_order_relaxed);
+
+    // A new page past the end of the file reads as zeros.
+    BufferPool::PageRef page = pool->fetch(pageOf(id));
+    BufferPool::PageRef header = pool->fetch(0);
+    if (!page || !header)
+        return 0;
+
+    AccountRecord rec{};
+    rec.id = id;
+    rec.currency = static_cast<uint8_t>(currency);
+    rec.ownerLength = static_cast<uint8_t>(owner.size());
+    memcpy(rec.owner, owner.data(), owner.size());
+    {
+        unique_lock<shared_mutex> latch(page.latch());
+        writeRecord(page, rec);
+    }
+    {
+        unique_lock<shared_mutex> latch(header.latch());
+        int32_t next = id + 1;
+        memcpy(header.data() + offsetof(StoreHeader, nextId), &next, sizeof(next));
+        header.markDirty();
+    }
+
+    // Published last: other threads treat ids below nextId as present.
+    nextId.store(id + 1, memory_order_release);
+    return id;
+}
+
+bool AccountStore::find(int id, StoredAccount& out)
+{
+    if (!pool || id < 1 || id >= nextId.load(memory_order_acquire))
+        return false;
+
+    BufferPool::PageRef page = pool->fetch(pageOf(id));
+    if (!page)
+        return false;
+    AccountRecord rec;
+    {
+        shared_lock<shared_mutex> latch(page.latch());
+        rec = readRecord(page, id);
+    }
+    if (rec.id != id)
+        return false;
+
+    out.id = id;
+    out.owner.assign(rec.owner, min<size_t>(rec.ownerLength, MAX_OWNER));
+    out.currency = static_cast<Currency>(rec.currency);
+    out.balance = rec.balance;
+    return true;
+}
+
+Result AccountStore::deposit(int id, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+    if (!pool || id < 1 || id >= nextId.load(memory_order_acquire))
+        return Result::AccountNotFound;
+
+    BufferPool::PageRef page = pool->fetch(pageOf(id));
+    if (!page)
+        return Result::StorageError;
+
+    unique_lock<shared_mutex> latch(page.latch());
+    AccountRecord rec = readRecord(page, id);
+    rec.balance += amount;
+    writeRecord(page, rec);
+    return Result::Ok;
+}
+
+Result AccountStore::withdraw(int id, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+    if (!pool || id < 1 || id >= nextId.load(memory_order_acquire))
+        return Result::AccountNotFound;
+
+    BufferPool::PageRef page = pool->fetch(pageOf(id));
+    if (!page)
+        return Result::StorageError;
+
+    unique_lock<shared_mutex> latch(page.latch());
+    AccountRecord rec = readRecord(page, id);
+    if (rec.balance < amount)
+        return Result::InsufficientFunds;
+    rec.balance -= amount;
+    writeRecord(page, rec);
+    return Result::Ok;
+}
+
+Result AccountStore::transfer(int from, int to, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+    int limit = nextId.load(memory_order_acquire);
+    if (!pool || from < 1 || from >= limit || to < 1 || to >= limit)
+        return Result::AccountNotFound;
+
+    // Both pages stay pinned for the whole transfer; their latches are
+    // taken in page order so opposite transfers cannot deadlock.
+    uint64_t fromPage = pageOf(from);
+    uint64_t toPage = pageOf(to);
+    BufferPool::PageRef src = pool->fetch(fromPage);
+    BufferPool::PageRef dstPinned;
+    if (toPage != fromPage)
+        dstPinned = pool->fetch(toPage);
+    BufferPool::PageRef& dst = toPage != fromPage ? dstPinned : src;
+    if (!src || !dst)
+        return Result::StorageError;
+
+    unique_lock<shared_mutex> first((fromPage <= toPage ? src : dst).latch());
+    unique_lock<shared_mutex> second;
+    if (toPage != fromPage)
+        second = unique_lock<shared_mutex>((fromPage <= toPage ? dst : src).latch());
+
+    AccountRecord accFrom = readRecord(src, from);
+    AccountRecord accTo = readRecord(dst, to);
+    Currency fromCur = static_cast<Currency>(accFrom.currency);
+    Currency toCur = static_cast<Currency>(accTo.currency);
+    double converted;
+    {
+        shared_lock<shared_mutex> lock(ratesMutex);
+        if (!rates.canConvert(fromCur, toCur))
+            return Result::NoExchangeRate;
+        converted = rates.convert(amount, fromCur, toCur);
+    }
+    if (accFrom.balance < amount)
+        return Result::InsufficientFunds;
+
+    accFrom.balance -= amount;
+    writeRecord(src, accFrom);
+    // Re-read: `to` may share the record with `from`.
+    accTo = readRecord(dst, to);
+    accTo.balance += converted;
+    writeRecord(dst, accTo);
+    return Result::Ok;
+}
+
+Result AccountStore::setExchangeRate(Currency c, double inUsd)
+{
+    if (c == Currency::USD || !validAmount(inUsd))
+        return Result::InvalidAmount;
+
+    unique_lock<shared_mutex> lock(ratesMutex);
+    rates.setRate(c, inUsd);
+    return Result::Ok;
+}
+
+bool AccountStore::flush()
+{
+    return pool && pool->flush();
+}
+
+BufferPoolStats AccountStore::cacheStats() const
+{
+    return pool ? pool->stats() : BufferPoolStats{};
+}
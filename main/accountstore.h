@@ -0,0 +1,89 @@
+/*
+    Disk-backed account store
+    --------------------------------
+    Accounts kept in a page file rather than in memory, for books with
+    more accounts than fit in RAM. Each account is a fixed 64-byte
+    record, 64 to a page after the header page. Ids are handed out
+    densely from 1, so the id-to-page index is arithmetic and costs no
+    memory at all.
+
+    Every access goes through a BufferPool of a fixed number of pages,
+    so memory use is bounded whatever the account count. deposit,
+    withdraw and transfer give the same Results as Bank's, whether the
+    page was cached or had to be read in; cacheStats() reports the hit
+    rate and fault latency.
+
+    Changes reach the file when their page is replaced or on flush().
+    There is no log, so a crash loses changes made since the last
+    flush. Transaction histories and exchange rates are not stored.
+*/
+
+#pragma once
+
+#include "currency.h"
+#include "pagestore.h"
+#include "result.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+struct StoredAccount
+{
+    int id = 0;
+    std::string owner;
+    Currency currency = Currency::USD;
+    double balance = 0.0;
+};
+
+class AccountStore
+{
+private:
+    PageFile file;
+    std::unique_ptr<BufferPool> pool;
+    std::atomic<int> nextId{1};
+    // Serializes account creation, which extends the file.
+    std::mutex createMutex;
+    mutable std::shared_mutex ratesMutex;
+    RateTable rates;
+
+public:
+    // Owners are stored inline and may be at most this many bytes.
+    static constexpr size_t MAX_OWNER = 48;
+
+    AccountStore() = default;
+    ~AccountStore();
+
+    AccountStore(const AccountStore&) = delete;
+    AccountStore& operator=(const AccountStore&) = delete;
+
+    // Opens or creates the store at `path`, caching at most
+    // `cachePages` pages. False if the file is not an account store.
+    bool open(const std::string& path, size_t cachePages, CachePolicy policy = CachePolicy::Arc);
+    void close();
+    bool isOpen() const { return pool != nullptr; }
+
+    // Returns the new account's id, or 0 if the owner is empty or too
+    // long or the page could not be read or written.
+    int createAccount(std::string_view owner, Currency currency = Currency::USD);
+    bool find(int id, StoredAccount& out);
+    size_t accountCount() const
+    {
+        return static_cast<size_t>(nextId.load(std::memory_order_acquire) - 1);
+    }
+
+    // Each returns Result::StorageError if the account's page could not
+    // be read in.
+    Result deposit(int id, double amount);
+    Result withdraw(int id, double amount);
+    // `amount` is in the source account's currency.
+    Result transfer(int from, int to, double amount);
+    Result setExchangeRate(Currency c, double inUsd);
+
+    // Writes back every changed page and syncs the file.
+    bool flush();
+    BufferPoolStats cacheStats() const;
+};
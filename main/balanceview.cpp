@@ -0,0 +1,190 @@
+#include "balanceview.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+using namespace std;
+
+static size_t segmentSize(size_t capacity)
+{
+    return sizeof(BalanceViewHeader) + capacity * sizeof(BalanceViewSlot);
+}
+
+// ========================================
+// BalanceView
+// ========================================
+
+unique_ptr<BalanceView> BalanceView::create(const string& name, size_t capacity)
+{
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return nullptr;
+
+    // ftruncate zero-fills, which is an empty table with even sequences.
+    size_t size = segmentSize(capacity);
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    unique_ptr<BalanceView> view(new BalanceView());
+    view->name = name;
+    view->base = base;
+    view->mapSize = size;
+    view->header = new (base) BalanceViewHeader();
+    view->slots = reinterpret_cast<BalanceViewSlot*>(static_cast<char*>(base) + sizeof(BalanceViewHeader));
+
+    view->header->magic = BalanceViewHeader::MAGIC;
+    view->header->version = BalanceViewHeader::VERSION;
+    view->header->slotSize = sizeof(BalanceViewSlot);
+    view->header->capacity = capacity;
+    view->header->live.store(1, memory_order_release);
+    return view;
+}
+
+BalanceView::~BalanceView()
+{
+    header->live.store(0, memory_order_release);
+    munmap(base, mapSize);
+    shm_unlink(name.c_str());
+}
+
+bool BalanceView::grow(size_t capacity)
+{
+    if (capacity <= header->capacity)
+        return true;
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    // The new slots are zero-filled; the capacity moves only once they
+    // are mapped, so publish() never reaches past the mapping.
+    size_t size = segmentSize(capacity);
+    bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0;
+    ::close(fd);
+    if (!ok)
+        return false;
+
+    void* moved = mremap(base, mapSize, size, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED)
+        return false;
+
+    base = moved;
+    mapSize = size;
+    header = static_cast<BalanceViewHeader*>(base);
+    slots = reinterpret_cast<BalanceViewSlot*>(static_cast<char*>(base) + sizeof(BalanceViewHeader));
+    header->capacity = capacity;
+    return true;
+}
+
+bool BalanceView::claim(BalanceViewSlot& slot, bool wait, uint32_t& seq)
+{
+    seq = slot.seq.load(memory_order_relaxed);
+    while (true)
+    {
+        if (!(seq & 1) && slot.seq.compare_exchange_weak(seq, seq + 1, memory_order_acquire))
+        {
+            // Order the odd sequence before the data stores.
+            atomic_thread_fence(memory_order_release);
+            return true;
+        }
+        if (!wait)
+            return false;
+        if (seq & 1)
+            this_thread::yield();
+        seq = slot.seq.load(memory_order_relaxed);
+    }
+}
+
+void BalanceView::publish(int id, double balance, Currency currency)
+{
+    if (id < 0 || static_cast<size_t>(id) >= header->capacity)
+        return;
+
+    BalanceViewSlot& slot = slots[id];
+    uint32_t seq;
+    claim(slot, true, seq);
+    slot.currency.store(static_cast<uint32_t>(currency) + 1, memory_order_relaxed);
+    slot.balance.store(balance, memory_order_relaxed);
+    slot.seq.store(seq + 2, memory_order_release);
+}
+
+void BalanceView::tryPublish(int id, double balance, Currency currency)
+{
+    if (id < 0 || static_cast<size_t>(id) >= header->capacity)
+        return;
+
+    BalanceViewSlot& slot = slots[id];
+    uint32_t seq;
+    if (!claim(slot, false, seq))
+        return;
+    slot.currency.store(static_cast<uint32_t>(currency) + 1, memory_order_relaxed);
+    slot.balance.store(balance, memory_order_relaxed);
+    slot.seq.store(seq + 2, memory_order_release);
+}
+
+// ========================================
+// BalanceViewReader
+// ========================================
+
+BalanceViewReader::~BalanceViewReader()
+{
+    close();
+}
+
+bool BalanceViewReader::open(const string& name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(BalanceViewHeader))
+        mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    base = mapped;
+    mapSize = static_cast<size_t>(st.st_size);
+    header = static_cast<const BalanceViewHeader*>(base);
+
+    if (header->magic != BalanceViewHeader::MAGIC || header->version != BalanceViewHeader::VERSION
+        || header->slotSize != sizeof(BalanceViewSlot))
+    {
+        close();
+        return false;
+    }
+
+    // A segment growing while it is opened may be mapped at its old size
+    // but already report the new capacity.
+    slots = reinterpret_cast<const BalanceViewSlot*>(static_cast<const char*>(base) + sizeof(BalanceViewHeader));
+    slotCount = min<size_t>(header->capacity, (mapSize - sizeof(BalanceViewHeader)) / sizeof(BalanceViewSlot));
+    return true;
+}
+
+void BalanceViewReader::close()
+{
+    if (base)
+        munmap(const_cast<void*>(base), mapSize);
+    base = nullptr;
+    header = nullptr;
+    slots = nullptr;
+    slotCount = 0;
+    mapSize = 0;
+}
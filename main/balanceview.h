@@ -0,0 +1,180 @@
+/*
+    Shared-memory balance view
+    --------------------------------
+    Bank::publishBalanceView() creates a POSIX shared-memory segment
+    holding every account's balance in a table indexed by account id.
+    Co-located processes map it read-only with BalanceViewReader and
+    read a balance in a few loads, with no IPC:
+
+        BalanceViewReader view;
+        view.open("/consolebank");
+        double balance;
+        Currency currency;
+        if (view.read(42, balance, currency))
+            ...
+
+    Each slot is its own seqlock: the bank bumps the slot's sequence to
+    odd, writes, and bumps it back to even; a reader retries until it
+    sees the same even sequence before and after its loads. Readers
+    never write to the segment, so they cannot slow the bank down.
+
+    The table's capacity is chosen when it is created; ids at or beyond
+    it are not published. Bank grows the segment in place before its ids
+    get there, so a reader's mapping stays current for the ids it
+    covers and open() again picks up the new ones.
+*/
+
+#pragma once
+
+#include "currency.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// ========================================
+// Segment layout
+// ========================================
+
+struct alignas(64) BalanceViewHeader
+{
+    static constexpr uint64_t MAGIC = 0x57454956424b4e42ull;  // "BNKBVIEW"
+    static constexpr uint32_t VERSION = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t capacity;
+    // Cleared when the bank withdraws the view.
+    std::atomic<uint32_t> live;
+};
+
+struct BalanceViewSlot
+{
+    std::atomic<uint32_t> seq;
+    // Currency + 1; 0 means no account has this id.
+    std::atomic<uint32_t> currency;
+    std::atomic<double> balance;
+};
+
+static_assert(sizeof(BalanceViewSlot) == 16, "four slots per cache line");
+static_assert(std::atomic<uint32_t>::is_always_lock_free
+              && std::atomic<double>::is_always_lock_free,
+              "slots are shared between processes");
+
+// ========================================
+// BalanceView (writer)
+// ========================================
+
+// Owned by Bank. A slot may be published from several threads (hot
+// accounts take deposits without the account lock), so writers claim
+// the slot by moving its sequence from even to odd.
+class BalanceView
+{
+private:
+    std::string name;
+    void* base = nullptr;
+    size_t mapSize = 0;
+    BalanceViewHeader* header = nullptr;
+    BalanceViewSlot* slots = nullptr;
+
+    BalanceView() = default;
+
+    bool claim(BalanceViewSlot& slot, bool wait, uint32_t& seq);
+
+public:
+    // Creates (or replaces) the segment `name`, e.g. "/consolebank".
+    // Returns nullptr on failure.
+    static std::unique_ptr<BalanceView> create(const std::string& name, size_t capacity);
+    ~BalanceView();
+
+    BalanceView(const BalanceView&) = delete;
+    BalanceView& operator=(const BalanceView&) = delete;
+
+    size_t capacity() const { return header->capacity; }
+    const std::string& getName() const { return name; }
+
+    // Extends the segment to `capacity` slots without disturbing readers
+    // of the existing ones. On failure the view keeps its old capacity.
+    // No publish() may run concurrently.
+    bool grow(size_t capacity);
+
+    // Waits for any other writer of the slot.
+    void publish(int id, double balance, Currency currency);
+
+    // Skips the update if another thread is writing the slot right now;
+    // that thread's value is at most a few concurrent deposits behind.
+    void tryPublish(int id, double balance, Currency currency);
+};
+
+// ========================================
+// BalanceViewReader
+// ========================================
+
+class BalanceViewReader
+{
+private:
+    const void* base = nullptr;
+    size_t mapSize = 0;
+    const BalanceViewHeader* header = nullptr;
+    const BalanceViewSlot* slots = nullptr;
+    size_t slotCount = 0;
+
+    // A writer that died mid-update would leave its slot odd forever.
+    static constexpr int MAX_SPINS = 1 << 20;
+
+public:
+    BalanceViewReader() = default;
+    ~BalanceViewReader();
+
+    BalanceViewReader(const BalanceViewReader&) = delete;
+    BalanceViewReader& operator=(const BalanceViewReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+
+    size_t capacity() const { return slotCount; }
+
+    // False once the bank has withdrawn the view (it was destroyed or
+    // republished); values read after that are frozen.
+    bool isLive() const
+    {
+        return header && header->live.load(std::memory_order_acquire) != 0;
+    }
+
+    // False if the id has no account (or is out of range).
+    bool read(int id, double& balance, Currency& currency) const
+    {
+        if (id < 0 || static_cast<size_t>(id) >= slotCount)
+            return false;
+
+        const BalanceViewSlot& slot = slots[id];
+        for (int spins = 0; spins < MAX_SPINS; ++spins)
+        {
+            uint32_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+            {
+                // The writer may have been preempted mid-update.
+                if ((spins & 63) == 63)
+                    std::this_thread::yield();
+                continue;
+            }
+
+            uint32_t c = slot.currency.load(std::memory_order_relaxed);
+            double b = slot.balance.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq)
+                continue;
+
+            if (c == 0)
+                return false;
+            balance = b;
+            currency = static_cast<Currency>(c - 1);
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,1748 @@
+#include "bank.h"
+#include "bloom.h"
+#include "changefeed.h"
+#include "columnar.h"
+#include "epoch.h"
+#include "import.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+
+using namespace std;
+
+static bool validAmount(double amount)
+{
+    return isfinite(amount) && amount > 0.0;
+}
+
+// Journal amounts must round-trip exactly.
+static string formatAmount(double amount)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", amount);
+    return buf;
+}
+
+// Accounts per parallel chunk for bulk jobs.
+static const size_t BULK_GRAIN = 1024;
+
+// Accounts or orders per slice of a job that shares the bank with
+// requests while it runs; a slice holds up nothing for long.
+static const size_t BULK_SLICE = 256;
+
+// Optimistic transfer attempts before falling back to locking.
+static const int OPTIMISTIC_RETRIES = 8;
+
+// Accounts per row group of a columnar export.
+static const size_t EXPORT_ROW_GROUP = 64 * BULK_GRAIN;
+
+// Bytes a checkpoint writer buffers between writes.
+static const size_t CHECKPOINT_WRITE_CHUNK = 1 << 20;
+
+static const size_t NO_SLOT = static_cast<size_t>(-1);
+
+struct HistoryIndex
+{
+    size_t capacity;
+    unique_ptr<atomic<const HistoryLog*>[]> logs;
+};
+
+struct AccountFilter
+{
+    size_t capacity;
+    BlockedBloomFilter ids;
+};
+
+struct HistoryWarmup
+{
+    static constexpr uint8_t PENDING = 0;
+    static constexpr uint8_t LOADING = 1;
+    static constexpr uint8_t LOADED = 2;
+
+    // Byte range of one account's "T:" lines in the snapshot, and the
+    // line number of the first, for diagnostics.
+    struct Segment
+    {
+        size_t begin;
+        size_t end;
+        size_t line;
+    };
+
+    // The snapshot, mapped until every history is in.
+    const char* base = nullptr;
+    size_t size = 0;
+    // Indexed by slot. Accounts added after load() are never pending.
+    vector<Segment> segments;
+    unique_ptr<atomic<uint8_t>[]> states;
+
+    ~HistoryWarmup() { unmap(); }
+
+    void unmap()
+    {
+        if (base)
+            munmap(const_cast<char*>(base), size);
+        base = nullptr;
+    }
+};
+
+Bank::Bank(const string& filename, const string& ratesFilename)
+    : filename(filename), ratesFilename(ratesFilename), executor(Executor::shared())
+{
+    load();
+
+    if (!filename.empty())
+        journal.open(filename + ".journal");
+}
+
+Bank::~Bank()
+{
+    save();
+    delete historyIndex.load(memory_order_relaxed);
+    delete idFilter.load(memory_order_relaxed);
+}
+
+void Bank::addAccount(Account acc)
+{
+    int id = acc.getId();
+    if (id >= 0)
+    {
+        if (static_cast<size_t>(id) >= index.size())
+            index.resize(static_cast<size_t>(id) + 1, NO_SLOT);
+        index[id] = accounts.size();
+        reserveHistoryIndex(static_cast<size_t>(id) + 1);
+        reserveIdFilter(accounts.size() + 1);
+        reserveBalanceView(static_cast<size_t>(id) + 1);
+        idFilter.load(memory_order_relaxed)->ids.insert(static_cast<uint64_t>(id));
+    }
+    accounts.push_back(move(acc));
+    indexHistory(accounts.back());
+    nextId = max(nextId, id + 1);
+}
+
+void Bank::reserveHistoryIndex(size_t ids)
+{
+    HistoryIndex* current = historyIndex.load(memory_order_relaxed);
+    if (current && current->capacity >= ids)
+        return;
+
+    // Readers may still be walking the old index, so it is replaced
+    // and retired rather than resized.
+    size_t capacity = current ? current->capacity : BULK_GRAIN;
+    while (capacity < ids)
+        capacity *= 2;
+    auto grown = new HistoryIndex{capacity, make_unique<atomic<const HistoryLog*>[]>(capacity)};
+    if (current)
+    {
+        for (size_t i = 0; i < current->capacity; ++i)
+            grown->logs[i].store(current->logs[i].load(memory_order_relaxed), memory_order_relaxed);
+    }
+    historyIndex.store(grown, memory_order_release);
+    if (current)
+        EpochDomain::shared().retire(current);
+}
+
+void Bank::reserveIdFilter(size_t n)
+{
+    AccountFilter* current = idFilter.load(memory_order_relaxed);
+    if (current && current->capacity >= n)
+        return;
+
+    // Bloom filters cannot grow, so a bigger one is built from the
+    // account store and swapped in; readers finish with the old one.
+    size_t capacity = current ? current->capacity : BULK_GRAIN;
+    while (capacity < n)
+        capacity *= 2;
+    auto grown = new AccountFilter{capacity, BlockedBloomFilter(capacity)};
+    for (const Account& acc : accounts)
+    {
+        if (acc.getId() >= 0)
+            grown->ids.insert(static_cast<uint64_t>(acc.getId()));
+    }
+    idFilter.store(grown, memory_order_release);
+    if (current)
+        EpochDomain::shared().retire(current);
+}
+
+bool Bank::accountMayExist(int id) const
+{
+    if (id < 0)
+        return false;
+    auto guard = EpochDomain::shared().pin();
+    const AccountFilter* filter = idFilter.load(memory_order_acquire);
+    return filter && filter->ids.mayContain(static_cast<uint64_t>(id));
+}
+
+// Logs stay put when their Account moves, so the index survives the
+// account store growing.
+void Bank::indexHistory(const Account& acc)
+{
+    if (acc.getId() < 0)
+        return;
+    HistoryIndex* current = historyIndex.load(memory_order_relaxed);
+    current->logs[acc.getId()].store(&acc.getHistory(), memory_order_release);
+}
+
+int Bank::createAccount(const string& owner, Currency currency)
+{
+    uint32_t ownerId = StringPool::owners().intern(owner);
+    if (ownerId == StringPool::NONE)
+        return 0;
+
+    unique_lock<shared_mutex> structure(structureMutex);
+    int id = nextId;
+    addAccount(Account(id, ownerId, currency));
+    publishBalance(accounts.back());
+    if (journal.isOpen())
+    {
+        journal.append("C|" + to_string(id) + "|" + currencyCode(currency)
+                       + "|" + owner);
+    }
+    return id;
+}
+
+void Bank::logTransaction(Account& acc, const Transaction& t)
+{
+    if (!journal.isOpen())
+        return;
+
+    stageRecord("X|" + to_string(acc.getId()) + "|" + t.timestamp + "|" + t.type
+                + "|" + formatAmount(t.amount), acc);
+}
+
+void Bank::stageRecord(const string& record, Account& first, Account* second)
+{
+    // Hot accounts journal from their slots without the account lock, so
+    // their records carry no order across threads to keep.
+    Account* changed[2] = {first.isHot() ? nullptr : &first,
+                           second && !second->isHot() ? second : nullptr};
+    for (Account* acc : changed)
+    {
+        if (acc)
+            journalBuffers.publishBefore(acc->getJournalTicket());
+    }
+    uint64_t ticket = journalBuffers.add(record);
+    for (Account* acc : changed)
+    {
+        if (acc)
+            acc->setJournalTicket(ticket);
+    }
+}
+
+// Record formats (after the sequence number):
+//   C|id|currency|owner
+//   X|id|timestamp|type|amount
+//   T|from|to|timestamp|amountOut|amountIn
+//   R|currency|usdValue
+void Bank::applyRecord(const string& record)
+{
+    // A malformed record is skipped rather than aborting recovery.
+    JournalRecord r;
+    if (!parseJournalRecord(record, r))
+        return;
+
+    switch (r.kind)
+    {
+    case RecordKind::AccountCreated:
+        if (!findAccount(r.account))
+            addAccount(Account(r.account, r.owner, r.currency));
+        break;
+    case RecordKind::Transaction:
+        if (Account* acc = findAccount(r.account))
+            acc->replay({r.timestamp, r.type, r.amount});
+        break;
+    case RecordKind::Transfer:
+    {
+        Account* accFrom = findAccount(r.account);
+        Account* accTo = findAccount(r.target);
+        if (!accFrom || !accTo)
+            return;
+        accFrom->replay({r.timestamp, "TRANSFER_OUT", r.amount});
+        accTo->replay({r.timestamp, "TRANSFER_IN", r.amountIn});
+        break;
+    }
+    case RecordKind::RateChanged:
+        rates.setRate(r.currency, r.amount);
+        break;
+    }
+}
+
+Account* Bank::findAccount(int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= index.size() || index[id] == NO_SLOT)
+        return nullptr;
+    return &accounts[index[id]];
+}
+
+const Account* Bank::findAccount(int id) const
+{
+    return const_cast<Bank*>(this)->findAccount(id);
+}
+
+vector<int> Bank::findByOwner(const string& owner) const
+{
+    vector<int> ids;
+    uint32_t ownerId = StringPool::owners().find(owner);
+    if (ownerId == StringPool::NONE)
+        return ids;
+
+    shared_lock<shared_mutex> structure(structureMutex);
+    for (const auto& acc : accounts)
+    {
+        if (acc.getOwnerId() == ownerId)
+            ids.push_back(acc.getId());
+    }
+    return ids;
+}
+
+Result Bank::deposit(int id, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+
+    shared_lock<shared_mutex> structure(structureMutex);
+    Account* acc = findAccount(id);
+    if (!acc)
+        return Result::AccountNotFound;
+
+    // Hot accounts take deposits in per-thread slots without the
+    // account lock.
+    if (acc->isHot())
+    {
+        logTransaction(*acc, acc->hotDeposit(amount));
+        if (balanceView)
+            balanceView->tryPublish(id, acc->getBalance(), acc->getCurrency());
+        return Result::Ok;
+    }
+
+    acc->lock();
+    acc->deposit(amount);
+    logTransaction(*acc, acc->getHistory().back());
+    publishBalance(*acc);
+    acc->unlock();
+    return Result::Ok;
+}
+
+Result Bank::withdraw(int id, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+
+    shared_lock<shared_mutex> structure(structureMutex);
+    Account* acc = findAccount(id);
+    if (!acc)
+        return Result::AccountNotFound;
+
+    if (acc->isHot())
+    {
+        Transaction t;
+        if (acc->hotWithdrawLocal(amount, t))
+        {
+            logTransaction(*acc, t);
+            if (balanceView)
+                balanceView->tryPublish(id, acc->getBalance(), acc->getCurrency());
+            return Result::Ok;
+        }
+    }
+
+    // The locked path borrows across all slots of a hot account.
+    acc->lock();
+    acc->foldSlots();
+    bool ok = acc->withdraw(amount);
+    if (ok)
+    {
+        logTransaction(*acc, acc->getHistory().back());
+        publishBalance(*acc);
+    }
+    acc->unlock();
+
+    return ok ? Result::Ok : Result::InsufficientFunds;
+}
+
+void Bank::commitTransfer(Account& accFrom, Account& accTo, double amount, double converted)
+{
+    accFrom.transferOut(amount);
+    accTo.transferIn(converted);
+    publishBalance(accFrom);
+    publishBalance(accTo);
+
+    if (journal.isOpen())
+    {
+        stageRecord("T|" + to_string(accFrom.getId()) + "|" + to_string(accTo.getId())
+                    + "|" + accFrom.getHistory().back().timestamp + "|"
+                    + formatAmount(amount) + "|" + formatAmount(converted),
+                    accFrom, &accTo);
+    }
+}
+
+// Locks both accounts in id order, so concurrent transfers in opposite
+// directions cannot deadlock.
+Result Bank::transferLocked(Account& accFrom, Account& accTo, double amount, double converted)
+{
+    Account& first = accFrom.getId() <= accTo.getId() ? accFrom : accTo;
+    Account& second = &first == &accFrom ? accTo : accFrom;
+
+    first.lock();
+    if (&second != &first)
+        second.lock();
+
+    accFrom.foldSlots();
+
+    Result r = Result::InsufficientFunds;
+    if (accFrom.baseBalance() >= amount)
+    {
+        commitTransfer(accFrom, accTo, amount, converted);
+        r = Result::Ok;
+    }
+
+    if (&second != &first)
+        second.unlock();
+    first.unlock();
+
+    if (r == Result::Ok)
+        lockedCommits.fetch_add(1, memory_order_relaxed);
+    return r;
+}
+
+// Reads both versions and the source balance without locking, checks
+// funds, then commits only if neither version moved: taking each lock
+// with a CAS from the version that was read is the validation. On
+// conflict it retries, and after OPTIMISTIC_RETRIES falls back to
+// transferLocked() so progress is guaranteed.
+Result Bank::transferOptimistic(Account& accFrom, Account& accTo, double amount, double converted)
+{
+    Account& first = accFrom.getId() <= accTo.getId() ? accFrom : accTo;
+    Account& second = &first == &accFrom ? accTo : accFrom;
+    bool same = &first == &second;
+
+    for (int attempt = 0; attempt < OPTIMISTIC_RETRIES; ++attempt)
+    {
+        optimisticAttempts.fetch_add(1, memory_order_relaxed);
+        if (attempt > 0)
+            optimisticRetries.fetch_add(1, memory_order_relaxed);
+
+        uint64_t vFirst = first.readBegin();
+        uint64_t vSecond = same ? vFirst : second.readBegin();
+        double balance = accFrom.getBalance();
+
+        if (!first.validate(vFirst) || (!same && !second.validate(vSecond)))
+        {
+            optimisticConflicts.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+
+        // A validated read: the funds check is as good as under a lock.
+        if (balance < amount)
+            return Result::InsufficientFunds;
+
+        if (!first.tryLock(vFirst))
+        {
+            optimisticConflicts.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+        if (!same && !second.tryLock(vSecond))
+        {
+            first.unlockUnchanged(vFirst);
+            optimisticConflicts.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+
+        commitTransfer(accFrom, accTo, amount, converted);
+
+        if (!same)
+            second.unlock();
+        first.unlock();
+
+        optimisticCommits.fetch_add(1, memory_order_relaxed);
+        return Result::Ok;
+    }
+
+    optimisticFallbacks.fetch_add(1, memory_order_relaxed);
+    return transferLocked(accFrom, accTo, amount, converted);
+}
+
+Result Bank::transfer(int from, int to, double amount)
+{
+    if (!validAmount(amount))
+        return Result::InvalidAmount;
+
+    shared_lock<shared_mutex> structure(structureMutex);
+    Account* accFrom = findAccount(from);
+    Account* accTo = findAccount(to);
+
+    if (!accFrom || !accTo)
+        return Result::AccountNotFound;
+
+    // Currency is fixed at creation and rates only change under the
+    // exclusive lock, so conversion needs no account lock.
+    Currency fromCur = accFrom->getCurrency();
+    Currency toCur = accTo->getCurrency();
+    if (!rates.canConvert(fromCur, toCur))
+        return Result::NoExchangeRate;
+
+    double converted = rates.convert(amount, fromCur, toCur);
+
+    // Hot accounts change through their slots without bumping the
+    // version, so they always take the locked path.
+    if (concurrencyMode.load(memory_order_relaxed) == ConcurrencyMode::Optimistic
+        && !accFrom->isHot() && !accTo->isHot())
+        return transferOptimistic(*accFrom, *accTo, amount, converted);
+    return transferLocked(*accFrom, *accTo, amount, converted);
+}
+
+Result Bank::setHotAccount(int id, bool hot)
+{
+    unique_lock<shared_mutex> structure(structureMutex);
+    Account* acc = findAccount(id);
+    if (!acc)
+        return Result::AccountNotFound;
+
+    // Records staged while the account was hot have no order; publish
+    // them before the account's records start to keep one.
+    journalBuffers.publishAll();
+    acc->setHot(hot);
+    return Result::Ok;
+}
+
+Result Bank::balance(int id, double& out) const
+{
+    shared_lock<shared_mutex> structure(structureMutex);
+    const Account* acc = findAccount(id);
+    if (!acc)
+        return Result::AccountNotFound;
+    out = acc->getBalance();
+    return Result::Ok;
+}
+
+Result Bank::history(int id, vector<Transaction>& out) const
+{
+    if (warming.load(memory_order_acquire))
+    {
+        shared_lock<shared_mutex> structure(structureMutex);
+        if (id >= 0 && static_cast<size_t>(id) < index.size() && index[id] != NO_SLOT)
+            const_cast<Bank*>(this)->warmHistory(index[id]);
+    }
+
+    {
+        auto guard = EpochDomain::shared().pin();
+        const HistoryIndex* logs = historyIndex.load(memory_order_acquire);
+        const HistoryLog* log = nullptr;
+        if (logs && id >= 0 && static_cast<size_t>(id) < logs->capacity)
+            log = logs->logs[id].load(memory_order_acquire);
+        if (log && !log->isPartial())
+        {
+            log->read(out);
+            return Result::Ok;
+        }
+    }
+
+    // Hot accounts (and ids the index does not cover) go through the
+    // account lock.
+    shared_lock<shared_mutex> structure(structureMutex);
+    Account* acc = const_cast<Bank*>(this)->findAccount(id);
+    if (!acc)
+        return Result::AccountNotFound;
+
+    acc->lock();
+    acc->foldSlots();
+    acc->getHistory().read(out);
+    acc->unlock();
+    return Result::Ok;
+}
+
+void Bank::foldHotAccounts()
+{
+    for (auto& acc : accounts)
+    {
+        if (acc.isHot())
+            acc.foldSlots();
+    }
+}
+
+ConcurrencyStats Bank::concurrencyStats() const
+{
+    ConcurrencyStats st;
+    st.lockedCommits = lockedCommits.load(memory_order_relaxed);
+    st.optimisticAttempts = optimisticAttempts.load(memory_order_relaxed);
+    st.optimisticCommits = optimisticCommits.load(memory_order_relaxed);
+    st.optimisticConflicts = optimisticConflicts.load(memory_order_relaxed);
+    st.optimisticRetries = optimisticRetries.load(memory_order_relaxed);
+    st.optimisticFallbacks = optimisticFallbacks.load(memory_order_relaxed);
+    return st;
+}
+
+Result Bank::setExchangeRate(Currency c, double inUsd)
+{
+    if (c == Currency::USD || !validAmount(inUsd))
+        return Result::InvalidAmount;
+
+    unique_lock<shared_mutex> structure(structureMutex);
+    rates.setRate(c, inUsd);
+    if (journal.isOpen())
+        journal.append(string("R|") + currencyCode(c) + "|" + formatAmount(inUsd));
+    return Result::Ok;
+}
+
+void Bank::revalueBalances(Currency reporting, vector<double>& out) const
+{
+    shared_lock<shared_mutex> structure(structureMutex);
+    size_t n = accounts.size();
+    vector<double> balances(n);
+    vector<Currency> currencies(n);
+    out.resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        balances[i] = accounts[i].getBalance();
+        currencies[i] = accounts[i].getCurrency();
+    }
+
+    rates.convertBatch(balances.data(), currencies.data(), n,
+                       reporting, out.data());
+}
+
+vector<AuditFinding> Bank::audit(const CancellationToken& token) const
+{
+    const_cast<Bank*>(this)->waitForHistory();
+    unique_lock<shared_mutex> structure(structureMutex);
+    const_cast<Bank*>(this)->foldHotAccounts();
+
+    vector<AuditFinding> findings;
+    mutex findingsMutex;
+
+    executor.parallelFor(accounts.size(), BULK_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const Account& acc = accounts[i];
+            double replayed = acc.replayedBalance();
+
+            // Snapshots store balances with limited precision.
+            double tolerance = 1e-6 * max(1.0, fabs(acc.getBalance()));
+            if (fabs(replayed - acc.getBalance()) > tolerance)
+            {
+                lock_guard<mutex> lock(findingsMutex);
+                findings.push_back({acc.getId(), acc.getBalance(), replayed});
+            }
+        }
+    }, Priority::Bulk, token);
+
+    sort(findings.begin(), findings.end(),
+         [](const AuditFinding& a, const AuditFinding& b) { return a.id < b.id; });
+    return findings;
+}
+
+size_t Bank::accrueInterest(double rate, const CancellationToken& token)
+{
+    if (!isfinite(rate) || rate <= 0.0)
+        return 0;
+
+    size_t n;
+    {
+        shared_lock<shared_mutex> structure(structureMutex);
+        n = accounts.size();
+    }
+
+    // Each slice credits its accounts the way a deposit would, under the
+    // shared lock and each account's own lock, so requests carry on
+    // between (and alongside) slices.
+    atomic<size_t> credited{0};
+    executor.parallelFor(n, BULK_SLICE, [&](size_t begin, size_t end) {
+        shared_lock<shared_mutex> structure(structureMutex);
+        size_t local = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            Account& acc = accounts[i];
+            acc.lock();
+            double balance = acc.getBalance();
+            if (balance > 0.0)
+            {
+                acc.creditInterest(balance * rate);
+                logTransaction(acc, acc.getHistory().back());
+                publishBalance(acc);
+                ++local;
+            }
+            acc.unlock();
+        }
+        credited.fetch_add(local, memory_order_relaxed);
+    }, Priority::Bulk, token);
+
+    return credited.load();
+}
+
+vector<Result> Bank::transferBatch(const vector<TransferOrder>& orders, const CancellationToken& token)
+{
+    vector<Result> results(orders.size(), Result::Cancelled);
+    executor.parallelFor(orders.size(), BULK_SLICE, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const TransferOrder& o = orders[i];
+            // Batches from outside often carry stale ids; skip the locks.
+            if (!accountMayExist(o.from) || !accountMayExist(o.to))
+                results[i] = Result::AccountNotFound;
+            else
+                results[i] = transfer(o.from, o.to, o.amount);
+        }
+    }, Priority::Bulk, token);
+    return results;
+}
+
+ImportReport Bank::importAccounts(const string& path)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open())
+        return {};
+
+    string data(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(data.data(), static_cast<streamsize>(data.size())))
+        return {};
+    return importAccountData(data);
+}
+
+ImportReport Bank::importAccountData(string_view data)
+{
+    ImportReport report;
+    report.readable = true;
+
+    // Parse and validate, in parallel, without holding the bank.
+    vector<ImportChunk> chunks = parseImport(data, executor);
+
+    vector<size_t> offsets(chunks.size() + 1, 0);
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        offsets[c + 1] = offsets[c] + chunks[c].rows.size();
+        report.rejected += chunks[c].rejected;
+        if (report.firstRejected == 0)
+            report.firstRejected = chunks[c].firstRejected;
+    }
+
+    size_t n = offsets.back();
+    if (n == 0)
+        return report;
+
+    // Owners are interned before the store grows, so a full pool turns
+    // the import away without leaving placeholder accounts behind.
+    vector<vector<uint32_t>> ownerIds(chunks.size());
+    atomic<bool> interned{true};
+    executor.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+        {
+            const auto& rows = chunks[c].rows;
+            vector<string_view> names(rows.size());
+            for (size_t k = 0; k < rows.size(); ++k)
+                names[k] = rows[k].owner;
+            ownerIds[c].resize(rows.size());
+            if (!StringPool::owners().internBatch(names.data(), names.size(), ownerIds[c].data()))
+                interned.store(false, memory_order_relaxed);
+        }
+    });
+    if (!interned.load())
+    {
+        report.rejected += n;
+        return report;
+    }
+
+    string timestamp = currentTime();
+
+    unique_lock<shared_mutex> structure(structureMutex);
+
+    // Allocate ids and pre-size the store and index once.
+    int firstId = nextId;
+    size_t base = accounts.size();
+    reserveIdFilter(base + n);
+    BlockedBloomFilter& filter = idFilter.load(memory_order_relaxed)->ids;
+    accounts.resize(base + n);
+    index.resize(max(index.size(), static_cast<size_t>(firstId) + n), NO_SLOT);
+    reserveHistoryIndex(static_cast<size_t>(firstId) + n);
+    reserveBalanceView(static_cast<size_t>(firstId) + n);
+
+    bool journaled = journal.isOpen();
+    vector<string> records(journaled ? chunks.size() : 0);
+
+    executor.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+        {
+            const auto& rows = chunks[c].rows;
+            for (size_t k = 0; k < rows.size(); ++k)
+            {
+                size_t slot = base + offsets[c] + k;
+                int id = firstId + static_cast<int>(offsets[c] + k);
+
+                Account acc(id, ownerIds[c][k], rows[k].currency);
+                if (rows[k].balance > 0.0)
+                    acc.replay({timestamp, "DEPOSIT", rows[k].balance});
+                accounts[slot] = move(acc);
+                index[id] = slot;
+                indexHistory(accounts[slot]);
+                filter.insert(static_cast<uint64_t>(id));
+                publishBalance(accounts[slot]);
+
+                if (!journaled)
+                    continue;
+                string& out = records[c];
+                out += "C|" + to_string(id) + "|" + currencyCode(rows[k].currency) + "|";
+                out.append(rows[k].owner);
+                out += '\n';
+                if (rows[k].balance > 0.0)
+                {
+                    out += "X|" + to_string(id) + "|" + timestamp + "|DEPOSIT|"
+                           + formatAmount(rows[k].balance) + "\n";
+                }
+            }
+        }
+    });
+
+    nextId = firstId + static_cast<int>(n);
+    journal.appendBatch(records);
+
+    report.imported = n;
+    report.firstId = firstId;
+    return report;
+}
+
+// "YYYY-MM-DD HH:MM:SS" as seconds since 1970-01-01 00:00:00 on the same
+// wall clock (history timestamps carry no zone); 0 if malformed.
+static int64_t wallClockSeconds(const string& ts)
+{
+    static const char* const PATTERN = "dddd-dd-dd dd:dd:dd";
+    if (ts.size() != 19)
+        return 0;
+    for (size_t i = 0; i < 19; ++i)
+    {
+        if (PATTERN[i] == 'd' ? !isdigit(static_cast<unsigned char>(ts[i])) : ts[i] != PATTERN[i])
+            return 0;
+    }
+
+    auto num = [&](size_t pos, size_t len) {
+        int64_t v = 0;
+        for (size_t i = pos; i < pos + len; ++i)
+            v = v * 10 + (ts[i] - '0');
+        return v;
+    };
+    int64_t y = num(0, 4), m = num(5, 2), d = num(8, 2);
+
+    // Days from the civil date (proleptic Gregorian).
+    y -= m <= 2;
+    int64_t era = y / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+
+    return days * 86400 + num(11, 2) * 3600 + num(14, 2) * 60 + num(17, 2);
+}
+
+ExportReport Bank::exportColumnar(const string& prefix, const CancellationToken& token)
+{
+    ExportReport report;
+
+    // The cut: every balance and history length at one instant. Entries
+    // before a recorded length never change afterwards, so the export
+    // can read them later under each account's own lock.
+    struct Cut
+    {
+        double balance;
+        size_t historyCount;
+    };
+    vector<Cut> cut;
+
+    waitForHistory();
+    auto pauseStart = chrono::steady_clock::now();
+    {
+        unique_lock<shared_mutex> structure(structureMutex);
+        foldHotAccounts();
+        journalBuffers.publishAll();
+        report.snapshotSeq = journal.lastSeq();
+        cut.resize(accounts.size());
+        for (size_t i = 0; i < accounts.size(); ++i)
+            cut[i] = {accounts[i].getBalance(), accounts[i].historySize()};
+    }
+    report.pauseMs = chrono::duration<double, milli>(chrono::steady_clock::now() - pauseStart).count();
+
+    // Accounts only move under the exclusive lock; holding it shared
+    // keeps them in place without blocking money movement.
+    shared_lock<shared_mutex> structure(structureMutex);
+
+    const vector<ColumnSpec> accountSchema = {
+        {"id", ColumnType::Int64},
+        {"owner", ColumnType::String},
+        {"currency", ColumnType::String},
+        {"balance", ColumnType::Double},
+        {"history_count", ColumnType::Int64},
+    };
+    const vector<ColumnSpec> txSchema = {
+        {"account_id", ColumnType::Int64},
+        {"timestamp", ColumnType::Int64},
+        {"type", ColumnType::String},
+        {"amount", ColumnType::Double},
+    };
+
+    string accountsPath = prefix + ".accounts.col";
+    string txPath = prefix + ".transactions.col";
+    ColumnarWriter accountOut(accountsPath + ".tmp", "accounts", accountSchema, report.snapshotSeq);
+    ColumnarWriter txOut(txPath + ".tmp", "transactions", txSchema, report.snapshotSeq);
+
+    auto abandon = [&] {
+        remove((accountsPath + ".tmp").c_str());
+        remove((txPath + ".tmp").c_str());
+        return report;
+    };
+    if (!accountOut.isOpen() || !txOut.isOpen())
+        return abandon();
+
+    // Row groups are encoded in waves of a few per thread and written in
+    // order, so memory stays bounded by the wave.
+    size_t groups = (cut.size() + EXPORT_ROW_GROUP - 1) / EXPORT_ROW_GROUP;
+    size_t wave = max<size_t>(2, executor.threadCount() * 2);
+
+    for (size_t first = 0; first < groups; first += wave)
+    {
+        size_t count = min(wave, groups - first);
+        vector<EncodedRowGroup> encodedAccounts(count);
+        vector<EncodedRowGroup> encodedTx(count);
+
+        bool finished = executor.parallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+            {
+                size_t lo = (first + k) * EXPORT_ROW_GROUP;
+                size_t hi = min(cut.size(), lo + EXPORT_ROW_GROUP);
+
+                vector<ColumnData> acc(accountSchema.size());
+                vector<ColumnData> tx(txSchema.size());
+                for (size_t i = lo; i < hi; ++i)
+                {
+                    Account& a = accounts[i];
+                    acc[0].ints.push_back(a.getId());
+                    acc[1].strings.push_back(a.getOwner());
+                    acc[2].strings.push_back(currencyCode(a.getCurrency()));
+                    acc[3].doubles.push_back(cut[i].balance);
+                    acc[4].ints.push_back(static_cast<int64_t>(cut[i].historyCount));
+
+                    a.lock();
+                    const auto& history = a.getHistory();
+                    for (size_t h = 0; h < cut[i].historyCount; ++h)
+                    {
+                        tx[0].ints.push_back(a.getId());
+                        tx[1].ints.push_back(wallClockSeconds(history[h].timestamp));
+                        tx[2].strings.push_back(history[h].type);
+                        tx[3].doubles.push_back(history[h].amount);
+                    }
+                    a.unlock();
+                }
+
+                encodedAccounts[k] = encodeRowGroup(accountSchema, acc);
+                encodedTx[k] = encodeRowGroup(txSchema, tx);
+            }
+        }, Priority::Bulk, token);
+
+        if (!finished)
+            return abandon();
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            accountOut.writeRowGroup(encodedAccounts[k]);
+            txOut.writeRowGroup(encodedTx[k]);
+            report.accounts += encodedAccounts[k].rows;
+            report.transactions += encodedTx[k].rows;
+        }
+        report.rowGroups += count;
+    }
+
+    bool written = accountOut.finish();
+    written = txOut.finish() && written;
+    if (!written)
+        return abandon();
+
+    if (rename((accountsPath + ".tmp").c_str(), accountsPath.c_str()) != 0
+        || rename((txPath + ".tmp").c_str(), txPath.c_str()) != 0)
+        return abandon();
+
+    report.ok = true;
+    return report;
+}
+
+// First entry of history[lo, n) at or after `timestamp`.
+static size_t lowerBoundTime(const HistoryLog& history, size_t lo, size_t n, const string& timestamp)
+{
+    while (lo < n)
+    {
+        size_t mid = lo + (n - lo) / 2;
+        if (history[mid].timestamp < timestamp)
+            lo = mid + 1;
+        else
+            n = mid;
+    }
+    return lo;
+}
+
+StatementReport Bank::generateStatements(const StatementPeriod& period, const string& prefix,
+                                         size_t shards, const CancellationToken& token)
+{
+    StatementReport report;
+    if (period.to < period.from)
+        return report;
+    auto start = chrono::steady_clock::now();
+
+    struct Cut
+    {
+        double balance;
+        size_t historyCount;
+    };
+    vector<Cut> cut;
+
+    waitForHistory();
+    {
+        unique_lock<shared_mutex> structure(structureMutex);
+        foldHotAccounts();
+        journalBuffers.publishAll();
+        report.snapshotSeq = journal.lastSeq();
+        cut.resize(accounts.size());
+        for (size_t i = 0; i < accounts.size(); ++i)
+            cut[i] = {accounts[i].getBalance(), accounts[i].historySize()};
+    }
+    shared_lock<shared_mutex> structure(structureMutex);
+
+    if (shards == 0)
+        shards = executor.threadCount();
+    shards = max<size_t>(1, min(shards, cut.size()));
+    vector<string> paths(shards);
+    for (size_t s = 0; s < shards; ++s)
+        paths[s] = prefix + "." + to_string(s) + ".stmt";
+
+    struct Shard
+    {
+        bool ok = false;
+        size_t statements = 0;
+        size_t transactions = 0;
+        size_t bytes = 0;
+    };
+    vector<Shard> results(shards);
+
+    bool finished = executor.parallelFor(shards, 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s)
+        {
+            StatementFile file(paths[s] + ".tmp");
+            if (!file.isOpen())
+                continue;
+            Shard& shard = results[s];
+            size_t lo = cut.size() * s / shards;
+            size_t hi = cut.size() * (s + 1) / shards;
+            for (size_t i = lo; i < hi && !token.isCancelled(); ++i)
+            {
+                Account& a = accounts[i];
+                a.lock();
+                const HistoryLog& history = a.getHistory();
+                size_t n = cut[i].historyCount;
+                size_t first = lowerBoundTime(history, 0, n, period.from);
+                size_t last = lowerBoundTime(history, first, n, period.to);
+
+                // Balances at the period's ends, worked back from the cut.
+                StatementTotals totals;
+                totals.closing = cut[i].balance;
+                for (size_t h = last; h < n; ++h)
+                    totals.closing -= balanceEffect(history[h]);
+                totals.opening = totals.closing;
+                for (size_t h = first; h < last; ++h)
+                    totals.opening -= balanceEffect(history[h]);
+
+                string& out = file.buffer();
+                appendStatementHeader(out, a.getId(), a.getOwner(), a.getCurrency(), period,
+                                      totals.opening);
+                double running = totals.opening;
+                for (size_t h = first; h < last; ++h)
+                {
+                    double effect = balanceEffect(history[h]);
+                    running += effect;
+                    if (effect >= 0.0)
+                    {
+                        totals.credits += effect;
+                        ++totals.creditCount;
+                    }
+                    else
+                    {
+                        totals.debits -= effect;
+                        ++totals.debitCount;
+                    }
+                    appendStatementLine(out, history[h], effect, running);
+                }
+                a.unlock();
+
+                appendStatementFooter(out, totals);
+                file.flushIfFull();
+                ++shard.statements;
+                shard.transactions += last - first;
+            }
+            shard.ok = file.finish();
+            shard.bytes = file.bytesWritten();
+        }
+    }, Priority::Bulk, token);
+
+    bool ok = finished && !token.isCancelled();
+    for (size_t s = 0; s < shards; ++s)
+    {
+        ok = ok && results[s].ok;
+        report.statements += results[s].statements;
+        report.transactions += results[s].transactions;
+        report.bytes += results[s].bytes;
+    }
+    for (size_t s = 0; s < shards; ++s)
+    {
+        if (!ok || rename((paths[s] + ".tmp").c_str(), paths[s].c_str()) != 0)
+        {
+            remove((paths[s] + ".tmp").c_str());
+            ok = false;
+        }
+    }
+
+    report.ok = ok;
+    report.shards = shards;
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+bool Bank::enableChangeFeed(const string& path)
+{
+    if (!journal.isOpen())
+        return false;
+    string feed = path.empty() ? filename + ".cdc" : path;
+
+    // Exclusive, so no record can be appended between the flush, the
+    // backlog scan and the mirror taking over.
+    unique_lock<shared_mutex> structure(structureMutex);
+    journalBuffers.publishAll();
+    journal.flush();
+
+    uint64_t feedSeq = recoverChangeFeed(feed);
+    string backlog;
+    replayJournal([&](uint64_t seq, const string& record) {
+        if (seq > feedSeq)
+            backlog += to_string(seq) + "|" + record + "\n";
+    });
+    return journal.openMirror(feed, backlog);
+}
+
+void Bank::reserveBalanceView(size_t ids)
+{
+    if (!balanceView || balanceView->capacity() >= ids)
+        return;
+
+    // Ids past the old capacity were skipped, so once there is room the
+    // ones a failed growth left out are published now.
+    size_t covered = balanceView->capacity();
+    if (!balanceView->grow(2 * ids + BULK_GRAIN))
+    {
+        balanceViewShort.store(true, memory_order_release);
+        return;
+    }
+    balanceViewShort.store(false, memory_order_release);
+    for (const auto& acc : accounts)
+    {
+        if (static_cast<size_t>(acc.getId()) >= covered)
+            publishBalance(acc);
+    }
+}
+
+bool Bank::publishBalanceView(const string& name, size_t capacity)
+{
+    unique_lock<shared_mutex> structure(structureMutex);
+    if (capacity == 0)
+        capacity = 2 * static_cast<size_t>(nextId) + BULK_GRAIN;
+
+    balanceView.reset();
+    balanceView = BalanceView::create(name, capacity);
+    balanceViewShort.store(false, memory_order_release);
+    if (!balanceView)
+        return false;
+
+    for (const auto& acc : accounts)
+        publishBalance(acc);
+    return true;
+}
+
+// ========================================
+// Snapshot index
+// ========================================
+
+// The snapshot index ("<filename>.index") lets load() find every
+// account without reading the histories in between:
+//
+//     #index <seq> <snapshot bytes>
+//     <history offset> <history bytes> <header line number> <account header>
+//
+// It is only used if its seq and size match the snapshot and every
+// entry parses; otherwise load() scans the snapshot itself.
+
+// Index line for an account serialized as `block` at byte `offset`,
+// starting on line `line`. Returns the number of lines in the block.
+static size_t appendIndexEntry(string& out, size_t offset, size_t line, string_view block)
+{
+    size_t eol = block.find('\n');
+    size_t begin = offset + eol + 1;
+    // Every block ends in "END\n".
+    size_t end = offset + block.size() - 4;
+    out += to_string(begin) + " " + to_string(end - begin) + " " + to_string(line) + " ";
+    out.append(block.substr(0, eol + 1));
+    return static_cast<size_t>(count(block.begin(), block.end(), '\n'));
+}
+
+static string indexHeader(uint64_t seq, size_t snapshotBytes)
+{
+    return "#index " + to_string(seq) + " " + to_string(snapshotBytes) + "\n";
+}
+
+struct SnapshotEntry
+{
+    AccountHeader account;
+    HistoryWarmup::Segment history;
+};
+
+// "#seq N" on the snapshot's first line; 0 for files without one.
+static uint64_t snapshotSeqOf(string_view data)
+{
+    if (data.compare(0, 5, "#seq ") != 0)
+        return 0;
+    uint64_t seq = 0;
+    from_chars(data.data() + 5, data.data() + data.size(), seq);
+    return seq;
+}
+
+// Reads the entries from `index`; false if it does not describe this
+// snapshot. The owners point into `index`.
+static bool readSnapshotIndex(string_view index, uint64_t seq, size_t size,
+                              vector<SnapshotEntry>& entries)
+{
+    size_t eol = index.find('\n');
+    if (eol == string_view::npos || index.substr(0, eol + 1) != indexHeader(seq, size))
+        return false;
+
+    for (size_t pos = eol + 1; pos < index.size(); pos = eol + 1)
+    {
+        eol = index.find('\n', pos);
+        if (eol == string_view::npos)
+            return false;
+
+        const char* p = index.data() + pos;
+        const char* end = index.data() + eol;
+        size_t fields[3];
+        for (size_t& field : fields)
+        {
+            auto r = from_chars(p, end, field);
+            if (r.ec != errc() || r.ptr == end || *r.ptr != ' ')
+                return false;
+            p = r.ptr + 1;
+        }
+        if (fields[0] > size || fields[1] > size - fields[0])
+            return false;
+
+        SnapshotEntry entry;
+        if (parseAccountHeader(string_view(p, static_cast<size_t>(end - p)), entry.account))
+            return false;
+        entry.history = {fields[0], fields[0] + fields[1], fields[2] + 1};
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const string& data)
+{
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0)
+            return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Writes `data` to a new file at `path` and syncs it.
+static bool writeSynced(const string& path, const string& data)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = writeAll(fd, data) && fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// Makes renames and removals in the directory holding `path` durable.
+static bool syncDirectoryOf(const string& path)
+{
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+static bool replaceFile(const string& path, const string& data)
+{
+    string tmp = path + ".tmp";
+    {
+        ofstream file(tmp);
+        file << data;
+        if (!file)
+            return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// ========================================
+// Persistence
+// ========================================
+
+void Bank::save()
+{
+    if (filename.empty())
+        return;
+
+    waitForHistory();
+    unique_lock<shared_mutex> structure(structureMutex);
+    waitForCheckpoint();
+    foldHotAccounts();
+
+    // Accounts are serialized in parallel chunks, then written in order.
+    size_t chunks = (accounts.size() + BULK_GRAIN - 1) / BULK_GRAIN;
+    vector<string> parts(chunks);
+    vector<size_t> sizes(accounts.size());
+    executor.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+        {
+            size_t last = min(accounts.size(), (c + 1) * BULK_GRAIN);
+            for (size_t i = c * BULK_GRAIN; i < last; ++i)
+            {
+                size_t before = parts[c].size();
+                parts[c] += accounts[i].serialize();
+                sizes[i] = parts[c].size() - before;
+            }
+        }
+    });
+
+    // The snapshot goes to a temporary file that replaces the old one
+    // atomically; its "#seq" line records the last journal record it
+    // includes.
+    journalBuffers.publishAll();
+    uint64_t seq = journal.lastSeq();
+    string header = "#seq " + to_string(seq) + "\n";
+    string tmp = filename + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    bool ok = writeAll(fd, header);
+    for (const auto& part : parts)
+        ok = ok && writeAll(fd, part);
+    ok = ok && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok)
+        return;
+
+    // The rates go the same way. Both renames must be on disk before the
+    // journal records they cover are dropped.
+    if (!ratesFilename.empty())
+    {
+        string ratesTmp = ratesFilename + ".tmp";
+        if (!rates.save(ratesTmp) || rename(ratesTmp.c_str(), ratesFilename.c_str()) != 0
+            || !syncDirectoryOf(ratesFilename))
+            return;
+    }
+    if (rename(tmp.c_str(), filename.c_str()) != 0 || !syncDirectoryOf(filename))
+        return;
+
+    snapshotSeq.store(seq, memory_order_release);
+    journal.truncate();
+    remove((filename + ".journal.old").c_str());
+
+    string entries;
+    size_t offset = header.size();
+    size_t line = 2;
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        size_t pos = 0;
+        size_t last = min(accounts.size(), (c + 1) * BULK_GRAIN);
+        for (size_t i = c * BULK_GRAIN; i < last; ++i)
+        {
+            line += appendIndexEntry(entries, offset + pos, line,
+                                     string_view(parts[c]).substr(pos, sizes[i]));
+            pos += sizes[i];
+        }
+        offset += parts[c].size();
+    }
+    replaceFile(filename + ".index", indexHeader(seq, offset) + entries);
+}
+
+void Bank::load()
+{
+    if (filename.empty())
+        return;
+
+    rates.load(ratesFilename);
+
+    // Only balances are read now; each account's history stays in the
+    // mapped snapshot until the warm-up (or a request for it) gets to it.
+    auto snapshot = make_unique<HistoryWarmup>();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                snapshot->base = static_cast<const char*>(mapped);
+                snapshot->size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    if (snapshot->base)
+    {
+        string_view data(snapshot->base, snapshot->size);
+        snapshotSeq.store(snapshotSeqOf(data), memory_order_release);
+
+        // The index makes this independent of how much history the
+        // snapshot holds; without a current one, scan the whole file.
+        vector<SnapshotEntry> entries;
+        string index;
+        {
+            ifstream file(filename + ".index", ios::binary);
+            if (file.is_open())
+                index.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        }
+        if (index.empty()
+            || !readSnapshotIndex(index, snapshotSeq.load(memory_order_acquire), snapshot->size, entries))
+        {
+            // A damaged block is set aside and the rest still load.
+            entries.clear();
+            SnapshotReader reader(data);
+            SnapshotReader::Block block;
+            ParseError error;
+            SnapshotReader::Status status;
+            while ((status = reader.next(block, error)) != SnapshotReader::Status::End)
+            {
+                if (status == SnapshotReader::Status::Corrupt)
+                {
+                    quarantine(error, data.substr(block.begin, block.end - block.begin));
+                    continue;
+                }
+                entries.push_back({block.account, {block.historyBegin, block.historyEnd, block.line + 1}});
+            }
+        }
+
+        vector<Account> parsed(entries.size());
+        executor.parallelFor(entries.size(), BULK_GRAIN / 4, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b)
+                parsed[b] = Account::restore(entries[b].account);
+        });
+
+        size_t first = accounts.size();
+        accounts.reserve(first + parsed.size());
+        for (auto& acc : parsed)
+            addAccount(move(acc));
+
+        snapshot->segments.assign(first, HistoryWarmup::Segment{0, 0, 0});
+        snapshot->states = make_unique<atomic<uint8_t>[]>(accounts.size());
+        bool pending = false;
+        for (size_t b = 0; b < entries.size(); ++b)
+        {
+            snapshot->segments.push_back(entries[b].history);
+            bool empty = entries[b].history.begin >= entries[b].history.end;
+            snapshot->states[first + b].store(empty ? HistoryWarmup::LOADED : HistoryWarmup::PENDING,
+                                              memory_order_relaxed);
+            pending = pending || !empty;
+        }
+        for (size_t i = 0; i < first; ++i)
+            snapshot->states[i].store(HistoryWarmup::LOADED, memory_order_relaxed);
+
+        if (pending)
+            warmup = move(snapshot);
+    }
+
+    // Journal records land after the snapshot's history, which the
+    // warm-up puts in front of them.
+    uint64_t covered = snapshotSeq.load(memory_order_acquire);
+    uint64_t lastSeq = covered;
+    // Rate records are replayed even when the snapshot covers them: a
+    // checkpoint whose rates file failed to follow its snapshot keeps
+    // the archive for them, and replaying rates in order is harmless.
+    replayJournal([&](uint64_t seq, const string& record) {
+        if (seq <= covered && record.compare(0, 2, "R|") != 0)
+            return;
+        applyRecord(record);
+        lastSeq = max(lastSeq, seq);
+    });
+    journal.setLastSeq(lastSeq);
+
+    if (warmup)
+    {
+        warming.store(true, memory_order_release);
+        warmupThread = thread([this]() { runWarmup(); });
+    }
+}
+
+// ========================================
+// History warm-up
+// ========================================
+
+// Parses one account's history lines. A line that does not parse is
+// quarantined and skipped: the balance, which is already loaded, does
+// not depend on it.
+void Bank::parseHistory(size_t slot, vector<Transaction>& out)
+{
+    const HistoryWarmup::Segment& segment = warmup->segments[slot];
+    const char* base = warmup->base;
+    size_t line = segment.line;
+    for (size_t pos = segment.begin; pos < segment.end; ++line)
+    {
+        const char* p = base + pos;
+        const char* eol = static_cast<const char*>(memchr(p, '\n', segment.end - pos));
+        size_t len = eol ? static_cast<size_t>(eol - p) : segment.end - pos;
+        string_view text(p, len);
+
+        if (!text.empty() && text != "\r")
+        {
+            TransactionFields fields;
+            const char* problem = text.compare(0, 2, "T:") != 0
+                                      ? "history line does not start with T:"
+                                      : parseTransactionLine(text.substr(2), fields);
+            if (problem)
+                quarantine({line, pos, problem}, text);
+            else
+                out.push_back({string(fields.timestamp), string(fields.type), fields.amount});
+        }
+        pos += len + 1;
+    }
+}
+
+void Bank::quarantine(const ParseError& error, string_view text)
+{
+    lock_guard<mutex> lock(loadErrorsMutex);
+    loadErrorList.push_back(error);
+
+    ofstream file(filename + ".quarantine", ios::app | ios::binary);
+    file << "# " << filename << ":" << error.line << " (byte " << error.offset << "): "
+         << error.message << "\n" << text;
+    if (!text.empty() && text.back() != '\n')
+        file << "\n";
+}
+
+vector<ParseError> Bank::loadErrors() const
+{
+    lock_guard<mutex> lock(loadErrorsMutex);
+    return loadErrorList;
+}
+
+void Bank::warmHistory(size_t slot)
+{
+    HistoryWarmup& w = *warmup;
+    if (slot >= w.segments.size())
+        return;
+
+    // Whoever moves the account from PENDING loads it; anyone else who
+    // needs it waits for that one account only.
+    atomic<uint8_t>& state = w.states[slot];
+    uint8_t s = HistoryWarmup::PENDING;
+    if (!state.compare_exchange_strong(s, HistoryWarmup::LOADING, memory_order_acquire))
+    {
+        while (s == HistoryWarmup::LOADING)
+        {
+            state.wait(HistoryWarmup::LOADING, memory_order_acquire);
+            s = state.load(memory_order_acquire);
+        }
+        return;
+    }
+
+    vector<Transaction> older;
+    parseHistory(slot, older);
+
+    Account& acc = accounts[slot];
+    acc.lock();
+    acc.prependHistory(move(older));
+    acc.unlock();
+
+    state.store(HistoryWarmup::LOADED, memory_order_release);
+    state.notify_all();
+}
+
+void Bank::runWarmup()
+{
+    // Batches release structureMutex in between, so account creation
+    // and other exclusive work is not held up for the whole warm-up.
+    const size_t batch = 16 * BULK_GRAIN;
+    size_t n = warmup->segments.size();
+    for (size_t begin = 0; begin < n; begin += batch)
+    {
+        shared_lock<shared_mutex> structure(structureMutex);
+        size_t end = min(n, begin + batch);
+        executor.parallelFor(end - begin, BULK_GRAIN / 4, [&](size_t lo, size_t hi) {
+            for (size_t slot = begin + lo; slot < begin + hi; ++slot)
+                warmHistory(slot);
+        });
+    }
+
+    warmup->unmap();
+    warming.store(false, memory_order_release);
+}
+
+void Bank::waitForHistory()
+{
+    lock_guard<mutex> lock(warmupMutex);
+    if (warmupThread.joinable())
+        warmupThread.join();
+}
+
+// ========================================
+// Background checkpoint
+// ========================================
+
+CheckpointReport Bank::checkpointInBackground()
+{
+    CheckpointReport report;
+    if (filename.empty())
+        return report;
+
+    waitForHistory();
+    auto pauseStart = chrono::steady_clock::now();
+    unique_lock<shared_mutex> structure(structureMutex);
+    lock_guard<mutex> lock(checkpointMutex);
+    if (checkpointRunning.load(memory_order_acquire))
+        return report;
+    if (checkpointReaper.joinable())
+        checkpointReaper.join();
+
+    foldHotAccounts();
+    journalBuffers.publishAll();
+    uint64_t seq = journal.lastSeq();
+
+    // Records up to `seq` move to the archive, which the checkpoint will
+    // supersede. If an earlier failed checkpoint left one behind, keep it
+    // and carry on in the current file; load() filters by sequence
+    // number either way.
+    string archive = filename + ".journal.old";
+    if (access(archive.c_str(), F_OK) != 0)
+        journal.rotate(archive);
+
+    // No other thread is inside the bank, so the child's copy is a
+    // consistent image. The child owns no threads: it must not touch
+    // the executor, the journal or any lock.
+    pid_t child = fork();
+    if (child == 0)
+        _exit(writeCheckpoint(seq) ? 0 : 1);
+    report.pauseMs = chrono::duration<double, milli>(chrono::steady_clock::now() - pauseStart).count();
+    if (child < 0)
+        return report;
+
+    checkpointRunning.store(true, memory_order_release);
+    checkpointReaper = thread([this, child, seq, archive]() {
+        int status = 0;
+        bool ok = waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+        // The snapshot goes first. If the rates then fail to follow, the
+        // archive is kept, and load() replays its rate records, which the
+        // snapshot would otherwise cover.
+        string tmp = filename + ".checkpoint.tmp";
+        string indexTmp = filename + ".index.checkpoint.tmp";
+        bool hasRates = !ratesFilename.empty();
+        string ratesTmp = hasRates ? ratesFilename + ".checkpoint.tmp" : "";
+        if (ok)
+            ok = rename(tmp.c_str(), filename.c_str()) == 0 && syncDirectoryOf(filename);
+        if (ok && hasRates)
+            ok = rename(ratesTmp.c_str(), ratesFilename.c_str()) == 0
+                 && syncDirectoryOf(ratesFilename);
+
+        if (ok)
+        {
+            snapshotSeq.store(seq, memory_order_release);
+            remove(archive.c_str());
+            // A stale index no longer matches the snapshot and is ignored.
+            rename(indexTmp.c_str(), (filename + ".index").c_str());
+        }
+        else
+        {
+            remove(tmp.c_str());
+            remove(indexTmp.c_str());
+            if (hasRates)
+                remove(ratesTmp.c_str());
+        }
+        checkpointSucceeded = ok;
+        checkpointRunning.store(false, memory_order_release);
+    });
+
+    report.started = true;
+    report.snapshotSeq = seq;
+    return report;
+}
+
+bool Bank::waitForCheckpoint()
+{
+    lock_guard<mutex> lock(checkpointMutex);
+    if (checkpointReaper.joinable())
+        checkpointReaper.join();
+    return checkpointSucceeded;
+}
+
+bool Bank::writeCheckpoint(uint64_t seq) const
+{
+    string tmp = filename + ".checkpoint.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    string out = "#seq " + to_string(seq) + "\n";
+    string entries;
+    size_t offset = out.size();
+    size_t line = 2;
+    bool ok = true;
+    for (const auto& acc : accounts)
+    {
+        string block = acc.serialize();
+        line += appendIndexEntry(entries, offset, line, block);
+        offset += block.size();
+        out += block;
+        if (out.size() >= CHECKPOINT_WRITE_CHUNK)
+        {
+            ok = ok && writeAll(fd, out);
+            out.clear();
+        }
+    }
+    ok = ok && writeAll(fd, out) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok)
+        return false;
+
+    if (!writeSynced(filename + ".index.checkpoint.tmp", indexHeader(seq, offset) + entries))
+        return false;
+
+    if (ratesFilename.empty())
+        return true;
+    string ratesTmp = ratesFilename + ".checkpoint.tmp";
+    return rates.save(ratesTmp);
+}
+
+void Bank::replayJournal(const function<void(uint64_t, const string&)>& fn) const
+{
+    Journal::replay(filename + ".journal.old", fn);
+    Journal::replay(filename + ".journal", fn);
+}
+
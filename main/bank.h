@@ -0,0 +1,412 @@
+/*
+    Banking core library
+    --------------------------------
+    All business logic lives here and reports outcomes as Result codes;
+    nothing in this library reads stdin or writes stdout. The console
+    program (noign.cpp) is one front end over it.
+*/
+
+#pragma once
+
+#include "account.h"
+#include "balanceview.h"
+#include "currency.h"
+#include "executor.h"
+#include "journal.h"
+#include "result.h"
+#include "statement.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// An account whose balance disagrees with its replayed history.
+struct AuditFinding
+{
+    int id;
+    double balance;
+    double replayed;
+};
+
+// One transfer of a Bank::transferBatch().
+struct TransferOrder
+{
+    int from;
+    int to;
+    double amount;
+};
+
+// Outcome of Bank::importAccounts().
+struct ImportReport
+{
+    bool readable = false;
+    size_t imported = 0;
+    size_t rejected = 0;
+    // Line (CSV) or record (binary) number of the first rejected row,
+    // 0 if none.
+    size_t firstRejected = 0;
+    // Imported accounts have ids firstId .. firstId + imported - 1.
+    int firstId = 0;
+};
+
+// Outcome of Bank::exportColumnar().
+struct ExportReport
+{
+    bool ok = false;
+    size_t accounts = 0;
+    size_t transactions = 0;
+    size_t rowGroups = 0;
+    // Journal sequence number the exported data is consistent with.
+    uint64_t snapshotSeq = 0;
+    // How long the bank was held exclusively to take the cut.
+    double pauseMs = 0.0;
+};
+
+// Outcome of Bank::generateStatements().
+struct StatementReport
+{
+    bool ok = false;
+    size_t statements = 0;
+    // Transactions listed across all statements.
+    size_t transactions = 0;
+    size_t shards = 0;
+    size_t bytes = 0;
+    // Journal sequence number the statements are consistent with.
+    uint64_t snapshotSeq = 0;
+    double seconds = 0.0;
+
+    double statementsPerSecond() const { return seconds > 0.0 ? statements / seconds : 0.0; }
+};
+
+// Outcome of Bank::checkpointInBackground().
+struct CheckpointReport
+{
+    // False for an in-memory bank, while another checkpoint is still
+    // running, or if the writer process could not be started.
+    bool started = false;
+    // Journal sequence number the checkpoint is consistent with.
+    uint64_t snapshotSeq = 0;
+    // How long the bank was held exclusively to fork the writer.
+    double pauseMs = 0.0;
+};
+
+struct HistoryIndex;
+struct AccountFilter;
+struct HistoryWarmup;
+
+// How Bank::transfer synchronizes with concurrent operations.
+enum class ConcurrencyMode
+{
+    // Lock both accounts, then check funds and commit.
+    Pessimistic,
+    // Read and check without locks, commit only if neither account's
+    // version changed; retry on conflict. Cheaper when transfers rarely
+    // touch the same accounts.
+    Optimistic
+};
+
+struct ConcurrencyStats
+{
+    uint64_t lockedCommits = 0;
+    uint64_t optimisticAttempts = 0;
+    uint64_t optimisticCommits = 0;
+    uint64_t optimisticConflicts = 0;
+    uint64_t optimisticRetries = 0;
+    uint64_t optimisticFallbacks = 0;
+
+    double conflictRate() const
+    {
+        return optimisticAttempts ? double(optimisticConflicts) / optimisticAttempts : 0.0;
+    }
+};
+
+// Thread safety: deposit, withdraw, transfer and revalueBalances may run
+// concurrently from any number of threads; they share structureMutex and
+// synchronize per account through its version lock. Everything that
+// adds accounts, changes rates or walks all histories takes
+// structureMutex exclusively. findAccount() and getAccounts() hand out
+// unsynchronized references for single-threaded callers.
+class Bank
+{
+private:
+    std::vector<Account> accounts;
+    // id -> position in accounts. Ids are handed out sequentially, so a
+    // dense array replaces hashing on every lookup; NO_SLOT marks gaps.
+    std::vector<size_t> index;
+    int nextId = 1;
+    RateTable rates;
+    std::string filename;
+    std::string ratesFilename;
+    Journal journal;
+    // Deposits, withdrawals, transfers and interest journal through
+    // per-thread buffers; everything else appends directly, under the
+    // exclusive structureMutex.
+    JournalBuffers journalBuffers{journal};
+    // Last journal record the snapshot file includes. Atomic because the
+    // checkpoint reaper sets it without structureMutex.
+    std::atomic<uint64_t> snapshotSeq{0};
+
+    Executor& executor;
+    mutable std::shared_mutex structureMutex;
+
+    std::atomic<ConcurrencyMode> concurrencyMode{ConcurrencyMode::Pessimistic};
+    std::atomic<uint64_t> lockedCommits{0};
+    std::atomic<uint64_t> optimisticAttempts{0};
+    std::atomic<uint64_t> optimisticCommits{0};
+    std::atomic<uint64_t> optimisticConflicts{0};
+    std::atomic<uint64_t> optimisticRetries{0};
+    std::atomic<uint64_t> optimisticFallbacks{0};
+
+    void addAccount(Account acc);
+
+    // id -> history log for Bank::history(), read without locks under an
+    // epoch guard. Maintained under the exclusive structureMutex.
+    std::atomic<HistoryIndex*> historyIndex{nullptr};
+    void reserveHistoryIndex(size_t ids);
+    void indexHistory(const Account& acc);
+
+    // Bloom filter over every account id, read without locks under an
+    // epoch guard like historyIndex and replaced when it fills.
+    std::atomic<AccountFilter*> idFilter{nullptr};
+    void reserveIdFilter(size_t accounts);
+    // Requires structureMutex held exclusively.
+    void foldHotAccounts();
+    void commitTransfer(Account& accFrom, Account& accTo, double amount, double converted);
+    Result transferLocked(Account& accFrom, Account& accTo, double amount, double converted);
+    Result transferOptimistic(Account& accFrom, Account& accTo, double amount, double converted);
+    // Require the account locks, except on a hot account's lock-free path.
+    void logTransaction(Account& acc, const Transaction& t);
+    void stageRecord(const std::string& record, Account& first, Account* second = nullptr);
+
+    // Set by publishBalanceView(); every balance change is mirrored.
+    std::unique_ptr<BalanceView> balanceView;
+    // Set while some account could not be published because the view
+    // could not grow; cleared once it does.
+    std::atomic<bool> balanceViewShort{false};
+    // Grows the view once ids reach its capacity.
+    // Requires structureMutex held exclusively.
+    void reserveBalanceView(size_t ids);
+
+    // Callers hold the account lock, or structureMutex exclusively.
+    void publishBalance(const Account& acc)
+    {
+        if (balanceView)
+            balanceView->publish(acc.getId(), acc.getBalance(), acc.getCurrency());
+    }
+    void applyRecord(const std::string& record);
+
+    // Background checkpoint. The reaper waits for the forked writer and
+    // installs its snapshot; checkpointMutex serializes joining it.
+    std::mutex checkpointMutex;
+    std::thread checkpointReaper;
+    std::atomic<bool> checkpointRunning{false};
+    bool checkpointSucceeded = true;
+
+    // Histories still being read from the snapshot after load(). Set
+    // while `warming`; accounts whose history is not in yet are loaded
+    // on demand, blocking only the caller that needs them.
+    std::unique_ptr<HistoryWarmup> warmup;
+    std::atomic<bool> warming{false};
+    std::mutex warmupMutex;
+    std::thread warmupThread;
+    void runWarmup();
+    // Requires structureMutex held shared.
+    void warmHistory(size_t slot);
+    void parseHistory(size_t slot, std::vector<Transaction>& out);
+
+    // Damaged snapshot records found by load() and the warm-up. Each is
+    // also copied, with its position, to "<filename>.quarantine".
+    mutable std::mutex loadErrorsMutex;
+    std::vector<ParseError> loadErrorList;
+    void quarantine(const ParseError& error, std::string_view text);
+
+    // Runs in the forked child; writes the snapshot, its index and the
+    // rates to their ".checkpoint.tmp" files.
+    bool writeCheckpoint(uint64_t seq) const;
+    // The rotated-out journal, if a checkpoint has not yet superseded
+    // it, then the live one.
+    void replayJournal(const std::function<void(uint64_t, const std::string&)>& fn) const;
+
+public:
+    // An empty filename gives a purely in-memory bank that never touches
+    // the filesystem. Otherwise mutations are journaled to
+    // "<filename>.journal" between snapshots.
+    explicit Bank(const std::string& filename = "bank_data.txt",
+                  const std::string& ratesFilename = "fx_rates.txt");
+    ~Bank();
+
+    Bank(const Bank&) = delete;
+    Bank& operator=(const Bank&) = delete;
+
+    // Returns the new account's id, or 0 if the owner pool is full.
+    int createAccount(const std::string& owner, Currency currency = Currency::USD);
+
+    Account* findAccount(int id);
+    const Account* findAccount(int id) const;
+
+    // False only if there is no account `id`; true for every account and
+    // about 1% of other ids. Takes no lock, so callers can answer
+    // "not found" before queueing for the bank.
+    bool accountMayExist(int id) const;
+
+    // Ids of every account held by `owner`. Owners are interned, so the
+    // scan compares integers rather than strings.
+    std::vector<int> findByOwner(const std::string& owner) const;
+
+    Result deposit(int id, double amount);
+    Result withdraw(int id, double amount);
+
+    // `amount` is in the source account's currency; the destination is
+    // credited with the converted value.
+    Result transfer(int from, int to, double amount);
+
+    Result setExchangeRate(Currency c, double inUsd);
+
+    // Thread-safe read of an account's balance, in its own currency.
+    Result balance(int id, double& out) const;
+
+    // Thread-safe copy of an account's full history. Takes no lock and
+    // never waits for writers, except for hot accounts, whose slots are
+    // folded under the account lock first.
+    Result history(int id, std::vector<Transaction>& out) const;
+
+    // Opt-in for accounts that receive a large share of all deposits:
+    // their balance is split into per-core slots that deposits update
+    // independently. Reads aggregate the slots; withdrawals use the
+    // caller's slot when it suffices and otherwise borrow across all of
+    // them under the account lock.
+    Result setHotAccount(int id, bool hot);
+
+    void setConcurrencyMode(ConcurrencyMode mode) { concurrencyMode.store(mode); }
+    ConcurrencyMode getConcurrencyMode() const { return concurrencyMode.load(); }
+    ConcurrencyStats concurrencyStats() const;
+
+    const std::vector<Account>& getAccounts() const { return accounts; }
+    const RateTable& getRates() const { return rates; }
+
+    // Revalues every balance into one reporting currency with a single
+    // batched conversion over column arrays. out[i] corresponds to
+    // getAccounts()[i]; accounts without a rate convert to 0.
+    void revalueBalances(Currency reporting, std::vector<double>& out) const;
+
+    // ---- Bulk jobs ----
+    // These run in parallel on the shared Executor's bulk lane, so they
+    // only use capacity that interactive and standard work leave idle.
+
+    // Replays every account's history and reports mismatched balances.
+    // Holds the Bank exclusively for its duration.
+    std::vector<AuditFinding> audit(const CancellationToken& token = {}) const;
+
+    // Credits `rate` (0.01 = 1%) of every positive balance as INTEREST.
+    // Returns the number of accounts credited. Runs in small slices that
+    // each lock like a deposit, so requests are served throughout;
+    // accounts created after the run starts are not credited.
+    size_t accrueInterest(double rate, const CancellationToken& token = {});
+
+    // Runs a batch of transfers, such as a payroll, in small slices.
+    // Each order is an ordinary transfer() and requests interleave with
+    // them. Orders run in parallel, so when they compete for funds which
+    // ones fail is not defined. results[i] is the outcome of orders[i].
+    std::vector<Result> transferBatch(const std::vector<TransferOrder>& orders,
+                                      const CancellationToken& token = {});
+
+    // Creates one account per valid row of a CSV or binary onboarding
+    // file (formats in import.h); a positive opening balance is recorded
+    // as a DEPOSIT. Parsing and validation run before the bank is
+    // locked; the accounts then get consecutive ids, are built into a
+    // pre-sized store, and are journaled as one batch. If the owner pool
+    // cannot take every new owner, nothing is imported and every row
+    // counts as rejected.
+    ImportReport importAccounts(const std::string& path);
+    ImportReport importAccountData(std::string_view data);
+
+    // Writes "<prefix>.accounts.col" and "<prefix>.transactions.col"
+    // (format in columnar.h) from a consistent cut of the bank. Only the
+    // cut holds the bank exclusively; row groups are then encoded in
+    // parallel while deposits, withdrawals and transfers carry on (new
+    // accounts wait until the export finishes).
+    ExportReport exportColumnar(const std::string& prefix,
+                                const CancellationToken& token = {});
+
+    // Writes a statement for every account covering `period` (format in
+    // statement.h) to "<prefix>.<shard>.stmt", shard 0 .. shards - 1;
+    // 0 shards means one per executor thread. Balances and histories
+    // are cut at one instant, as for exportColumnar(); each shard is
+    // then generated and written in parallel. Assumes each history is
+    // in time order, which is how it is recorded.
+    StatementReport generateStatements(const StatementPeriod& period, const std::string& prefix,
+                                       size_t shards = 0, const CancellationToken& token = {});
+
+    // Makes every mutation so far durable; returns the highest durable
+    // journal sequence number (0 for an in-memory bank).
+    uint64_t syncJournal()
+    {
+        journalBuffers.publishAll();
+        return journal.flush();
+    }
+    uint64_t journalSeq()
+    {
+        journalBuffers.publishAll();
+        return journal.lastSeq();
+    }
+    uint64_t durableSeq() const { return journal.durableSeq(); }
+    bool isJournaled() const { return journal.isOpen(); }
+    // Batches the per-thread journal buffers published, and how long
+    // records waited in them.
+    JournalBufferStats journalBufferStats() const { return journalBuffers.stats(); }
+
+    // Publishes every durable journal record to a change feed file,
+    // "<filename>.cdc" unless `path` is given (see changefeed.h).
+    // Records the feed missed while closed are appended first, as far
+    // as the current journal still holds them. False for an in-memory
+    // bank or if the feed cannot be opened.
+    bool enableChangeFeed(const std::string& path = "");
+
+    // Publishes every balance to the shared-memory segment `name` for
+    // other processes to read through BalanceViewReader (see
+    // balanceview.h), and keeps it current. `capacity` is the initial
+    // table size; 0 picks room for the current accounts plus as many
+    // again. When new ids outgrow it, the segment grows in place to
+    // twice the size; readers open it again to see the new ids.
+    // Hot-account deposits publish best-effort and may lag by a few
+    // concurrent deposits.
+    bool publishBalanceView(const std::string& name, size_t capacity = 0);
+    // False while the view could not grow to hold every account; those
+    // past its capacity are missing until a later growth succeeds.
+    bool isBalanceViewComplete() const { return !balanceViewShort.load(std::memory_order_acquire); }
+
+    // Starts a snapshot without stopping the bank for its duration:
+    // under the exclusive lock the journal is rotated and a child
+    // process is forked, which writes the copy-on-write image of the
+    // accounts while this process carries on. Once the child succeeds
+    // the snapshot replaces the old one and the rotated journal is
+    // dropped; until then recovery uses the old snapshot and both
+    // journals.
+    CheckpointReport checkpointInBackground();
+    // Waits for a running checkpoint; true unless the last one failed.
+    bool waitForCheckpoint();
+    bool checkpointInProgress() const { return checkpointRunning.load(std::memory_order_acquire); }
+
+    // False while load() is still reading histories in the background.
+    bool isHistoryLoaded() const { return !warming.load(std::memory_order_acquire); }
+    // Waits until every history is loaded. Must not be called while
+    // holding the Bank exclusively.
+    void waitForHistory();
+    // Records load() could not read. Their accounts are left out (a bad
+    // header) or keep their balance but lose the bad history lines.
+    std::vector<ParseError> loadErrors() const;
+
+    // Writes a full snapshot, with an index of its accounts in
+    // "<filename>.index", and truncates the journal it supersedes.
+    void save();
+    // Reads balances from the snapshot (through its index when it is
+    // current), then replays newer journal records. Histories follow
+    // in the background, see isHistoryLoaded().
+    void load();
+};
@@ -0,0 +1,241 @@
+#include "bank_c.h"
+#include "bank.h"
+
+#include <exception>
+#include <string>
+
+using namespace std;
+
+static_assert(BANK_OK == static_cast<int>(Result::Ok), "status mismatch");
+static_assert(BANK_ACCOUNT_NOT_FOUND == static_cast<int>(Result::AccountNotFound), "status mismatch");
+static_assert(BANK_INSUFFICIENT_FUNDS == static_cast<int>(Result::InsufficientFunds), "status mismatch");
+static_assert(BANK_INVALID_AMOUNT == static_cast<int>(Result::InvalidAmount), "status mismatch");
+static_assert(BANK_NO_EXCHANGE_RATE == static_cast<int>(Result::NoExchangeRate), "status mismatch");
+static_assert(BANK_CAD + 1 == static_cast<int>(CURRENCY_COUNT), "currency mismatch");
+
+struct bank_t
+{
+    Bank bank;
+
+    bank_t(const string& data, const string& rates) : bank(data, rates) {}
+};
+
+static int32_t status(Result r)
+{
+    return static_cast<int32_t>(r);
+}
+
+static bool validCurrency(int32_t c)
+{
+    return c >= 0 && c < static_cast<int32_t>(CURRENCY_COUNT);
+}
+
+// Nothing may unwind across the C boundary.
+template <typename F>
+static int32_t guarded(bank_t* bank, F&& f)
+{
+    if (!bank)
+        return BANK_INVALID_ARGUMENT;
+    try
+    {
+        return f(bank->bank);
+    }
+    catch (...)
+    {
+        return BANK_INTERNAL_ERROR;
+    }
+}
+
+static int32_t executeOne(Bank& bank, const bank_op_t& op, bank_result_t& result)
+{
+    Result r;
+    switch (op.kind)
+    {
+    case BANK_OP_DEPOSIT: r = bank.deposit(op.account, op.amount); break;
+    case BANK_OP_WITHDRAW: r = bank.withdraw(op.account, op.amount); break;
+    case BANK_OP_TRANSFER: r = bank.transfer(op.account, op.target, op.amount); break;
+    case BANK_OP_BALANCE: r = Result::Ok; break;
+    default:
+        result.status = BANK_INVALID_ARGUMENT;
+        result.balance = 0.0;
+        return result.status;
+    }
+
+    double balance = 0.0;
+    Result found = bank.balance(op.account, balance);
+    if (r == Result::Ok)
+        r = found;
+
+    result.status = status(r);
+    result.balance = balance;
+    return result.status;
+}
+
+extern "C" {
+
+uint32_t bank_abi_version(void)
+{
+    return BANK_ABI_VERSION;
+}
+
+const char* bank_status_message(int32_t s)
+{
+    switch (s)
+    {
+    case BANK_INVALID_ARGUMENT: return "Invalid argument.";
+    case BANK_INTERNAL_ERROR: return "Internal error.";
+    default:
+        if (s >= BANK_OK && s <= BANK_NO_EXCHANGE_RATE)
+            return resultMessage(static_cast<Result>(s));
+        return "Unknown status.";
+    }
+}
+
+bank_t* bank_open(const char* data_path, const char* rates_path)
+{
+    try
+    {
+        string data = data_path ? data_path : "";
+        string rates = rates_path ? rates_path : data.empty() ? "" : data + ".rates";
+        return new bank_t(data, rates);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void bank_close(bank_t* bank)
+{
+    try
+    {
+        delete bank;
+    }
+    catch (...)
+    {
+    }
+}
+
+int32_t bank_save(bank_t* bank)
+{
+    return guarded(bank, [](Bank& b) -> int32_t {
+        b.save();
+        return BANK_OK;
+    });
+}
+
+uint64_t bank_sync(bank_t* bank)
+{
+    if (!bank)
+        return 0;
+
+    try
+    {
+        return bank->bank.syncJournal();
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+bank_account_t bank_create_account(bank_t* bank, const char* owner, int32_t currency)
+{
+    if (!bank || !owner || !validCurrency(currency))
+        return -BANK_INVALID_ARGUMENT;
+
+    try
+    {
+        int id = bank->bank.createAccount(owner, static_cast<Currency>(currency));
+        return id ? id : -BANK_INTERNAL_ERROR;
+    }
+    catch (...)
+    {
+        return -BANK_INTERNAL_ERROR;
+    }
+}
+
+int32_t bank_deposit(bank_t* bank, bank_account_t account, double amount)
+{
+    return guarded(bank, [&](Bank& b) -> int32_t { return status(b.deposit(account, amount)); });
+}
+
+int32_t bank_withdraw(bank_t* bank, bank_account_t account, double amount)
+{
+    return guarded(bank, [&](Bank& b) -> int32_t { return status(b.withdraw(account, amount)); });
+}
+
+int32_t bank_transfer(bank_t* bank, bank_account_t from, bank_account_t to, double amount)
+{
+    return guarded(bank, [&](Bank& b) -> int32_t { return status(b.transfer(from, to, amount)); });
+}
+
+int32_t bank_balance(bank_t* bank, bank_account_t account, double* out)
+{
+    if (!out)
+        return BANK_INVALID_ARGUMENT;
+
+    return guarded(bank, [&](Bank& b) -> int32_t { return status(b.balance(account, *out)); });
+}
+
+int32_t bank_set_rate(bank_t* bank, int32_t currency, double in_usd)
+{
+    if (!validCurrency(currency))
+        return BANK_INVALID_ARGUMENT;
+
+    return guarded(bank, [&](Bank& b) -> int32_t {
+        return status(b.setExchangeRate(static_cast<Currency>(currency), in_usd));
+    });
+}
+
+size_t bank_create_accounts(bank_t* bank, const char* const* owners,
+                            const int32_t* currencies, size_t n,
+                            bank_account_t* out_ids)
+{
+    if (!bank || !owners || !out_ids)
+        return 0;
+
+    size_t created = 0;
+    try
+    {
+        for (; created < n; ++created)
+        {
+            int32_t c = currencies ? currencies[created] : BANK_USD;
+            if (!owners[created] || !validCurrency(c))
+                break;
+            out_ids[created] = bank->bank.createAccount(owners[created],
+                                                        static_cast<Currency>(c));
+            if (out_ids[created] == 0)
+                break;
+        }
+    }
+    catch (...)
+    {
+    }
+    return created;
+}
+
+size_t bank_execute_batch(bank_t* bank, const bank_op_t* ops, size_t n,
+                          bank_result_t* results)
+{
+    if (!bank || !ops || !results)
+        return 0;
+
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        try
+        {
+            if (executeOne(bank->bank, ops[i], results[i]) == BANK_OK)
+                ++ok;
+        }
+        catch (...)
+        {
+            results[i].status = BANK_INTERNAL_ERROR;
+            results[i].balance = 0.0;
+        }
+    }
+    return ok;
+}
+
+}
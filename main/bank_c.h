@@ -0,0 +1,128 @@
+/*
+    C ABI for the banking core
+    --------------------------------
+    A stable, exception-free interface for foreign callers (Python ctypes,
+    cgo, ...). A bank is an opaque handle; accounts are referred to by
+    their integer id. The batch entry points process whole arrays of
+    operations per call so the FFI crossing cost is paid once, not per
+    operation.
+
+    A handle may be shared between threads; only bank_close must not
+    race with other calls on it.
+
+    Structs in this header are part of the ABI: fields are only ever
+    appended, and BANK_ABI_VERSION is bumped when that happens.
+*/
+
+#ifndef BANK_C_H
+#define BANK_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define BANK_API __declspec(dllexport)
+#else
+#define BANK_API __attribute__((visibility("default")))
+#endif
+
+#define BANK_ABI_VERSION 1
+
+typedef struct bank_t bank_t;
+typedef int32_t bank_account_t;
+
+/* Status codes. The first five mirror the core's Result enum. */
+enum
+{
+    BANK_OK = 0,
+    BANK_ACCOUNT_NOT_FOUND = 1,
+    BANK_INSUFFICIENT_FUNDS = 2,
+    BANK_INVALID_AMOUNT = 3,
+    BANK_NO_EXCHANGE_RATE = 4,
+    BANK_INVALID_ARGUMENT = 100,
+    BANK_INTERNAL_ERROR = 101
+};
+
+/* Currency codes, in the same order as the core's Currency enum. */
+enum
+{
+    BANK_USD = 0,
+    BANK_EUR,
+    BANK_GBP,
+    BANK_JPY,
+    BANK_CHF,
+    BANK_CAD
+};
+
+enum
+{
+    BANK_OP_DEPOSIT = 0,
+    BANK_OP_WITHDRAW = 1,
+    BANK_OP_TRANSFER = 2, /* account -> target */
+    BANK_OP_BALANCE = 3
+};
+
+typedef struct
+{
+    int32_t kind;           /* BANK_OP_* */
+    bank_account_t account;
+    bank_account_t target;  /* BANK_OP_TRANSFER only */
+    double amount;
+} bank_op_t;
+
+typedef struct
+{
+    int32_t status;         /* BANK_* status code */
+    double balance;         /* balance of `account` after the op, if it exists */
+} bank_result_t;
+
+BANK_API uint32_t bank_abi_version(void);
+BANK_API const char* bank_status_message(int32_t status);
+
+/* data_path == NULL gives an in-memory bank with no persistence.
+   rates_path == NULL stores the exchange rates in "<data_path>.rates".
+   Returns NULL on failure. */
+BANK_API bank_t* bank_open(const char* data_path, const char* rates_path);
+
+/* Saves (when persistent) and releases the handle. */
+BANK_API void bank_close(bank_t* bank);
+BANK_API int32_t bank_save(bank_t* bank);
+
+/* Mutations are journaled in memory first. Every mutation that returned
+   before bank_sync() was called is on disk once it returns; bank_save()
+   and bank_close() make everything durable too. Returns the highest
+   durable journal sequence number; 0 for an in-memory bank or a NULL
+   handle. */
+BANK_API uint64_t bank_sync(bank_t* bank);
+
+/* Returns the new id, or a negative value on error. */
+BANK_API bank_account_t bank_create_account(bank_t* bank, const char* owner,
+                                            int32_t currency);
+
+BANK_API int32_t bank_deposit(bank_t* bank, bank_account_t account, double amount);
+BANK_API int32_t bank_withdraw(bank_t* bank, bank_account_t account, double amount);
+BANK_API int32_t bank_transfer(bank_t* bank, bank_account_t from,
+                               bank_account_t to, double amount);
+BANK_API int32_t bank_balance(bank_t* bank, bank_account_t account, double* out);
+BANK_API int32_t bank_set_rate(bank_t* bank, int32_t currency, double in_usd);
+
+/* Creates n accounts; ids are written to out_ids. currencies may be NULL
+   (all USD). Returns the number of accounts created. */
+BANK_API size_t bank_create_accounts(bank_t* bank, const char* const* owners,
+                                     const int32_t* currencies, size_t n,
+                                     bank_account_t* out_ids);
+
+/* Executes ops[0..n) in order, writing one result per op. Returns the
+   number of ops that completed with BANK_OK. */
+BANK_API size_t bank_execute_batch(bank_t* bank, const bank_op_t* ops, size_t n,
+                                   bank_result_t* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
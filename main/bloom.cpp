@@ -0,0 +1,86 @@
+#include "bloom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Odd multipliers that pick an independent bit in each word from the
+// same 32 bits of hash.
+static const uint32_t SALTS[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+static uint64_t mixKey(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// The high half of the hash picks the block: scaled into [0, count)
+// rather than masked, so the filter need not be a power of two.
+static size_t blockFor(uint64_t hash, size_t count)
+{
+    return static_cast<size_t>(((hash >> 32) * count) >> 32);
+}
+
+static uint64_t bitFor(uint32_t hash, size_t word)
+{
+    return uint64_t(1) << ((hash * SALTS[word]) >> 26);
+}
+
+BlockedBloomFilter::BlockedBloomFilter(size_t keys, double bitsPerKey)
+{
+    double bits = max(1.0, static_cast<double>(keys) * bitsPerKey);
+    count = static_cast<size_t>(ceil(bits / (8.0 * sizeof(Block))));
+    blocks = make_unique<Block[]>(count);
+}
+
+BlockedBloomFilter::BlockedBloomFilter(string_view saved)
+{
+    count = max<size_t>(1, saved.size() / sizeof(Block));
+    blocks = make_unique<Block[]>(count);
+    for (size_t b = 0; b < count && (b + 1) * sizeof(Block) <= saved.size(); ++b)
+    {
+        for (size_t w = 0; w < 8; ++w)
+        {
+            uint64_t bits;
+            memcpy(&bits, saved.data() + b * sizeof(Block) + w * 8, 8);
+            blocks[b].words[w].store(bits, memory_order_relaxed);
+        }
+    }
+}
+
+void BlockedBloomFilter::save(string& out) const
+{
+    for (size_t b = 0; b < count; ++b)
+    {
+        for (size_t w = 0; w < 8; ++w)
+        {
+            uint64_t bits = blocks[b].words[w].load(memory_order_relaxed);
+            out.append(reinterpret_cast<const char*>(&bits), 8);
+        }
+    }
+}
+
+void BlockedBloomFilter::insert(uint64_t key)
+{
+    uint64_t h = mixKey(key);
+    Block& block = blocks[blockFor(h, count)];
+    for (size_t w = 0; w < 8; ++w)
+        block.words[w].fetch_or(bitFor(static_cast<uint32_t>(h), w), memory_order_relaxed);
+}
+
+bool BlockedBloomFilter::mayContain(uint64_t key) const
+{
+    uint64_t h = mixKey(key);
+    const Block& block = blocks[blockFor(h, count)];
+    uint64_t missing = 0;
+    for (size_t w = 0; w < 8; ++w)
+        missing |= bitFor(static_cast<uint32_t>(h), w) & ~block.words[w].load(memory_order_relaxed);
+    return missing == 0;
+}
@@ -0,0 +1,47 @@
+/*
+    Blocked Bloom filter
+    --------------------------------
+    A Bloom filter whose bits for one key all lie in a single 64-byte
+    block, so a lookup touches one cache line. Each key sets one bit in
+    each of its block's eight 64-bit words (a "split block" filter). At
+    10 bits per key about 1% of absent keys test positive.
+
+    Inserts are atomic fetch_or and lookups atomic loads, so any number
+    of threads may do either at once. There is no delete: a filter is
+    rebuilt to drop keys.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class BlockedBloomFilter
+{
+private:
+    struct alignas(64) Block
+    {
+        std::atomic<uint64_t> words[8];
+    };
+
+    size_t count = 0;
+    std::unique_ptr<Block[]> blocks;
+
+public:
+    // Room for `keys` keys at `bitsPerKey` bits each.
+    explicit BlockedBloomFilter(size_t keys, double bitsPerKey = 10.0);
+    // The filter whose bits save() wrote.
+    explicit BlockedBloomFilter(std::string_view saved);
+
+    void insert(uint64_t key);
+    // False only if `key` was never inserted.
+    bool mayContain(uint64_t key) const;
+
+    size_t bytes() const { return count * sizeof(Block); }
+    // Appends the bits, to store a filter beside the keys it covers.
+    void save(std::string& out) const;
+};
@@ -0,0 +1,372 @@
+#include "btree.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// ========================================
+// Page layout
+// ========================================
+
+// Every node starts with a 16-byte header: u16 type, u16 key count,
+// u32 reserved, u64 next leaf (leaves only; 0 = none). Keys follow.
+// A leaf's values start after room for all its keys; an inner node's
+// child page numbers after room for INNER_CAPACITY keys.
+
+static const uint16_t LEAF = 1;
+static const uint16_t INNER = 2;
+static const size_t HEADER = 16;
+static const size_t INNER_CAPACITY = (PAGE_SIZE - HEADER - 8) / 16;
+
+static uint64_t load64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void store64(char* p, uint64_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint16_t nodeType(const char* node)
+{
+    uint16_t t;
+    memcpy(&t, node, sizeof(t));
+    return t;
+}
+
+static size_t keyCount(const char* node)
+{
+    uint16_t n;
+    memcpy(&n, node + 2, sizeof(n));
+    return n;
+}
+
+static void initNode(char* node, uint16_t type)
+{
+    memset(node, 0, HEADER);
+    memcpy(node, &type, sizeof(type));
+}
+
+static void setKeyCount(char* node, size_t n)
+{
+    uint16_t v = static_cast<uint16_t>(n);
+    memcpy(node + 2, &v, sizeof(v));
+}
+
+static uint64_t nextLeaf(const char* node)
+{
+    return load64(node + 8);
+}
+
+static void setNextLeaf(char* node, uint64_t page)
+{
+    store64(node + 8, page);
+}
+
+static char* keyPtr(char* node, size_t i)
+{
+    return node + HEADER + i * 8;
+}
+
+static uint64_t keyAt(const char* node, size_t i)
+{
+    return load64(node + HEADER + i * 8);
+}
+
+static char* childPtr(char* node, size_t i)
+{
+    return node + HEADER + INNER_CAPACITY * 8 + i * 8;
+}
+
+static uint64_t childAt(const char* node, size_t i)
+{
+    return load64(node + HEADER + INNER_CAPACITY * 8 + i * 8);
+}
+
+// First key >= `key`.
+static size_t lowerBound(const char* node, size_t n, uint64_t key)
+{
+    size_t lo = 0, hi = n;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (keyAt(node, mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Child i of an inner node covers keys in [key i-1, key i).
+static size_t childFor(const char* node, uint64_t key)
+{
+    size_t lo = 0, hi = keyCount(node);
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (keyAt(node, mid) <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// ========================================
+// BTree
+// ========================================
+
+BTree::BTree(BufferPool& pool, size_t valueSize, uint64_t root, uint64_t count)
+    : pool(pool),
+      valueSize(valueSize),
+      leafCapacity((PAGE_SIZE - HEADER) / (8 + valueSize)),
+      rootPage(root),
+      entries(count)
+{
+}
+
+BufferPool::PageRef BTree::findLeaf(uint64_t key) const
+{
+    BufferPool::PageRef node = pool.fetch(rootPage);
+    while (node && nodeType(node.data()) == INNER)
+        node = pool.fetch(childAt(node.data(), childFor(node.data(), key)));
+    return node;
+}
+
+bool BTree::get(uint64_t key, char* value) const
+{
+    if (!rootPage)
+        return false;
+    BufferPool::PageRef leaf = findLeaf(key);
+    if (!leaf)
+        return false;
+
+    const char* node = leaf.data();
+    size_t n = keyCount(node);
+    size_t i = lowerBound(node, n, key);
+    if (i == n || keyAt(node, i) != key)
+        return false;
+    memcpy(value, node + HEADER + leafCapacity * 8 + i * valueSize, valueSize);
+    return true;
+}
+
+bool BTree::put(uint64_t key, const char* value)
+{
+    if (!rootPage)
+    {
+        BufferPool::PageRef leaf = pool.allocate();
+        if (!leaf)
+            return false;
+        initNode(leaf.data(), LEAF);
+        rootPage = leaf.page();
+    }
+
+    Split split;
+    bool added = false;
+    if (!insert(rootPage, key, value, split, added))
+        return false;
+    if (added)
+        ++entries;
+    if (!split.happened)
+        return true;
+
+    // The root split: a new root above the two halves.
+    BufferPool::PageRef root = pool.allocate();
+    if (!root)
+        return false;
+    char* node = root.data();
+    initNode(node, INNER);
+    setKeyCount(node, 1);
+    store64(keyPtr(node, 0), split.key);
+    store64(childPtr(node, 0), rootPage);
+    store64(childPtr(node, 1), split.right);
+    rootPage = root.page();
+    return true;
+}
+
+bool BTree::insert(uint64_t page, uint64_t key, const char* value, Split& split, bool& added)
+{
+    BufferPool::PageRef ref = pool.fetch(page);
+    if (!ref)
+        return false;
+    char* node = ref.data();
+    size_t n = keyCount(node);
+
+    if (nodeType(node) == LEAF)
+    {
+        char* values = node + HEADER + leafCapacity * 8;
+        size_t i = lowerBound(node, n, key);
+        if (i < n && keyAt(node, i) == key)
+        {
+            memcpy(values + i * valueSize, value, valueSize);
+            ref.markDirty();
+            return true;
+        }
+
+        added = true;
+        if (n == leafCapacity)
+            return splitLeaf(ref, i, key, value, split);
+
+        memmove(keyPtr(node, i + 1), keyPtr(node, i), (n - i) * 8);
+        memmove(values + (i + 1) * valueSize, values + i * valueSize, (n - i) * valueSize);
+        store64(keyPtr(node, i), key);
+        memcpy(values + i * valueSize, value, valueSize);
+        setKeyCount(node, n + 1);
+        ref.markDirty();
+        return true;
+    }
+
+    size_t i = childFor(node, key);
+    Split child;
+    if (!insert(childAt(node, i), key, value, child, added))
+        return false;
+    if (!child.happened)
+        return true;
+
+    if (n == INNER_CAPACITY)
+        return splitInner(ref, i, child, split);
+
+    memmove(keyPtr(node, i + 1), keyPtr(node, i), (n - i) * 8);
+    memmove(childPtr(node, i + 2), childPtr(node, i + 1), (n - i) * 8);
+    store64(keyPtr(node, i), child.key);
+    store64(childPtr(node, i + 1), child.right);
+    setKeyCount(node, n + 1);
+    ref.markDirty();
+    return true;
+}
+
+bool BTree::splitLeaf(BufferPool::PageRef& left, size_t at, uint64_t key, const char* value,
+                      Split& split)
+{
+    BufferPool::PageRef right = pool.allocate();
+    if (!right)
+        return false;
+
+    char* l = left.data();
+    char* r = right.data();
+    size_t n = keyCount(l);
+    // Appending: leave the left leaf full.
+    size_t keep = at == n ? n : n / 2;
+
+    initNode(r, LEAF);
+    char* lValues = l + HEADER + leafCapacity * 8;
+    char* rValues = r + HEADER + leafCapacity * 8;
+    memcpy(keyPtr(r, 0), keyPtr(l, keep), (n - keep) * 8);
+    memcpy(rValues, lValues + keep * valueSize, (n - keep) * valueSize);
+    setKeyCount(r, n - keep);
+    setKeyCount(l, keep);
+    setNextLeaf(r, nextLeaf(l));
+    setNextLeaf(l, right.page());
+
+    // Now there is room on whichever side the key belongs.
+    bool toLeft = keep < n && at <= keep;
+    char* target = toLeft ? l : r;
+    char* values = toLeft ? lValues : rValues;
+    size_t i = toLeft ? at : at - keep;
+    size_t m = keyCount(target);
+    memmove(keyPtr(target, i + 1), keyPtr(target, i), (m - i) * 8);
+    memmove(values + (i + 1) * valueSize, values + i * valueSize, (m - i) * valueSize);
+    store64(keyPtr(target, i), key);
+    memcpy(values + i * valueSize, value, valueSize);
+    setKeyCount(target, m + 1);
+
+    left.markDirty();
+    right.markDirty();
+    split = {true, keyAt(r, 0), right.page()};
+    return true;
+}
+
+bool BTree::splitInner(BufferPool::PageRef& left, size_t at, const Split& child, Split& split)
+{
+    BufferPool::PageRef right = pool.allocate();
+    if (!right)
+        return false;
+
+    // Merge the new separator in, then hand the upper half to `right`
+    // and push the middle key up.
+    char* l = left.data();
+    size_t n = keyCount(l);
+    vector<uint64_t> keys(n + 1);
+    vector<uint64_t> children(n + 2);
+    for (size_t k = 0, j = 0; k <= n; ++k)
+        keys[k] = k == at ? child.key : keyAt(l, j++);
+    for (size_t k = 0, j = 0; k <= n + 1; ++k)
+        children[k] = k == at + 1 ? child.right : childAt(l, j++);
+
+    size_t mid = (n + 1) / 2;
+    char* r = right.data();
+    initNode(r, INNER);
+    for (size_t k = 0; k < mid; ++k)
+        store64(keyPtr(l, k), keys[k]);
+    for (size_t k = 0; k <= mid; ++k)
+        store64(childPtr(l, k), children[k]);
+    setKeyCount(l, mid);
+    for (size_t k = mid + 1; k <= n; ++k)
+        store64(keyPtr(r, k - mid - 1), keys[k]);
+    for (size_t k = mid + 1; k <= n + 1; ++k)
+        store64(childPtr(r, k - mid - 1), children[k]);
+    setKeyCount(r, n - mid);
+
+    left.markDirty();
+    right.markDirty();
+    split = {true, keys[mid], right.page()};
+    return true;
+}
+
+bool BTree::erase(uint64_t key)
+{
+    if (!rootPage)
+        return false;
+    BufferPool::PageRef leaf = findLeaf(key);
+    if (!leaf)
+        return false;
+
+    char* node = leaf.data();
+    size_t n = keyCount(node);
+    size_t i = lowerBound(node, n, key);
+    if (i == n || keyAt(node, i) != key)
+        return false;
+
+    char* values = node + HEADER + leafCapacity * 8;
+    memmove(keyPtr(node, i), keyPtr(node, i + 1), (n - i - 1) * 8);
+    memmove(values + i * valueSize, values + (i + 1) * valueSize, (n - i - 1) * valueSize);
+    setKeyCount(node, n - 1);
+    leaf.markDirty();
+    --entries;
+    return true;
+}
+
+bool BTree::scan(uint64_t from, uint64_t to, const function<bool(uint64_t, const char*)>& fn) const
+{
+    if (!rootPage || from > to)
+        return true;
+    BufferPool::PageRef leaf = findLeaf(from);
+    if (!leaf)
+        return false;
+
+    size_t i = lowerBound(leaf.data(), keyCount(leaf.data()), from);
+    for (;;)
+    {
+        const char* node = leaf.data();
+        const char* values = node + HEADER + leafCapacity * 8;
+        for (size_t n = keyCount(node); i < n; ++i)
+        {
+            uint64_t key = keyAt(node, i);
+            if (key > to || !fn(key, values + i * valueSize))
+                return true;
+        }
+        uint64_t next = nextLeaf(node);
+        if (!next)
+            return true;
+        leaf = pool.fetch(next);
+        if (!leaf)
+            return false;
+        i = 0;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+    B+tree
+    --------------------------------
+    An ordered map from 64-bit keys to fixed-size values, kept in pages
+    of a BufferPool (pagestore.h). Inner pages hold up to 254 keys and
+    child page numbers. Leaf pages hold keys and values and link to the
+    next leaf, so a range scan walks the leaves left to right.
+
+    A full leaf splits in half, except when the new key goes at its
+    end: then the new key starts a leaf of its own. Keys inserted in
+    ascending order (new account ids, one history's sequence numbers)
+    therefore leave full pages behind. erase() never merges pages.
+
+    The tree does no locking of its own. Readers may run together;
+    writers must run alone (StorageEngine serializes them).
+*/
+
+#pragma once
+
+#include "pagestore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class BTree
+{
+private:
+    // A child split: `key` is the first key of the new `right` page.
+    struct Split
+    {
+        bool happened = false;
+        uint64_t key = 0;
+        uint64_t right = 0;
+    };
+
+    BufferPool& pool;
+    const size_t valueSize;
+    const size_t leafCapacity;
+    // 0 while the tree is empty; page 0 is never a node.
+    uint64_t rootPage;
+    uint64_t entries;
+
+    bool insert(uint64_t page, uint64_t key, const char* value, Split& split, bool& added);
+    bool splitLeaf(BufferPool::PageRef& left, size_t at, uint64_t key, const char* value,
+                   Split& split);
+    bool splitInner(BufferPool::PageRef& left, size_t at, const Split& child, Split& split);
+    // The leaf that holds `key` if anything does; empty on a read error.
+    BufferPool::PageRef findLeaf(uint64_t key) const;
+
+public:
+    // Values are `valueSize` bytes. `root` and `count` come from a
+    // previous tree's root() and size(); the defaults start empty.
+    BTree(BufferPool& pool, size_t valueSize, uint64_t root = 0, uint64_t count = 0);
+
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    uint64_t root() const { return rootPage; }
+    uint64_t size() const { return entries; }
+    size_t valueBytes() const { return valueSize; }
+
+    // Copies the value for `key` into `value`; false if absent.
+    bool get(uint64_t key, char* value) const;
+    // Inserts or replaces. False if a page could not be read.
+    bool put(uint64_t key, const char* value);
+    // False if `key` was absent.
+    bool erase(uint64_t key);
+    // Calls fn(key, value) for each key in [from, to], in order, until
+    // it returns false. False on a read error.
+    bool scan(uint64_t from, uint64_t to, const std::function<bool(uint64_t, const char*)>& fn) const;
+};
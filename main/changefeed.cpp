@@ -0,0 +1,267 @@
+#include "changefeed.h"
+#include "journal.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+// Bytes read from the feed per system call.
+static const size_t READ_CHUNK = 64 * 1024;
+
+// ========================================
+// Records
+// ========================================
+
+bool parseChangeEvent(uint64_t seq, string_view record, ChangeEvent& out)
+{
+    JournalRecord r;
+    if (!parseJournalRecord(record, r))
+        return false;
+
+    out = ChangeEvent();
+    out.seq = seq;
+    out.account = r.account;
+    out.target = r.target;
+    out.amount = r.amount;
+    out.amountIn = r.amountIn;
+    out.currency = r.currency;
+    out.owner = move(r.owner);
+    out.timestamp = move(r.timestamp);
+    out.type = move(r.type);
+    switch (r.kind)
+    {
+    case RecordKind::AccountCreated: out.kind = ChangeKind::AccountCreated; break;
+    case RecordKind::Transaction: out.kind = ChangeKind::Transaction; break;
+    case RecordKind::Transfer:
+        out.kind = ChangeKind::Transfer;
+        out.type = "TRANSFER";
+        break;
+    case RecordKind::RateChanged: out.kind = ChangeKind::RateChanged; break;
+    }
+    return true;
+}
+
+uint64_t recoverChangeFeed(const string& path)
+{
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return 0;
+    }
+
+    // Scan backwards for the last two newlines: the last complete record
+    // lies between them, and anything after the last one is torn.
+    off_t end = st.st_size;
+    off_t lastNewline = -1;
+    off_t lineStart = 0;
+    string block;
+    for (off_t pos = end; pos > 0;)
+    {
+        off_t from = pos > static_cast<off_t>(READ_CHUNK) ? pos - static_cast<off_t>(READ_CHUNK) : 0;
+        block.resize(static_cast<size_t>(pos - from));
+        if (pread(fd, block.data(), block.size(), from) != static_cast<ssize_t>(block.size()))
+            break;
+
+        bool found = false;
+        for (size_t i = block.size(); i-- > 0;)
+        {
+            if (block[i] != '\n')
+                continue;
+            if (lastNewline < 0)
+            {
+                lastNewline = from + static_cast<off_t>(i);
+                continue;
+            }
+            lineStart = from + static_cast<off_t>(i) + 1;
+            found = true;
+            break;
+        }
+        if (found)
+            break;
+        pos = from;
+    }
+
+    uint64_t seq = 0;
+    if (lastNewline < 0)
+    {
+        // Not one complete record.
+        if (ftruncate(fd, 0) == 0)
+            fdatasync(fd);
+    }
+    else
+    {
+        if (lastNewline + 1 < end && ftruncate(fd, lastNewline + 1) == 0)
+            fdatasync(fd);
+
+        string line(static_cast<size_t>(lastNewline - lineStart), '\0');
+        string_view record;
+        if (pread(fd, line.data(), line.size(), lineStart) != static_cast<ssize_t>(line.size())
+            || !splitJournalLine(line, seq, record))
+            seq = 0;
+    }
+
+    ::close(fd);
+    return seq;
+}
+
+// ========================================
+// ChangeConsumer
+// ========================================
+
+ChangeConsumer::~ChangeConsumer()
+{
+    close();
+}
+
+bool ChangeConsumer::open(const string& feed, const string& offsets)
+{
+    close();
+    feedPath = feed;
+    offsetPath = offsets;
+
+    // The feed may not exist yet if the consumer starts first.
+    fd = ::open(feedPath.c_str(), O_RDONLY | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    committedOffset = 0;
+    committedSeq = 0;
+    ifstream in(offsetPath);
+    if (in.is_open())
+        in >> committedOffset >> committedSeq;
+
+    readOffset = committedOffset;
+    readSeq = committedSeq;
+    pending.clear();
+
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchFd >= 0 && inotify_add_watch(watchFd, feedPath.c_str(), IN_MODIFY) < 0)
+    {
+        ::close(watchFd);
+        watchFd = -1;
+    }
+    return true;
+}
+
+void ChangeConsumer::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    if (watchFd >= 0)
+    {
+        ::close(watchFd);
+        watchFd = -1;
+    }
+}
+
+size_t ChangeConsumer::poll(vector<ChangeEvent>& out, size_t max)
+{
+    if (fd < 0)
+        return 0;
+
+    // `pending` holds unconsumed bytes starting at readOffset; `head`
+    // walks it and the consumed prefix is dropped once per refill.
+    size_t added = 0;
+    size_t head = 0;
+    while (added < max)
+    {
+        size_t eol = pending.find('\n', head);
+        if (eol == string::npos)
+        {
+            pending.erase(0, head);
+            head = 0;
+
+            size_t have = pending.size();
+            pending.resize(have + READ_CHUNK);
+            ssize_t n = pread(fd, pending.data() + have, READ_CHUNK,
+                              static_cast<off_t>(readOffset + have));
+            pending.resize(have + (n > 0 ? static_cast<size_t>(n) : 0));
+            if (n <= 0)
+                break;
+            continue;
+        }
+
+        string_view line(pending.data() + head, eol - head);
+        readOffset += eol + 1 - head;
+        head = eol + 1;
+
+        uint64_t seq;
+        string_view record;
+        ChangeEvent event;
+        if (!splitJournalLine(line, seq, record) || !parseChangeEvent(seq, record, event))
+            continue;
+
+        readSeq = seq;
+        out.push_back(move(event));
+        ++added;
+    }
+    pending.erase(0, head);
+    return added;
+}
+
+bool ChangeConsumer::wait(int timeoutMs)
+{
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (pending.find('\n') != string::npos
+        || (fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) > readOffset + pending.size()))
+        return true;
+
+    if (watchFd < 0)
+    {
+        // No inotify: sleep briefly and let the caller poll.
+        this_thread::sleep_for(chrono::milliseconds(min(timeoutMs, 10)));
+        return true;
+    }
+
+    pollfd p{watchFd, POLLIN, 0};
+    if (::poll(&p, 1, timeoutMs) <= 0)
+        return false;
+
+    char events[4096];
+    while (read(watchFd, events, sizeof(events)) > 0)
+    {
+    }
+    return true;
+}
+
+bool ChangeConsumer::commit()
+{
+    if (readOffset == committedOffset)
+        return true;
+
+    string tmp = offsetPath + ".tmp";
+    string text = to_string(readOffset) + " " + to_string(readSeq) + "\n";
+    int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+        return false;
+    bool written = ::write(out, text.data(), text.size()) == static_cast<ssize_t>(text.size())
+                   && fsync(out) == 0;
+    ::close(out);
+    if (!written || rename(tmp.c_str(), offsetPath.c_str()) != 0)
+        return false;
+
+    committedOffset = readOffset;
+    committedSeq = readSeq;
+    return true;
+}
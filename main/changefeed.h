@@ -0,0 +1,124 @@
+/*
+    Change data capture
+    --------------------------------
+    With Bank::enableChangeFeed(), every journal record that becomes
+    durable (account creation, deposit, withdrawal, interest, transfer,
+    rate change) is also appended to a feed file, "<data file>.cdc" by
+    default. Unlike the journal, the feed is never truncated by a
+    snapshot, and it uses the journal's sequence numbers, which only
+    ever increase.
+
+    Records reach the feed only when the journal is flushed:
+    Bank::syncJournal(), a session's persist(), save() or a checkpoint.
+    The bank runs no flush timer of its own, so a writer that stops
+    without flushing leaves its last records out of the feed until
+    something flushes again.
+
+    A ChangeConsumer tails the feed from its own committed offset:
+
+        ChangeConsumer feed;
+        feed.open("bank_data.txt.cdc", "warehouse.offset");
+        vector<ChangeEvent> events;
+        while (running)
+        {
+            feed.wait(100);
+            feed.poll(events);
+            ... apply events ...
+            feed.commit();
+            events.clear();
+        }
+
+    Delivery is at-least-once: events polled but not committed before a
+    restart are delivered again, and consumers can use `seq` to skip
+    duplicates.
+*/
+
+#pragma once
+
+#include "currency.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class ChangeKind : uint8_t
+{
+    AccountCreated,
+    Transaction,  // DEPOSIT, WITHDRAW, INTEREST, ... (see `type`)
+    Transfer,
+    RateChanged
+};
+
+struct ChangeEvent
+{
+    uint64_t seq = 0;
+    ChangeKind kind = ChangeKind::Transaction;
+    int account = 0;
+    // Transfer only: credited account and the amount it received.
+    int target = 0;
+    double amountIn = 0.0;
+    // AccountCreated: the account's currency. RateChanged: the currency
+    // whose USD value changed.
+    Currency currency = Currency::USD;
+    std::string owner;
+    std::string timestamp;
+    std::string type;
+    // Transaction/Transfer: amount in the (source) account's currency.
+    // RateChanged: the new USD value.
+    double amount = 0.0;
+};
+
+// Parses one journal record (without its sequence number), with the
+// journal's own parseJournalRecord().
+bool parseChangeEvent(uint64_t seq, std::string_view record, ChangeEvent& out);
+
+// Drops a record torn by a crash from the end of the feed at `path`
+// and returns the last sequence number in it (0 if empty or missing).
+uint64_t recoverChangeFeed(const std::string& path);
+
+// ========================================
+// ChangeConsumer
+// ========================================
+
+class ChangeConsumer
+{
+private:
+    std::string feedPath;
+    std::string offsetPath;
+    int fd = -1;
+    int watchFd = -1;
+    uint64_t committedOffset = 0;
+    uint64_t committedSeq = 0;
+    // Position after the last polled event, and that event's seq.
+    uint64_t readOffset = 0;
+    uint64_t readSeq = 0;
+    std::string pending;
+
+public:
+    ChangeConsumer() = default;
+    ~ChangeConsumer();
+
+    ChangeConsumer(const ChangeConsumer&) = delete;
+    ChangeConsumer& operator=(const ChangeConsumer&) = delete;
+
+    // Resumes after the offset stored in `offsetPath`, or at the start
+    // of the feed if there is none.
+    bool open(const std::string& feedPath, const std::string& offsetPath);
+    void close();
+
+    // Appends up to `max` new complete events to `out` and returns how
+    // many were added. Malformed records are skipped.
+    size_t poll(std::vector<ChangeEvent>& out, size_t max = SIZE_MAX);
+
+    // Blocks for up to `timeoutMs` until the feed grows; true if it did
+    // (or may have). Returns at once if data is already waiting.
+    bool wait(int timeoutMs);
+
+    // Durably records that everything polled so far has been handled.
+    bool commit();
+
+    uint64_t lastCommittedSeq() const { return committedSeq; }
+    uint64_t lastPolledSeq() const { return readSeq; }
+};
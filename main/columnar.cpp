@@ -0,0 +1,453 @@
+#include "columnar.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+static const char MAGIC[8] = {'B', 'K', 'C', 'O', 'L', '1', '\n', '\0'};
+
+// ========================================
+// Primitive encoding
+// ========================================
+
+static void putVarint(string& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+static void putZigzag(string& out, int64_t v)
+{
+    putVarint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+static void putString(string& out, const string& s)
+{
+    putVarint(out, s.size());
+    out += s;
+}
+
+static void putDouble(string& out, double v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Bounds-checked decoding; any overrun clears `ok` and yields zeros.
+struct Cursor
+{
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    Cursor(const string& s) : p(s.data()), end(s.data() + s.size()) {}
+
+    uint8_t byte()
+    {
+        if (p >= end)
+        {
+            ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(*p++);
+    }
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t b = byte();
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t zigzag()
+    {
+        uint64_t v = varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    double dbl()
+    {
+        double v = 0.0;
+        if (end - p < static_cast<ptrdiff_t>(sizeof(v)))
+        {
+            ok = false;
+            return v;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+
+    string str()
+    {
+        uint64_t len = varint();
+        if (static_cast<uint64_t>(end - p) < len)
+        {
+            ok = false;
+            return {};
+        }
+        string s(p, len);
+        p += len;
+        return s;
+    }
+};
+
+// ========================================
+// Row group encoding
+// ========================================
+
+static void encodeInt64(const vector<int64_t>& values, string& out, ColumnChunkMeta& meta)
+{
+    meta.encoding = ColumnEncoding::Delta;
+    int64_t prev = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        // Differences wrap like the unsigned arithmetic they stand for.
+        putZigzag(out, static_cast<int64_t>(static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(prev)));
+        prev = values[i];
+    }
+
+    if (!values.empty())
+    {
+        auto [lo, hi] = minmax_element(values.begin(), values.end());
+        meta.stats.minInt = *lo;
+        meta.stats.maxInt = *hi;
+    }
+}
+
+static void encodeDouble(const vector<double>& values, string& out, ColumnChunkMeta& meta)
+{
+    meta.encoding = ColumnEncoding::Plain;
+    out.reserve(values.size() * sizeof(double));
+    for (double v : values)
+        putDouble(out, v);
+
+    if (!values.empty())
+    {
+        auto [lo, hi] = minmax_element(values.begin(), values.end());
+        meta.stats.minDouble = *lo;
+        meta.stats.maxDouble = *hi;
+    }
+}
+
+static void encodeString(const vector<string>& values, string& out, ColumnChunkMeta& meta)
+{
+    if (values.empty())
+        return;
+
+    unordered_map<string, uint32_t> dict;
+    vector<const string*> entries;
+    vector<uint32_t> codes(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        auto [it, added] = dict.try_emplace(values[i], static_cast<uint32_t>(entries.size()));
+        if (added)
+            entries.push_back(&it->first);
+        codes[i] = it->second;
+    }
+
+    const string* lo = entries[0];
+    const string* hi = entries[0];
+    for (const string* e : entries)
+    {
+        if (*e < *lo)
+            lo = e;
+        if (*hi < *e)
+            hi = e;
+    }
+    meta.stats.minString = *lo;
+    meta.stats.maxString = *hi;
+
+    // A dictionary only pays off when values repeat.
+    if (entries.size() * 2 > values.size())
+    {
+        meta.encoding = ColumnEncoding::Plain;
+        for (const auto& v : values)
+            putString(out, v);
+        return;
+    }
+
+    meta.encoding = ColumnEncoding::Dictionary;
+    putVarint(out, entries.size());
+    for (const string* e : entries)
+        putString(out, *e);
+    for (uint32_t c : codes)
+        putVarint(out, c);
+}
+
+EncodedRowGroup encodeRowGroup(const vector<ColumnSpec>& schema, const vector<ColumnData>& columns)
+{
+    EncodedRowGroup group;
+    group.chunks.resize(schema.size());
+    group.meta.resize(schema.size());
+
+    for (size_t c = 0; c < schema.size(); ++c)
+    {
+        switch (schema[c].type)
+        {
+        case ColumnType::Int64:
+            group.rows = columns[c].ints.size();
+            encodeInt64(columns[c].ints, group.chunks[c], group.meta[c]);
+            break;
+        case ColumnType::Double:
+            group.rows = columns[c].doubles.size();
+            encodeDouble(columns[c].doubles, group.chunks[c], group.meta[c]);
+            break;
+        case ColumnType::String:
+            group.rows = columns[c].strings.size();
+            encodeString(columns[c].strings, group.chunks[c], group.meta[c]);
+            break;
+        }
+        group.meta[c].size = group.chunks[c].size();
+    }
+    return group;
+}
+
+// ========================================
+// ColumnarWriter
+// ========================================
+
+ColumnarWriter::ColumnarWriter(const string& path, const string& table,
+                               vector<ColumnSpec> schema, uint64_t snapshotSeq)
+    : file(path, ios::binary | ios::trunc), table(table), schema(move(schema)),
+      snapshotSeq(snapshotSeq)
+{
+    file.write(MAGIC, sizeof(MAGIC));
+    offset = sizeof(MAGIC);
+}
+
+void ColumnarWriter::writeRowGroup(const EncodedRowGroup& group)
+{
+    vector<ColumnChunkMeta> meta = group.meta;
+    for (size_t c = 0; c < group.chunks.size(); ++c)
+    {
+        meta[c].offset = offset;
+        file.write(group.chunks[c].data(), static_cast<streamsize>(group.chunks[c].size()));
+        offset += group.chunks[c].size();
+    }
+    groupRows.push_back(group.rows);
+    groupMeta.push_back(move(meta));
+}
+
+bool ColumnarWriter::finish()
+{
+    string footer;
+    putString(footer, table);
+    putVarint(footer, snapshotSeq);
+
+    putVarint(footer, schema.size());
+    for (const auto& col : schema)
+    {
+        putString(footer, col.name);
+        footer += static_cast<char>(col.type);
+    }
+
+    putVarint(footer, groupRows.size());
+    for (size_t g = 0; g < groupRows.size(); ++g)
+    {
+        putVarint(footer, groupRows[g]);
+        for (size_t c = 0; c < schema.size(); ++c)
+        {
+            const ColumnChunkMeta& m = groupMeta[g][c];
+            putVarint(footer, m.offset);
+            putVarint(footer, m.size);
+            footer += static_cast<char>(m.encoding);
+            switch (schema[c].type)
+            {
+            case ColumnType::Int64:
+                putZigzag(footer, m.stats.minInt);
+                putZigzag(footer, m.stats.maxInt);
+                break;
+            case ColumnType::Double:
+                putDouble(footer, m.stats.minDouble);
+                putDouble(footer, m.stats.maxDouble);
+                break;
+            case ColumnType::String:
+                putString(footer, m.stats.minString);
+                putString(footer, m.stats.maxString);
+                break;
+            }
+        }
+    }
+
+    uint32_t len = static_cast<uint32_t>(footer.size());
+    file.write(footer.data(), static_cast<streamsize>(footer.size()));
+    file.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    file.write(MAGIC, sizeof(MAGIC));
+    file.close();
+    return !file.fail();
+}
+
+// ========================================
+// ColumnarReader
+// ========================================
+
+bool ColumnarReader::open(const string& path)
+{
+    file.open(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[sizeof(MAGIC)];
+    uint32_t len;
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    streamoff tail = static_cast<streamoff>(sizeof(len) + sizeof(MAGIC));
+    if (size < static_cast<streamoff>(sizeof(MAGIC)) + tail)
+        return false;
+
+    file.seekg(size - tail);
+    file.read(reinterpret_cast<char*>(&len), sizeof(len));
+    file.read(magic, sizeof(magic));
+    if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || len > size - tail)
+        return false;
+
+    string footer(len, '\0');
+    file.seekg(size - tail - len);
+    file.read(footer.data(), len);
+    if (!file)
+        return false;
+
+    Cursor in(footer);
+    table = in.str();
+    snapshotSeq = in.varint();
+
+    size_t columns = in.varint();
+    for (size_t c = 0; c < columns && in.ok; ++c)
+    {
+        string name = in.str();
+        uint8_t type = in.byte();
+        if (type > static_cast<uint8_t>(ColumnType::String))
+            return false;
+        schema.push_back({name, static_cast<ColumnType>(type)});
+    }
+
+    size_t groups = in.varint();
+    for (size_t g = 0; g < groups && in.ok; ++g)
+    {
+        groupRows.push_back(in.varint());
+        vector<ColumnChunkMeta> meta(schema.size());
+        for (size_t c = 0; c < schema.size(); ++c)
+        {
+            meta[c].offset = in.varint();
+            meta[c].size = in.varint();
+            meta[c].encoding = static_cast<ColumnEncoding>(in.byte());
+            switch (schema[c].type)
+            {
+            case ColumnType::Int64:
+                meta[c].stats.minInt = in.zigzag();
+                meta[c].stats.maxInt = in.zigzag();
+                break;
+            case ColumnType::Double:
+                meta[c].stats.minDouble = in.dbl();
+                meta[c].stats.maxDouble = in.dbl();
+                break;
+            case ColumnType::String:
+                meta[c].stats.minString = in.str();
+                meta[c].stats.maxString = in.str();
+                break;
+            }
+        }
+        groupMeta.push_back(move(meta));
+    }
+    return in.ok;
+}
+
+size_t ColumnarReader::rowCount() const
+{
+    size_t n = 0;
+    for (size_t rows : groupRows)
+        n += rows;
+    return n;
+}
+
+int ColumnarReader::columnIndex(const string& name) const
+{
+    for (size_t c = 0; c < schema.size(); ++c)
+    {
+        if (schema[c].name == name)
+            return static_cast<int>(c);
+    }
+    return -1;
+}
+
+bool ColumnarReader::readChunk(size_t group, size_t column, string& out) const
+{
+    const ColumnChunkMeta& m = groupMeta[group][column];
+    out.resize(m.size);
+    file.clear();
+    file.seekg(static_cast<streamoff>(m.offset));
+    file.read(out.data(), static_cast<streamsize>(m.size));
+    return static_cast<bool>(file);
+}
+
+bool ColumnarReader::readInt64(size_t group, size_t column, vector<int64_t>& out) const
+{
+    string chunk;
+    if (schema[column].type != ColumnType::Int64 || !readChunk(group, column, chunk))
+        return false;
+
+    Cursor in(chunk);
+    uint64_t prev = 0;
+    for (size_t i = 0; i < groupRows[group] && in.ok; ++i)
+    {
+        prev += static_cast<uint64_t>(in.zigzag());
+        out.push_back(static_cast<int64_t>(prev));
+    }
+    return in.ok;
+}
+
+bool ColumnarReader::readDouble(size_t group, size_t column, vector<double>& out) const
+{
+    string chunk;
+    if (schema[column].type != ColumnType::Double || !readChunk(group, column, chunk))
+        return false;
+
+    Cursor in(chunk);
+    for (size_t i = 0; i < groupRows[group] && in.ok; ++i)
+        out.push_back(in.dbl());
+    return in.ok;
+}
+
+bool ColumnarReader::readString(size_t group, size_t column, vector<string>& out) const
+{
+    string chunk;
+    if (schema[column].type != ColumnType::String || !readChunk(group, column, chunk))
+        return false;
+
+    Cursor in(chunk);
+    size_t rows = groupRows[group];
+    if (groupMeta[group][column].encoding == ColumnEncoding::Plain)
+    {
+        for (size_t i = 0; i < rows && in.ok; ++i)
+            out.push_back(in.str());
+        return in.ok;
+    }
+
+    uint64_t entries = in.varint();
+    if (entries > chunk.size())
+        return false;
+    vector<string> dict(entries);
+    for (auto& e : dict)
+        e = in.str();
+    for (size_t i = 0; i < rows && in.ok; ++i)
+    {
+        uint64_t code = in.varint();
+        if (code >= dict.size())
+            return false;
+        out.push_back(dict[code]);
+    }
+    return in.ok;
+}
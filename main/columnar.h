@@ -0,0 +1,179 @@
+/*
+    Columnar export files
+    --------------------------------
+    A small self-describing column store for analytics, written by
+    Bank::exportColumnar(). Each file holds one table split into row
+    groups; within a row group every column is stored as its own
+    contiguous chunk, so a reader fetches only the columns it needs.
+
+        "BKCOL1\n\0"
+        row group 0: column chunk 0, column chunk 1, ...
+        row group 1: ...
+        footer
+        u32 footer length
+        "BKCOL1\n\0"
+
+    All integers are little-endian; "varint" is unsigned LEB128 and
+    signed values are zigzag-encoded first. Strings are a varint length
+    followed by the bytes; doubles are 8 raw bytes.
+
+    Footer:
+        string   table name
+        varint   snapshot sequence (journal seq the data is consistent with)
+        varint   column count, then per column: string name, u8 type
+        varint   row group count, then per row group:
+                 varint rows, then per column:
+                 varint offset, varint size, u8 encoding, min, max
+
+    min/max are zigzag varints (Int64), doubles (Double) or strings
+    (String); for an empty chunk both are zero/empty.
+
+    Chunk encodings:
+        Plain       Double: 8 bytes per value. String: one string per value.
+        Dictionary  String: varint entry count, entries, then a varint
+                    entry index per value.
+        Delta       Int64: zigzag varint of the first value, then zigzag
+                    varint differences to the previous value.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class ColumnType : uint8_t
+{
+    Int64,
+    Double,
+    String
+};
+
+enum class ColumnEncoding : uint8_t
+{
+    Plain,
+    Dictionary,
+    Delta
+};
+
+struct ColumnSpec
+{
+    std::string name;
+    ColumnType type;
+};
+
+// Values of one column for one row group; only the vector matching the
+// column's type is used.
+struct ColumnData
+{
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+};
+
+struct ColumnStats
+{
+    int64_t minInt = 0;
+    int64_t maxInt = 0;
+    double minDouble = 0.0;
+    double maxDouble = 0.0;
+    std::string minString;
+    std::string maxString;
+};
+
+struct ColumnChunkMeta
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    ColumnEncoding encoding = ColumnEncoding::Plain;
+    ColumnStats stats;
+};
+
+// A row group encoded in memory, ready to be appended to a file. Row
+// groups are independent, so they can be encoded in parallel.
+struct EncodedRowGroup
+{
+    size_t rows = 0;
+    std::vector<std::string> chunks;
+    std::vector<ColumnChunkMeta> meta;
+};
+
+// Picks each column's encoding (Delta for Int64, Plain for Double,
+// Dictionary for String unless most values are distinct) and computes
+// its statistics.
+EncodedRowGroup encodeRowGroup(const std::vector<ColumnSpec>& schema,
+                               const std::vector<ColumnData>& columns);
+
+// ========================================
+// ColumnarWriter
+// ========================================
+
+class ColumnarWriter
+{
+private:
+    std::ofstream file;
+    std::string table;
+    std::vector<ColumnSpec> schema;
+    uint64_t snapshotSeq;
+    uint64_t offset = 0;
+    std::vector<size_t> groupRows;
+    std::vector<std::vector<ColumnChunkMeta>> groupMeta;
+
+public:
+    ColumnarWriter(const std::string& path, const std::string& table,
+                   std::vector<ColumnSpec> schema, uint64_t snapshotSeq);
+
+    bool isOpen() const { return file.is_open() && file.good(); }
+
+    // Row groups are stored in the order they are written.
+    void writeRowGroup(const EncodedRowGroup& group);
+
+    // Writes the footer; false if any write failed.
+    bool finish();
+};
+
+// ========================================
+// ColumnarReader
+// ========================================
+
+// Reads the footer on open; column reads fetch only that column's
+// chunks.
+class ColumnarReader
+{
+private:
+    mutable std::ifstream file;
+    std::string table;
+    uint64_t snapshotSeq = 0;
+    std::vector<ColumnSpec> schema;
+    std::vector<size_t> groupRows;
+    std::vector<std::vector<ColumnChunkMeta>> groupMeta;
+
+    bool readChunk(size_t group, size_t column, std::string& out) const;
+
+public:
+    bool open(const std::string& path);
+
+    const std::string& tableName() const { return table; }
+    uint64_t getSnapshotSeq() const { return snapshotSeq; }
+    const std::vector<ColumnSpec>& getSchema() const { return schema; }
+    size_t rowGroupCount() const { return groupRows.size(); }
+    size_t rowGroupRows(size_t group) const { return groupRows[group]; }
+    size_t rowCount() const;
+
+    // Column index by name, -1 if absent.
+    int columnIndex(const std::string& name) const;
+
+    // Statistics for skipping row groups without reading them.
+    const ColumnChunkMeta& chunkMeta(size_t group, size_t column) const
+    {
+        return groupMeta[group][column];
+    }
+
+    // Appends the column's values in one row group to `out`. False if
+    // the type does not match or the chunk is corrupt.
+    bool readInt64(size_t group, size_t column, std::vector<int64_t>& out) const;
+    bool readDouble(size_t group, size_t column, std::vector<double>& out) const;
+    bool readString(size_t group, size_t column, std::vector<std::string>& out) const;
+};
@@ -0,0 +1,120 @@
+#include "currency.h"
+#include "textformat.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cmath>
+#include <fstream>
+
+using namespace std;
+
+const char* currencyCode(Currency c)
+{
+    static const char* codes[CURRENCY_COUNT] = {"USD", "EUR", "GBP", "JPY", "CHF", "CAD"};
+    return codes[static_cast<size_t>(c)];
+}
+
+bool parseCurrency(string_view code, Currency& out)
+{
+    for (size_t i = 0; i < CURRENCY_COUNT; ++i)
+    {
+        Currency c = static_cast<Currency>(i);
+        if (code == currencyCode(c))
+        {
+            out = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+RateTable::RateTable()
+{
+    usdValue[static_cast<size_t>(Currency::USD)] = 1.0;
+    rebuild();
+}
+
+void RateTable::rebuild()
+{
+    for (size_t to = 0; to < CURRENCY_COUNT; ++to)
+    {
+        for (size_t from = 0; from < CURRENCY_COUNT; ++from)
+        {
+            double r = 0.0;
+            if (from == to)
+                r = 1.0;
+            else if (usdValue[from] > 0.0 && usdValue[to] > 0.0)
+                r = usdValue[from] / usdValue[to];
+            pairs[to * CURRENCY_COUNT + from] = r;
+        }
+    }
+}
+
+void RateTable::setRate(Currency c, double inUsd)
+{
+    if (c == Currency::USD || inUsd <= 0.0)
+        return;
+    usdValue[static_cast<size_t>(c)] = inUsd;
+    rebuild();
+}
+
+bool RateTable::save(const string& filename) const
+{
+    // Rates must read back exactly, like snapshot balances.
+    string out;
+    for (size_t i = 0; i < CURRENCY_COUNT; ++i)
+    {
+        Currency c = static_cast<Currency>(i);
+        if (c == Currency::USD || usdValue[i] <= 0.0)
+            continue;
+        out += currencyCode(c);
+        out += ' ';
+        appendNumber(out, usdValue[i]);
+        out += '\n';
+    }
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    const char* p = out.data();
+    size_t left = out.size();
+    bool ok = true;
+    while (ok && left > 0)
+    {
+        ssize_t n = ::write(fd, p, left);
+        ok = n >= 0;
+        if (ok)
+        {
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+    ok = ok && fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+void RateTable::load(const string& filename)
+{
+    ifstream file(filename);
+    if (!file.is_open())
+        return;
+
+    // A bad entry is skipped without ending the read; the rest are
+    // rejected the same way Bank::setExchangeRate() rejects them.
+    string code;
+    string text;
+    while (file >> code >> text)
+    {
+        Currency c;
+        double value = 0.0;
+        auto r = from_chars(text.data(), text.data() + text.size(), value);
+        if (r.ec != errc() || r.ptr != text.data() + text.size())
+            continue;
+        if (parseCurrency(code, c) && c != Currency::USD && isfinite(value) && value > 0.0)
+            usdValue[static_cast<size_t>(c)] = value;
+    }
+    rebuild();
+}
@@ -0,0 +1,79 @@
+/*
+    Currencies and exchange rates
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum class Currency : uint8_t
+{
+    USD,
+    EUR,
+    GBP,
+    JPY,
+    CHF,
+    CAD,
+    Count
+};
+
+constexpr size_t CURRENCY_COUNT = static_cast<size_t>(Currency::Count);
+
+const char* currencyCode(Currency c);
+bool parseCurrency(std::string_view code, Currency& out);
+
+// Exchange rates are quoted against USD and expanded into a dense
+// CURRENCY_COUNT x CURRENCY_COUNT pair table, so a conversion is one
+// indexed load. The table is stored row-per-target-currency: converting a
+// batch into one reporting currency only ever reads a single row.
+// A rate of 0 means "unknown" and makes the pair unconvertible.
+class RateTable
+{
+private:
+    std::array<double, CURRENCY_COUNT> usdValue{};
+    std::array<double, CURRENCY_COUNT * CURRENCY_COUNT> pairs{};
+
+    static size_t index(Currency from, Currency to)
+    {
+        return static_cast<size_t>(to) * CURRENCY_COUNT + static_cast<size_t>(from);
+    }
+
+    void rebuild();
+
+public:
+    RateTable();
+
+    // Value of one unit of `c` in USD.
+    void setRate(Currency c, double inUsd);
+
+    double usdRate(Currency c) const { return usdValue[static_cast<size_t>(c)]; }
+
+    double rate(Currency from, Currency to) const { return pairs[index(from, to)]; }
+
+    bool canConvert(Currency from, Currency to) const { return rate(from, to) > 0.0; }
+
+    double convert(double amount, Currency from, Currency to) const
+    {
+        return amount * rate(from, to);
+    }
+
+    // Converts n balances into `to`. Branch-free over contiguous arrays so
+    // the compiler can vectorize it; unknown pairs convert to 0.
+    void convertBatch(const double* amounts, const Currency* from, size_t n,
+                      Currency to, double* out) const
+    {
+        const double* row = &pairs[static_cast<size_t>(to) * CURRENCY_COUNT];
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = amounts[i] * row[static_cast<size_t>(from[i])];
+        }
+    }
+
+    // Writes and syncs the rates; false if any step failed.
+    bool save(const std::string& filename) const;
+    void load(const std::string& filename);
+};
@@ -0,0 +1,148 @@
+#include "epoch.h"
+
+using namespace std;
+
+// ========================================
+// Participants
+// ========================================
+
+// Releases the calling thread's record when the thread exits, so a
+// later thread can take it over.
+struct EpochThreadRecord
+{
+    EpochDomain::Participant* participant = nullptr;
+
+    ~EpochThreadRecord()
+    {
+        if (!participant)
+            return;
+        participant->state.store(0, memory_order_release);
+        participant->claimed.store(false, memory_order_release);
+    }
+};
+
+static thread_local EpochThreadRecord threadRecord;
+
+EpochDomain& EpochDomain::shared()
+{
+    static EpochDomain domain;
+    return domain;
+}
+
+EpochDomain::~EpochDomain()
+{
+    // Participant records stay allocated: threads that outlive the
+    // domain still release theirs on exit.
+    for (const Retired& r : limbo)
+        r.deleter(r.object);
+}
+
+EpochDomain::Participant* EpochDomain::local()
+{
+    if (threadRecord.participant)
+        return threadRecord.participant;
+
+    for (Participant* p = participants.load(memory_order_acquire); p; p = p->next)
+    {
+        bool expected = false;
+        if (!p->claimed.load(memory_order_relaxed)
+            && p->claimed.compare_exchange_strong(expected, true, memory_order_acquire))
+        {
+            p->nesting = 0;
+            threadRecord.participant = p;
+            return p;
+        }
+    }
+
+    Participant* p = new Participant();
+    p->claimed.store(true, memory_order_relaxed);
+    Participant* head = participants.load(memory_order_relaxed);
+    do
+    {
+        p->next = head;
+    } while (!participants.compare_exchange_weak(head, p, memory_order_release,
+                                                 memory_order_relaxed));
+    threadRecord.participant = p;
+    return p;
+}
+
+// ========================================
+// Pinning
+// ========================================
+
+EpochDomain::Guard EpochDomain::pin()
+{
+    Participant* p = local();
+    if (p->nesting++ == 0)
+    {
+        uint64_t e = globalEpoch.load(memory_order_relaxed);
+        p->state.store((e << 1) | 1, memory_order_relaxed);
+        // The announcement must be visible before any shared pointer is
+        // read, or tryAdvance() could miss this reader.
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    return Guard(this, p);
+}
+
+void EpochDomain::unpin(Participant* p)
+{
+    if (--p->nesting == 0)
+        p->state.store(0, memory_order_release);
+}
+
+bool EpochDomain::tryAdvance()
+{
+    uint64_t e = globalEpoch.load(memory_order_seq_cst);
+    for (Participant* p = participants.load(memory_order_acquire); p; p = p->next)
+    {
+        uint64_t s = p->state.load(memory_order_seq_cst);
+        if ((s & 1) && (s >> 1) != e)
+            return false;
+    }
+    return globalEpoch.compare_exchange_strong(e, e + 1, memory_order_seq_cst);
+}
+
+// ========================================
+// Reclamation
+// ========================================
+
+size_t EpochDomain::freeExpired()
+{
+    uint64_t e = globalEpoch.load(memory_order_acquire);
+    size_t freed = 0;
+    for (size_t i = 0; i < limbo.size();)
+    {
+        if (limbo[i].epoch + 2 > e)
+        {
+            ++i;
+            continue;
+        }
+        limbo[i].deleter(limbo[i].object);
+        limbo[i] = limbo.back();
+        limbo.pop_back();
+        ++freed;
+    }
+    freedCount.fetch_add(freed, memory_order_relaxed);
+    return freed;
+}
+
+void EpochDomain::retire(void* object, void (*deleter)(void*))
+{
+    uint64_t e = globalEpoch.load(memory_order_seq_cst);
+    lock_guard<mutex> lock(limboMutex);
+    limbo.push_back({object, deleter, e});
+    retiredCount.fetch_add(1, memory_order_relaxed);
+
+    tryAdvance();
+    freeExpired();
+}
+
+size_t EpochDomain::collect()
+{
+    lock_guard<mutex> lock(limboMutex);
+    // Two steps free everything retired before the call, unless a
+    // reader is still pinned.
+    tryAdvance();
+    tryAdvance();
+    return freeExpired();
+}
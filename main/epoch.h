@@ -0,0 +1,135 @@
+/*
+    Epoch-based memory reclamation
+    --------------------------------
+    Lets readers walk shared structures without locks or reference
+    counts while writers replace parts of them. A reader pins the
+    current epoch for the duration of its read:
+
+        {
+            auto guard = EpochDomain::shared().pin();
+            const Node* n = head.load(std::memory_order_acquire);
+            ... read n ...
+        }
+
+    A writer that unlinks an object hands it to retire() instead of
+    deleting it. The object is freed once the global epoch has moved
+    two steps past the epoch it was retired in, which cannot happen
+    while any reader that could still see it stays pinned.
+
+    Pinning and unpinning are a couple of stores to the thread's own
+    record and never wait. Retiring takes a mutex; writers retire
+    rarely (a structure outgrowing its storage), so that keeps the
+    bookkeeping simple.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class EpochDomain
+{
+private:
+    // One per thread that has ever pinned; records of exited threads
+    // are reused and never freed.
+    struct alignas(64) Participant
+    {
+        // 0 while quiescent, otherwise (epoch << 1) | 1.
+        std::atomic<uint64_t> state{0};
+        std::atomic<bool> claimed{false};
+        uint32_t nesting = 0;
+        Participant* next = nullptr;
+    };
+
+    struct Retired
+    {
+        void* object;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    std::atomic<uint64_t> globalEpoch{1};
+    std::atomic<Participant*> participants{nullptr};
+
+    std::mutex limboMutex;
+    std::vector<Retired> limbo;
+    std::atomic<uint64_t> retiredCount{0};
+    std::atomic<uint64_t> freedCount{0};
+
+    EpochDomain() = default;
+
+    Participant* local();
+    void unpin(Participant* p);
+    // Moves the epoch on if every pinned reader has seen the current one.
+    bool tryAdvance();
+    // Requires limboMutex.
+    size_t freeExpired();
+
+    friend struct EpochThreadRecord;
+
+public:
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Domain shared by every structure in the bank.
+    static EpochDomain& shared();
+
+    class Guard
+    {
+    private:
+        EpochDomain* domain;
+        Participant* participant;
+
+        friend class EpochDomain;
+        Guard(EpochDomain* domain, Participant* participant)
+            : domain(domain), participant(participant) {}
+
+    public:
+        Guard(Guard&& other) noexcept
+            : domain(other.domain), participant(other.participant)
+        {
+            other.domain = nullptr;
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+        ~Guard()
+        {
+            if (domain)
+                domain->unpin(participant);
+        }
+    };
+
+    // Pins may nest; only the outermost one publishes the epoch.
+    Guard pin();
+
+    // Frees `object` with `deleter` once no pinned reader can see it.
+    // The caller must already have unlinked it.
+    void retire(void* object, void (*deleter)(void*));
+
+    template <typename T>
+    void retire(T* object)
+    {
+        retire(object, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    template <typename T>
+    void retireArray(T* objects)
+    {
+        retire(objects, [](void* p) { delete[] static_cast<T*>(p); });
+    }
+
+    // Advances as far as the pinned readers allow and frees what has
+    // expired. Returns the number of objects freed.
+    size_t collect();
+
+    uint64_t epoch() const { return globalEpoch.load(std::memory_order_acquire); }
+    uint64_t retired() const { return retiredCount.load(std::memory_order_relaxed); }
+    uint64_t freed() const { return freedCount.load(std::memory_order_relaxed); }
+};
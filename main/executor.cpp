@@ -0,0 +1,247 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+// Index of the pool worker running on this thread, -1 elsewhere.
+static thread_local const Executor* currentExecutor = nullptr;
+static thread_local int currentIndex = -1;
+
+Executor::Executor(size_t threads)
+{
+    threads = max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i)
+        workers.push_back(make_unique<Worker>());
+
+    if (threads > 1)
+        workers.back()->interactiveOnly = true;
+
+    for (size_t i = 0; i < threads; ++i)
+        workers[i]->thread = thread([this, i] { runWorker(i); });
+}
+
+Executor::~Executor()
+{
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (auto& w : workers)
+        w->thread.join();
+}
+
+Executor& Executor::shared()
+{
+    static Executor pool;
+    return pool;
+}
+
+int Executor::currentWorker() const
+{
+    return currentExecutor == this ? currentIndex : -1;
+}
+
+void Executor::submit(function<void()> fn, Priority prio, CancellationToken token)
+{
+    size_t p = static_cast<size_t>(prio);
+
+    // Workers push onto their own deque; outside threads spread round-robin
+    // over the workers that accept this priority.
+    int self = currentWorker();
+    size_t target;
+    if (self >= 0)
+        target = static_cast<size_t>(self);
+    else
+        target = nextWorker.fetch_add(1, memory_order_relaxed) % workers.size();
+
+    if (prio != Priority::Interactive && workers[target]->interactiveOnly)
+        target = 0;
+
+    {
+        lock_guard<mutex> lock(workers[target]->mutex);
+        workers[target]->queues[p].push_back({move(fn), move(token)});
+    }
+    queued[p].fetch_add(1, memory_order_release);
+
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    if (prio == Priority::Interactive)
+        wake.notify_all();
+    else
+        wake.notify_one();
+}
+
+bool Executor::popLocal(Worker& w, size_t prio, Job& out)
+{
+    lock_guard<mutex> lock(w.mutex);
+    auto& q = w.queues[prio];
+    if (q.empty())
+        return false;
+    out = move(q.back());
+    q.pop_back();
+    return true;
+}
+
+bool Executor::steal(size_t thief, size_t prio, Job& out)
+{
+    size_t n = workers.size();
+    for (size_t k = 1; k <= n; ++k)
+    {
+        Worker& victim = *workers[(thief + k) % n];
+        lock_guard<mutex> lock(victim.mutex);
+        auto& q = victim.queues[prio];
+        if (q.empty())
+            continue;
+        out = move(q.front());
+        q.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool Executor::findJob(size_t self, Priority lowest, Job& out)
+{
+    for (size_t p = 0; p <= static_cast<size_t>(lowest); ++p)
+    {
+        if (queued[p].load(memory_order_acquire) == 0)
+            continue;
+        if ((self < workers.size() && popLocal(*workers[self], p, out)) || steal(self, p, out))
+        {
+            queued[p].fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::runWorker(size_t self)
+{
+    currentExecutor = this;
+    currentIndex = static_cast<int>(self);
+    Priority lowest = workers[self]->interactiveOnly ? Priority::Interactive : Priority::Bulk;
+
+    while (true)
+    {
+        Job job;
+        if (findJob(self, lowest, job))
+        {
+            if (!job.token.isCancelled())
+                job.fn();
+            continue;
+        }
+
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [&] {
+            if (stopping.load())
+                return true;
+            for (size_t p = 0; p <= static_cast<size_t>(lowest); ++p)
+            {
+                if (queued[p].load(memory_order_acquire) > 0)
+                    return true;
+            }
+            return false;
+        });
+        if (stopping.load())
+            return;
+    }
+}
+
+bool Executor::runPending(Priority lowest)
+{
+    int self = currentWorker();
+    size_t from = self >= 0 ? static_cast<size_t>(self) : workers.size();
+
+    Job job;
+    if (!findJob(from, lowest, job))
+        return false;
+
+    if (!job.token.isCancelled())
+        job.fn();
+    return true;
+}
+
+bool Executor::parallelFor(size_t n, size_t grain,
+                           const function<void(size_t, size_t)>& body,
+                           Priority prio, const CancellationToken& token)
+{
+    grain = max<size_t>(grain, 1);
+    if (n <= grain)
+    {
+        if (token.isCancelled())
+            return false;
+        if (n > 0)
+            body(0, n);
+        return true;
+    }
+
+    // Chunks are claimed from `next`, by pool tasks and by the calling
+    // thread alike. The caller helps only with its own chunks, never
+    // with other queued work: it may hold a lock (Bank's structureMutex,
+    // say) that another job's tasks would wait for on this very thread.
+    struct Latch
+    {
+        atomic<size_t> next{0};
+        atomic<size_t> remaining;
+        mutex m;
+        condition_variable done;
+        exception_ptr error;
+    };
+
+    size_t chunks = (n + grain - 1) / grain;
+    auto latch = make_shared<Latch>();
+    latch->remaining.store(chunks);
+
+    // Chunks count down even when cancelled, so the wait below always
+    // finishes; the token is checked here, not by submit().
+    auto runChunk = [latch, &body, token, n, grain, chunks] {
+        size_t c = latch->next.fetch_add(1, memory_order_relaxed);
+        if (c >= chunks)
+            return false;
+        size_t begin = c * grain;
+        size_t end = min(n, begin + grain);
+        if (!token.isCancelled())
+        {
+            try
+            {
+                body(begin, end);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(latch->m);
+                if (!latch->error)
+                    latch->error = current_exception();
+            }
+        }
+        if (latch->remaining.fetch_sub(1, memory_order_acq_rel) == 1)
+        {
+            lock_guard<mutex> lock(latch->m);
+            latch->done.notify_all();
+        }
+        return true;
+    };
+
+    // One task per chunk; a task that finds every chunk claimed (the
+    // caller ran it) does nothing.
+    for (size_t c = 0; c < chunks; ++c)
+        submit([runChunk] { runChunk(); }, prio);
+
+    // The caller never runs other work, but it steps aside for queued
+    // interactive tasks, which otherwise wait for the OS to preempt it
+    // when the workers share its core.
+    while (runChunk())
+    {
+        if (prio != Priority::Interactive && queued[0].load(memory_order_relaxed) > 0)
+            this_thread::yield();
+    }
+
+    unique_lock<mutex> lock(latch->m);
+    latch->done.wait(lock, [&] { return latch->remaining.load(memory_order_acquire) == 0; });
+
+    if (latch->error)
+        rethrow_exception(latch->error);
+    return !token.isCancelled();
+}
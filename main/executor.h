@@ -0,0 +1,134 @@
+/*
+    Work-stealing executor
+    --------------------------------
+    One shared thread pool for Bank's bulk jobs (load, audit, interest
+    accrual, checkpoint writing, ...). Each worker owns a deque per
+    priority: it pops its own work LIFO for cache locality and steals
+    FIFO from other workers when it runs dry.
+
+    Tasks run in three lanes. Workers always take interactive work
+    first, then standard, then bulk. With two or more threads the last
+    worker is reserved for interactive work, so a saturating bulk job
+    never delays a foreground request by more than one chunk. A thread
+    waiting in parallelFor helps only with chunks of its own call, so
+    it never runs a slice of someone else's job while holding locks
+    that job needs; between chunks it yields to queued interactive
+    work.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class Priority
+{
+    // Requests someone is waiting on.
+    Interactive,
+    // Work that gates requests, such as loading and saving.
+    Standard,
+    // Jobs over the whole bank (interest, audit, exports, batches),
+    // submitted in small slices so they only use capacity the other
+    // lanes leave idle.
+    Bulk
+};
+
+// Cooperative cancellation shared between a job's submitter and its
+// tasks. A default-constructed token can never be cancelled.
+class CancellationToken
+{
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+
+public:
+    static CancellationToken create()
+    {
+        CancellationToken t;
+        t.flag = std::make_shared<std::atomic<bool>>(false);
+        return t;
+    }
+
+    void cancel() const
+    {
+        if (flag)
+            flag->store(true, std::memory_order_relaxed);
+    }
+
+    bool isCancelled() const
+    {
+        return flag && flag->load(std::memory_order_relaxed);
+    }
+};
+
+class Executor
+{
+private:
+    struct Job
+    {
+        std::function<void()> fn;
+        CancellationToken token;
+    };
+
+    static constexpr size_t PRIORITY_COUNT = 3;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> queues[PRIORITY_COUNT];
+        std::thread thread;
+        bool interactiveOnly = false;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<size_t> queued[PRIORITY_COUNT] = {};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    bool popLocal(Worker& w, size_t prio, Job& out);
+    bool steal(size_t thief, size_t prio, Job& out);
+    // Looks in lanes from Interactive down to `lowest`.
+    bool findJob(size_t self, Priority lowest, Job& out);
+    void runWorker(size_t self);
+    int currentWorker() const;
+
+public:
+    explicit Executor(size_t threads = std::thread::hardware_concurrency());
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // Process-wide pool used by Bank.
+    static Executor& shared();
+
+    size_t threadCount() const { return workers.size(); }
+
+    // Queues fn. A task whose token is cancelled before it starts is
+    // dropped without running.
+    void submit(std::function<void()> fn, Priority prio = Priority::Standard,
+                CancellationToken token = {});
+
+    // Runs one queued task of priority `lowest` or more urgent on the
+    // calling thread, if any. Lets threads that are waiting on a job
+    // help instead of blocking.
+    bool runPending(Priority lowest = Priority::Bulk);
+
+    // Calls body(begin, end) over [0, n) in chunks of `grain` and waits
+    // for all of them; the calling thread runs chunks of this call, and
+    // nothing else, while it waits. Returns false if the
+    // token was cancelled, in which case some chunks may not have run.
+    // The first exception thrown by a chunk is rethrown here.
+    bool parallelFor(size_t n, size_t grain,
+                     const std::function<void(size_t, size_t)>& body,
+                     Priority prio = Priority::Standard,
+                     const CancellationToken& token = {});
+};
@@ -0,0 +1,309 @@
+#include "import.h"
+#include "executor.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Rough input bytes per parallel parse chunk.
+static const size_t PARSE_CHUNK_BYTES = 1 << 20;
+
+static bool validOwner(string_view owner)
+{
+    return !owner.empty() && owner.find_first_of(";\r\n") == string_view::npos;
+}
+
+static bool validBalance(double balance)
+{
+    return isfinite(balance) && balance >= 0.0;
+}
+
+static void reject(ImportChunk& chunk, size_t row)
+{
+    if (chunk.rejected++ == 0)
+        chunk.firstRejected = row;
+}
+
+static void accept(ImportChunk& chunk, size_t row, string_view owner,
+                   double balance, Currency currency)
+{
+    if (!validOwner(owner) || !validBalance(balance))
+    {
+        reject(chunk, row);
+        return;
+    }
+    chunk.rows.push_back({owner, balance, currency});
+}
+
+// ========================================
+// CSV
+// ========================================
+
+// Reads one field starting at `pos`, leaving `pos` after its trailing
+// comma (or at the end of the line). Quoted fields are unescaped into
+// chunk storage. Returns false on an unterminated quote.
+static bool csvField(string_view line, size_t& pos, string_view& field, ImportChunk& chunk)
+{
+    if (pos < line.size() && line[pos] == '"')
+    {
+        size_t start = ++pos;
+        string* unescaped = nullptr;
+        while (true)
+        {
+            size_t quote = line.find('"', pos);
+            if (quote == string_view::npos)
+                return false;
+            if (quote + 1 < line.size() && line[quote + 1] == '"')
+            {
+                if (!unescaped)
+                    unescaped = &chunk.owners.emplace_back();
+                unescaped->append(line.substr(pos, quote + 1 - pos));
+                pos = quote + 2;
+                continue;
+            }
+
+            if (unescaped)
+            {
+                unescaped->append(line.substr(pos, quote - pos));
+                field = *unescaped;
+            }
+            else
+            {
+                field = line.substr(start, quote - start);
+            }
+            pos = quote + 1;
+            break;
+        }
+        if (pos < line.size() && line[pos] != ',')
+            return false;
+    }
+    else
+    {
+        size_t comma = line.find(',', pos);
+        if (comma == string_view::npos)
+            comma = line.size();
+        field = line.substr(pos, comma - pos);
+        pos = comma;
+    }
+
+    if (pos < line.size())
+        ++pos;
+    return true;
+}
+
+static bool csvHeader(string_view line)
+{
+    return line.substr(0, 5) == "owner";
+}
+
+static void parseCsvLine(string_view line, size_t lineNo, ImportChunk& chunk)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    if (line.empty())
+        return;
+
+    size_t pos = 0;
+    string_view owner, amount, code;
+    if (!csvField(line, pos, owner, chunk) || !csvField(line, pos, amount, chunk))
+    {
+        reject(chunk, lineNo);
+        return;
+    }
+
+    Currency currency = Currency::USD;
+    if (pos < line.size())
+    {
+        if (!csvField(line, pos, code, chunk) || pos < line.size()
+            || !parseCurrency(string(code), currency))
+        {
+            reject(chunk, lineNo);
+            return;
+        }
+    }
+
+    double balance;
+    auto [end, ec] = from_chars(amount.data(), amount.data() + amount.size(), balance);
+    if (ec != errc() || end != amount.data() + amount.size())
+    {
+        reject(chunk, lineNo);
+        return;
+    }
+
+    accept(chunk, lineNo, owner, balance, currency);
+}
+
+static vector<ImportChunk> parseCsv(string_view data, Executor& executor)
+{
+    // Chunk boundaries are moved forward to the next line start, and
+    // each chunk's first line number is found by counting newlines.
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+        size_t firstLine;
+    };
+    vector<Range> ranges;
+
+    size_t begin = 0;
+    size_t line = 1;
+    while (begin < data.size())
+    {
+        size_t end = min(data.size(), begin + PARSE_CHUNK_BYTES);
+        if (end < data.size())
+        {
+            size_t eol = data.find('\n', end);
+            end = eol == string_view::npos ? data.size() : eol + 1;
+        }
+        ranges.push_back({begin, end, 0});
+        begin = end;
+    }
+
+    vector<size_t> newlines(ranges.size());
+    executor.parallelFor(ranges.size(), 1, [&](size_t b, size_t e) {
+        for (size_t r = b; r < e; ++r)
+        {
+            const char* p = data.data() + ranges[r].begin;
+            const char* last = data.data() + ranges[r].end;
+            size_t n = 0;
+            while ((p = static_cast<const char*>(memchr(p, '\n', last - p))))
+            {
+                ++n;
+                ++p;
+            }
+            newlines[r] = n;
+        }
+    }, Priority::Bulk);
+    for (size_t r = 0; r < ranges.size(); ++r)
+    {
+        ranges[r].firstLine = line;
+        line += newlines[r];
+    }
+
+    vector<ImportChunk> chunks(ranges.size());
+    executor.parallelFor(ranges.size(), 1, [&](size_t b, size_t e) {
+        for (size_t r = b; r < e; ++r)
+        {
+            ImportChunk& chunk = chunks[r];
+            size_t pos = ranges[r].begin;
+            size_t lineNo = ranges[r].firstLine;
+            while (pos < ranges[r].end)
+            {
+                size_t eol = data.find('\n', pos);
+                if (eol == string_view::npos || eol > ranges[r].end)
+                    eol = ranges[r].end;
+                string_view text = data.substr(pos, eol - pos);
+                if (!(lineNo == 1 && csvHeader(text)))
+                    parseCsvLine(text, lineNo, chunk);
+                pos = eol + 1;
+                ++lineNo;
+            }
+        }
+    }, Priority::Bulk);
+    return chunks;
+}
+
+// ========================================
+// Binary
+// ========================================
+
+static const size_t BINARY_FIXED = 1 + sizeof(double) + sizeof(uint16_t);
+
+static vector<ImportChunk> parseBinary(string_view data, Executor& executor)
+{
+    // Records are variable length, so offsets come from one serial pass
+    // over the length fields; decoding is parallel.
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+        size_t firstRecord;
+    };
+    vector<Range> ranges;
+
+    size_t pos = BINARY_IMPORT_MAGIC.size();
+    size_t record = 1;
+    size_t rangeStart = pos;
+    size_t rangeRecord = record;
+    bool truncated = false;
+    while (pos < data.size())
+    {
+        uint16_t len;
+        if (data.size() - pos < BINARY_FIXED)
+        {
+            truncated = true;
+            break;
+        }
+        memcpy(&len, data.data() + pos + 1 + sizeof(double), sizeof(len));
+        if (data.size() - pos - BINARY_FIXED < len)
+        {
+            truncated = true;
+            break;
+        }
+        pos += BINARY_FIXED + len;
+        ++record;
+
+        if (pos - rangeStart >= PARSE_CHUNK_BYTES)
+        {
+            ranges.push_back({rangeStart, pos, rangeRecord});
+            rangeStart = pos;
+            rangeRecord = record;
+        }
+    }
+    if (pos > rangeStart)
+        ranges.push_back({rangeStart, pos, rangeRecord});
+
+    vector<ImportChunk> chunks(ranges.size());
+    executor.parallelFor(ranges.size(), 1, [&](size_t b, size_t e) {
+        for (size_t r = b; r < e; ++r)
+        {
+            ImportChunk& chunk = chunks[r];
+            size_t p = ranges[r].begin;
+            size_t recNo = ranges[r].firstRecord;
+            for (; p < ranges[r].end; ++recNo)
+            {
+                uint8_t c = static_cast<uint8_t>(data[p]);
+                double balance;
+                uint16_t len;
+                memcpy(&balance, data.data() + p + 1, sizeof(balance));
+                memcpy(&len, data.data() + p + 1 + sizeof(double), sizeof(len));
+                string_view owner = data.substr(p + BINARY_FIXED, len);
+                p += BINARY_FIXED + len;
+
+                if (c >= CURRENCY_COUNT)
+                {
+                    reject(chunk, recNo);
+                    continue;
+                }
+                accept(chunk, recNo, owner, balance, static_cast<Currency>(c));
+            }
+        }
+    }, Priority::Bulk);
+
+    // A torn tail is one rejected record.
+    if (truncated)
+    {
+        if (chunks.empty())
+            chunks.emplace_back();
+        reject(chunks.back(), record);
+    }
+    return chunks;
+}
+
+vector<ImportChunk> parseImport(string_view data, Executor& executor)
+{
+    if (data.substr(0, BINARY_IMPORT_MAGIC.size()) == BINARY_IMPORT_MAGIC)
+        return parseBinary(data, executor);
+    return parseCsv(data, executor);
+}
+
+void appendBinaryImportRecord(string& out, string_view owner, double balance, Currency currency)
+{
+    uint16_t len = static_cast<uint16_t>(min<size_t>(owner.size(), UINT16_MAX));
+    out += static_cast<char>(currency);
+    out.append(reinterpret_cast<const char*>(&balance), sizeof(balance));
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(owner.substr(0, len));
+}
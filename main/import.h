@@ -0,0 +1,68 @@
+/*
+    Bulk account import
+    --------------------------------
+    Parsing and validation for onboarding files, the first stages of
+    Bank::importAccounts(). Two formats are accepted:
+
+    CSV, one account per line, with an optional header line:
+
+        owner,balance[,currency]
+        "Smith, Jane",1500.00,EUR
+        Acme Ltd,0
+
+    Owners containing commas or quotes are quoted, with "" for a literal
+    quote. The currency defaults to USD.
+
+    Binary, for machine-generated feeds:
+
+        "BNKIMP1\n"
+        per account: u8 currency, f64 balance, u16 owner length, owner bytes
+
+    (little-endian, no padding). The input is split into chunks that are
+    parsed in parallel; rows keep views into the input buffer where they
+    can, so the buffer must outlive the parsed chunks.
+*/
+
+#pragma once
+
+#include "currency.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Executor;
+
+constexpr std::string_view BINARY_IMPORT_MAGIC = "BNKIMP1\n";
+
+struct ImportRow
+{
+    std::string_view owner;
+    double balance;
+    Currency currency;
+};
+
+struct ImportChunk
+{
+    std::vector<ImportRow> rows;
+    // Backing storage for owners that had to be unescaped.
+    std::deque<std::string> owners;
+    size_t rejected = 0;
+    // 1-based line (CSV) or record (binary) number of the first
+    // rejected row, 0 if none.
+    size_t firstRejected = 0;
+};
+
+// Parses and validates `data` in parallel. Chunks come back in input
+// order. A row is rejected if it is malformed, its owner is empty or
+// contains ';' or a line break (the snapshot format cannot hold those),
+// or its balance is negative or not finite.
+std::vector<ImportChunk> parseImport(std::string_view data, Executor& executor);
+
+// Appends one binary import record to `out`. The file must start with
+// BINARY_IMPORT_MAGIC.
+void appendBinaryImportRecord(std::string& out, std::string_view owner,
+                              double balance, Currency currency);
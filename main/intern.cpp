@@ -0,0 +1,148 @@
+#include "intern.h"
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+// Heap bytes a std::string allocates for its characters, 0 when the
+// text fits in the small-string buffer.
+static size_t heapBytes(const string& s)
+{
+    return s.capacity() > string().capacity() ? s.capacity() + 1 : 0;
+}
+
+StringPool::StringPool() : chunks(new atomic<string*>[MAX_CHUNKS]), shards(new Shard[SHARDS])
+{
+    for (size_t i = 0; i < MAX_CHUNKS; ++i)
+        chunks[i].store(nullptr, memory_order_relaxed);
+    intern("");
+    lookups.store(0, memory_order_relaxed);
+}
+
+StringPool::~StringPool()
+{
+    for (size_t i = 0; i < MAX_CHUNKS; ++i)
+        delete[] chunks[i].load(memory_order_relaxed);
+}
+
+StringPool& StringPool::owners()
+{
+    static StringPool pool;
+    return pool;
+}
+
+size_t StringPool::shardOf(string_view s)
+{
+    // The maps bucket by the low bits of the same hash.
+    return hash<string_view>()(s) >> (numeric_limits<size_t>::digits - SHARD_BITS);
+}
+
+uint32_t StringPool::intern(string_view s)
+{
+    lookups.fetch_add(1, memory_order_relaxed);
+
+    Shard& shard = shards[shardOf(s)];
+    lock_guard<std::mutex> lock(shard.mutex);
+    return insertLocked(shard, s);
+}
+
+bool StringPool::internBatch(const string_view* in, size_t n, uint32_t* out)
+{
+    lookups.fetch_add(n, memory_order_relaxed);
+
+    // Group the batch by shard so each lock is taken once.
+    vector<size_t> start(SHARDS + 1, 0);
+    vector<uint8_t> shardIndex(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        shardIndex[i] = static_cast<uint8_t>(shardOf(in[i]));
+        ++start[shardIndex[i] + 1];
+    }
+    for (size_t k = 0; k < SHARDS; ++k)
+        start[k + 1] += start[k];
+    vector<size_t> order(n);
+    vector<size_t> next(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < n; ++i)
+        order[next[shardIndex[i]]++] = i;
+
+    bool ok = true;
+    for (size_t k = 0; k < SHARDS; ++k)
+    {
+        if (start[k] == start[k + 1])
+            continue;
+        lock_guard<std::mutex> lock(shards[k].mutex);
+        for (size_t j = start[k]; j < start[k + 1]; ++j)
+        {
+            size_t i = order[j];
+            out[i] = insertLocked(shards[k], in[i]);
+            ok = ok && out[i] != NONE;
+        }
+    }
+    return ok;
+}
+
+uint32_t StringPool::insertLocked(Shard& shard, string_view s)
+{
+    auto it = shard.ids.find(s);
+    if (it != shard.ids.end())
+        return it->second;
+
+    // Shards insert concurrently, so ids are claimed from the shared
+    // counter and a missing chunk is installed by whoever gets there
+    // first.
+    uint32_t id = count.load(memory_order_relaxed);
+    do
+    {
+        if ((id >> CHUNK_BITS) >= MAX_CHUNKS)
+            return NONE;
+    } while (!count.compare_exchange_weak(id, id + 1, memory_order_relaxed));
+
+    size_t c = id >> CHUNK_BITS;
+    string* chunk = chunks[c].load(memory_order_acquire);
+    if (!chunk)
+    {
+        string* fresh = new string[CHUNK_SIZE];
+        if (chunks[c].compare_exchange_strong(chunk, fresh, memory_order_acq_rel))
+        {
+            chunk = fresh;
+            bytes.fetch_add(CHUNK_SIZE * sizeof(string), memory_order_relaxed);
+        }
+        else
+        {
+            delete[] fresh;
+        }
+    }
+
+    string& slot = chunk[id & (CHUNK_SIZE - 1)];
+    slot.assign(s);
+    bytes.fetch_add(heapBytes(slot), memory_order_relaxed);
+
+    // The key views the pooled copy, which never moves.
+    shard.ids.emplace(string_view(slot), id);
+    return id;
+}
+
+uint32_t StringPool::find(string_view s) const
+{
+    const Shard& shard = shards[shardOf(s)];
+    lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.ids.find(s);
+    return it == shard.ids.end() ? NONE : it->second;
+}
+
+size_t StringPool::memoryBytes() const
+{
+    // Node per entry (key view, id, next pointer, cached hash) plus the
+    // bucket arrays.
+    size_t node = sizeof(void*) + sizeof(string_view) + sizeof(uint32_t) + sizeof(size_t);
+    size_t total = bytes.load(memory_order_relaxed) + MAX_CHUNKS * sizeof(atomic<string*>)
+                   + SHARDS * sizeof(Shard);
+    for (size_t k = 0; k < SHARDS; ++k)
+    {
+        lock_guard<std::mutex> lock(shards[k].mutex);
+        total += shards[k].ids.size() * node + shards[k].ids.bucket_count() * sizeof(void*);
+    }
+    return total;
+}
@@ -0,0 +1,95 @@
+/*
+    String interning
+    --------------------------------
+    A StringPool stores each distinct string once and hands out dense
+    32-bit ids for it. Accounts keep an owner id instead of their own
+    copy of the name, so customers sharing a name (or a business entity
+    string) share one allocation, and comparing owners is an integer
+    compare.
+
+    Interned strings are never freed and never move: get() returns a
+    reference that stays valid for the life of the process, and reading
+    an id that has been handed out needs no lock. The string-to-id map
+    is split into shards by hash, each with its own lock, so lookups
+    and inserts of different strings rarely meet.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class StringPool
+{
+private:
+    // Two-level table so storage never relocates: ids index a fixed
+    // array of chunk pointers, and chunks are allocated on demand.
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = 4096;
+
+    static constexpr size_t SHARD_BITS = 4;
+    static constexpr size_t SHARDS = size_t(1) << SHARD_BITS;
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string_view, uint32_t> ids;
+    };
+
+    std::unique_ptr<std::atomic<std::string*>[]> chunks;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint32_t> count{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<uint64_t> lookups{0};
+
+    static size_t shardOf(std::string_view s);
+    // Requires the shard's lock.
+    uint32_t insertLocked(Shard& shard, std::string_view s);
+
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    // Id 0 is always the empty string.
+    static constexpr uint32_t EMPTY = 0;
+
+    StringPool();
+    ~StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Pool shared by every Account for owner names.
+    static StringPool& owners();
+
+    // Id of s, adding it on first sight. NONE once the pool holds
+    // MAX_CHUNKS * CHUNK_SIZE strings and s is not among them.
+    uint32_t intern(std::string_view s);
+
+    // intern() for n strings, taking each shard's lock once; bulk
+    // loaders use it to avoid contending on the pool per row. False if
+    // any came back NONE.
+    bool internBatch(const std::string_view* in, size_t n, uint32_t* out);
+
+    // Id of s if it has been interned, NONE otherwise. Never inserts.
+    uint32_t find(std::string_view s) const;
+
+    const std::string& get(uint32_t id) const
+    {
+        return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+    }
+
+    // Distinct strings stored.
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+
+    // Calls to intern(), i.e. references handed out.
+    uint64_t references() const { return lookups.load(std::memory_order_relaxed); }
+
+    // Heap bytes held by the pool: string storage plus the id map.
+    size_t memoryBytes() const;
+};
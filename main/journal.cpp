@@ -0,0 +1,483 @@
+#include "journal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+// ========================================
+// Records
+// ========================================
+
+// Splits `record` on '|' into at most `n` fields, the last keeping any
+// remaining separators. Returns how many were found.
+static size_t splitFields(string_view record, string_view* fields, size_t n)
+{
+    size_t count = 0;
+    size_t start = 0;
+    while (count + 1 < n)
+    {
+        size_t bar = record.find('|', start);
+        if (bar == string_view::npos)
+            break;
+        fields[count++] = record.substr(start, bar - start);
+        start = bar + 1;
+    }
+    fields[count++] = record.substr(start);
+    return count;
+}
+
+// Numbers must take up the whole field.
+template <typename T>
+static bool parseField(string_view field, T& out)
+{
+    auto r = from_chars(field.data(), field.data() + field.size(), out);
+    return r.ec == errc() && r.ptr == field.data() + field.size();
+}
+
+bool parseJournalRecord(string_view record, JournalRecord& out)
+{
+    if (record.size() < 2 || record[1] != '|')
+        return false;
+
+    out = JournalRecord();
+    string_view f[6];
+    switch (record[0])
+    {
+    case 'C':
+        if (splitFields(record, f, 4) != 4 || !parseField(f[1], out.account)
+            || !parseCurrency(f[2], out.currency))
+            return false;
+        out.kind = RecordKind::AccountCreated;
+        out.owner = f[3];
+        return true;
+    case 'X':
+        if (splitFields(record, f, 5) != 5 || !parseField(f[1], out.account)
+            || !parseField(f[4], out.amount))
+            return false;
+        out.kind = RecordKind::Transaction;
+        out.timestamp = f[2];
+        out.type = f[3];
+        return true;
+    case 'T':
+        if (splitFields(record, f, 6) != 6 || !parseField(f[1], out.account)
+            || !parseField(f[2], out.target) || !parseField(f[4], out.amount)
+            || !parseField(f[5], out.amountIn))
+            return false;
+        out.kind = RecordKind::Transfer;
+        out.timestamp = f[3];
+        return true;
+    case 'R':
+        if (splitFields(record, f, 3) != 3 || !parseCurrency(f[1], out.currency)
+            || !parseField(f[2], out.amount))
+            return false;
+        out.kind = RecordKind::RateChanged;
+        return true;
+    }
+    return false;
+}
+
+bool splitJournalLine(string_view line, uint64_t& seq, string_view& record)
+{
+    size_t bar = line.find('|');
+    if (bar == string_view::npos || bar == 0 || !parseField(line.substr(0, bar), seq))
+        return false;
+    record = line.substr(bar + 1);
+    return true;
+}
+
+// ========================================
+// Journal
+// ========================================
+
+// Writes all of `data`; false on error.
+static bool writeAll(int fd, const string& data)
+{
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0)
+    {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0)
+            return false;
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Length of the file up to and including its last newline, so a line
+// torn by a crash is cut off before new records are appended after it.
+static off_t completeLength(int fd)
+{
+    off_t end = lseek(fd, 0, SEEK_END);
+    char block[4096];
+    while (end > 0)
+    {
+        off_t start = max<off_t>(0, end - static_cast<off_t>(sizeof(block)));
+        ssize_t n = pread(fd, block, static_cast<size_t>(end - start), start);
+        if (n != end - start)
+            return -1;
+        for (ssize_t i = n; i > 0; --i)
+        {
+            if (block[i - 1] == '\n')
+                return start + i;
+        }
+        end = start;
+    }
+    return 0;
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const string& p)
+{
+    close();
+    path = p;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        return false;
+
+    syncedLength = completeLength(fd);
+    if (syncedLength < 0 || ftruncate(fd, syncedLength) != 0)
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void Journal::close()
+{
+    if (fd < 0)
+        return;
+
+    flush();
+    ::close(fd);
+    fd = -1;
+
+    if (mirrorFd >= 0)
+    {
+        ::close(mirrorFd);
+        mirrorFd = -1;
+    }
+}
+
+bool Journal::openMirror(const string& mirrorPath, const string& backlog)
+{
+    lock_guard<mutex> fileLock(fileMutex);
+    int m = ::open(mirrorPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m < 0)
+        return false;
+    if (!writeAll(m, backlog) || fdatasync(m) != 0)
+    {
+        ::close(m);
+        return false;
+    }
+
+    if (mirrorFd >= 0)
+        ::close(mirrorFd);
+    mirrorFd = m;
+    return true;
+}
+
+uint64_t Journal::append(const string& record)
+{
+    if (fd < 0)
+        return 0;
+
+    lock_guard<mutex> lock(bufferMutex);
+    uint64_t seq = nextSeq++;
+    buffer += to_string(seq);
+    buffer += '|';
+    buffer += record;
+    buffer += '\n';
+    return seq;
+}
+
+uint64_t Journal::appendBatch(const vector<string>& chunks)
+{
+    if (fd < 0)
+        return 0;
+
+    size_t bytes = 0;
+    size_t records = 0;
+    for (const auto& chunk : chunks)
+    {
+        bytes += chunk.size();
+        records += static_cast<size_t>(count(chunk.begin(), chunk.end(), '\n'));
+    }
+
+    lock_guard<mutex> lock(bufferMutex);
+    // Sequence numbers add at most 21 bytes ("<seq>|") per record.
+    buffer.reserve(buffer.size() + bytes + records * 21);
+
+    char seqBuf[24];
+    for (const auto& chunk : chunks)
+    {
+        size_t pos = 0;
+        while (pos < chunk.size())
+        {
+            size_t eol = chunk.find('\n', pos);
+            if (eol == string::npos)
+                break;
+            auto [end, ec] = to_chars(seqBuf, seqBuf + sizeof(seqBuf), nextSeq++);
+            buffer.append(seqBuf, end);
+            buffer += '|';
+            buffer.append(chunk, pos, eol + 1 - pos);
+            pos = eol + 1;
+        }
+    }
+    return nextSeq - 1;
+}
+
+uint64_t Journal::flush()
+{
+    if (fd < 0)
+        return durableSeq();
+
+    // fileMutex keeps concurrent flushes from reordering their writes;
+    // appends only contend on bufferMutex for the swap.
+    lock_guard<mutex> fileLock(fileMutex);
+    return flushLocked();
+}
+
+uint64_t Journal::flushLocked()
+{
+    string pending;
+    uint64_t upTo;
+    {
+        lock_guard<mutex> lock(bufferMutex);
+        pending.swap(buffer);
+        upTo = nextSeq - 1;
+    }
+
+    uint64_t done = durableSeq();
+    if (upTo == done)
+        return upTo;
+
+    // A batch that is not both written and synced is cut back off the
+    // file, torn line and all, and goes back to the front of the buffer
+    // for the next flush; the durable mark never passes it.
+    if (!writeAll(fd, pending) || fdatasync(fd) != 0)
+    {
+        ftruncate(fd, syncedLength);
+        lock_guard<mutex> lock(bufferMutex);
+        buffer.insert(0, pending);
+        return done;
+    }
+    syncedLength += static_cast<off_t>(pending.size());
+
+    // Consumers only ever see records that are already durable, and the
+    // durable mark waits for the feed: records it missed are kept and
+    // retried by the next flush.
+    if (mirrorFd >= 0)
+    {
+        mirrorPending += pending;
+        if (!writeMirrorLocked())
+            return done;
+    }
+
+    durable.store(upTo, memory_order_release);
+    return upTo;
+}
+
+bool Journal::writeMirrorLocked()
+{
+    while (!mirrorPending.empty())
+    {
+        ssize_t n = ::write(mirrorFd, mirrorPending.data(), mirrorPending.size());
+        if (n < 0)
+            return false;
+        mirrorPending.erase(0, static_cast<size_t>(n));
+    }
+    return fdatasync(mirrorFd) == 0;
+}
+
+bool Journal::rotate(const string& archivePath)
+{
+    if (fd < 0)
+        return false;
+
+    lock_guard<mutex> fileLock(fileMutex);
+    flushLocked();
+
+    if (rename(path.c_str(), archivePath.c_str()) != 0)
+        return false;
+
+    int next = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (next < 0)
+    {
+        rename(archivePath.c_str(), path.c_str());
+        return false;
+    }
+
+    ::close(fd);
+    fd = next;
+    syncedLength = 0;
+    return true;
+}
+
+uint64_t Journal::lastSeq()
+{
+    lock_guard<mutex> lock(bufferMutex);
+    return nextSeq - 1;
+}
+
+void Journal::setLastSeq(uint64_t seq)
+{
+    lock_guard<mutex> lock(bufferMutex);
+    nextSeq = seq + 1;
+    durable.store(seq, memory_order_release);
+}
+
+void Journal::truncate()
+{
+    if (fd < 0)
+        return;
+
+    lock_guard<mutex> fileLock(fileMutex);
+    // The change feed must have every record before the file goes;
+    // if it cannot take them, they stay.
+    if (mirrorFd >= 0 && flushLocked() != lastSeq())
+        return;
+    lock_guard<mutex> lock(bufferMutex);
+    buffer.clear();
+    if (ftruncate(fd, 0) == 0)
+        fdatasync(fd);
+    syncedLength = 0;
+    durable.store(nextSeq - 1, memory_order_release);
+}
+
+void Journal::replay(const string& path,
+                     const function<void(uint64_t, const string&)>& fn)
+{
+    ifstream file(path);
+    if (!file.is_open())
+        return;
+
+    string line;
+    while (getline(file, line))
+    {
+        // getline also returns a final line with no newline, which is a
+        // record torn by a crash mid-write.
+        if (file.eof())
+            break;
+
+        uint64_t seq;
+        string_view record;
+        if (splitJournalLine(line, seq, record))
+            fn(seq, string(record));
+    }
+}
+
+// ========================================
+// JournalBuffers
+// ========================================
+
+// A ticket is the buffer index + 1 in the high half and the batch
+// number in the low half.
+static uint64_t makeTicket(size_t buffer, uint32_t batch)
+{
+    return (static_cast<uint64_t>(buffer + 1) << 32) | batch;
+}
+
+JournalBuffers::JournalBuffers(Journal& journal, size_t batch, size_t n)
+    : journal(journal), batchSize(max<size_t>(1, batch)),
+      count(n ? n : max<size_t>(1, thread::hardware_concurrency())),
+      buffers(new Buffer[count])
+{
+}
+
+size_t JournalBuffers::localIndex() const
+{
+    // Threads are numbered once, in order of first use, as for
+    // SplitBalance::local().
+    static atomic<size_t> nextThread{0};
+    static thread_local size_t threadIndex = nextThread.fetch_add(1, memory_order_relaxed);
+    return threadIndex % count;
+}
+
+void JournalBuffers::publishLocked(Buffer& b)
+{
+    if (b.count == 0)
+        return;
+
+    vector<string> chunks(1);
+    chunks[0].swap(b.records);
+    journal.appendBatch(chunks);
+    b.records.swap(chunks[0]);
+    b.records.clear();
+
+    auto window = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - b.opened).count());
+    batchCount.fetch_add(1, memory_order_relaxed);
+    recordCount.fetch_add(b.count, memory_order_relaxed);
+    windowNsTotal.fetch_add(window, memory_order_relaxed);
+    uint64_t longest = maxWindow.load(memory_order_relaxed);
+    while (window > longest && !maxWindow.compare_exchange_weak(longest, window, memory_order_relaxed))
+    {
+    }
+    b.count = 0;
+    ++b.batch;
+}
+
+uint64_t JournalBuffers::add(string_view record)
+{
+    size_t i = localIndex();
+    Buffer& b = buffers[i];
+    lock_guard<mutex> lock(b.mutex);
+    if (b.count == 0)
+        b.opened = chrono::steady_clock::now();
+    b.records += record;
+    b.records += '\n';
+    uint64_t ticket = makeTicket(i, b.batch);
+    if (++b.count >= batchSize)
+        publishLocked(b);
+    return ticket;
+}
+
+void JournalBuffers::publishBefore(uint64_t ticket)
+{
+    size_t i = static_cast<size_t>(ticket >> 32);
+    if (i == 0 || i - 1 >= count || i - 1 == localIndex())
+        return;
+
+    Buffer& b = buffers[i - 1];
+    lock_guard<mutex> lock(b.mutex);
+    if (b.batch == static_cast<uint32_t>(ticket) && b.count > 0)
+    {
+        publishLocked(b);
+        handoffCount.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void JournalBuffers::publishAll()
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        lock_guard<mutex> lock(buffers[i].mutex);
+        publishLocked(buffers[i]);
+    }
+}
+
+JournalBufferStats JournalBuffers::stats() const
+{
+    JournalBufferStats s;
+    s.batches = batchCount.load(memory_order_relaxed);
+    s.records = recordCount.load(memory_order_relaxed);
+    s.handoffs = handoffCount.load(memory_order_relaxed);
+    s.windowNs = windowNsTotal.load(memory_order_relaxed);
+    s.maxWindowNs = maxWindow.load(memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,238 @@
+/*
+    Append-only operation journal
+    --------------------------------
+    Every mutation the Bank makes is appended here as one text record
+    with a sequence number:
+
+        <seq>|<record>\n
+
+    parseJournalRecord() is the one reader of the record grammar, shared
+    by recovery and the change feed.
+
+    Appends only go to an in-memory buffer. flush() writes the buffer
+    and syncs it to disk, so many appends share one fdatasync (group
+    commit). Flushed records can be mirrored to a change feed file for
+    downstream consumers (changefeed.h). Bank::save() stores the last
+    sequence number it included in the snapshot, so replaying the
+    journal after a crash only applies newer records. A background
+    checkpoint rotates the journal instead of truncating it.
+
+    JournalBuffers sits in front of a Journal for many writer threads:
+    each thread stages records in a buffer of its own, and a full
+    buffer goes to the journal as one batch.
+*/
+
+#pragma once
+
+#include "currency.h"
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ========================================
+// Records
+// ========================================
+
+enum class RecordKind : char
+{
+    AccountCreated = 'C',  // C|<id>|<currency>|<owner>
+    Transaction = 'X',     // X|<id>|<timestamp>|<type>|<amount>
+    Transfer = 'T',        // T|<from>|<to>|<timestamp>|<amount out>|<amount in>
+    RateChanged = 'R'      // R|<currency>|<usd value>
+};
+
+// One record, without its sequence number. Fields a kind does not
+// have are left at their defaults.
+struct JournalRecord
+{
+    RecordKind kind = RecordKind::Transaction;
+    // The account, or a transfer's source.
+    int account = 0;
+    int target = 0;
+    // AccountCreated: the account's currency; RateChanged: the currency
+    // whose USD value changed.
+    Currency currency = Currency::USD;
+    // Owner names may contain '|': the last field keeps the rest.
+    std::string owner;
+    std::string timestamp;
+    std::string type;
+    // Transaction: the amount; Transfer: the amount debited;
+    // RateChanged: the new USD value.
+    double amount = 0.0;
+    // Transfer: the amount credited, in the target's currency.
+    double amountIn = 0.0;
+};
+
+// False if `record` is malformed.
+bool parseJournalRecord(std::string_view record, JournalRecord& out);
+
+// Splits "<seq>|<record>" (no newline); false if there is no valid seq.
+bool splitJournalLine(std::string_view line, uint64_t& seq, std::string_view& record);
+
+// ========================================
+// Journal
+// ========================================
+
+class Journal
+{
+private:
+    std::mutex bufferMutex;
+    std::mutex fileMutex;
+    std::string buffer;
+    uint64_t nextSeq = 1;
+    std::atomic<uint64_t> durable{0};
+    int fd = -1;
+    // Bytes of the file that are written and synced; guarded by fileMutex.
+    off_t syncedLength = 0;
+    int mirrorFd = -1;
+    // Records in the journal file that the mirror has not taken yet.
+    // Guarded by fileMutex.
+    std::string mirrorPending;
+    std::string path;
+
+    // Requires fileMutex.
+    uint64_t flushLocked();
+    // Writes and syncs mirrorPending; requires fileMutex.
+    bool writeMirrorLocked();
+
+public:
+    Journal() = default;
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Cuts off a final line torn by a crash before appending.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // Buffers one record and returns its sequence number, or 0 when the
+    // journal is closed.
+    uint64_t append(const std::string& record);
+
+    // Buffers every newline-terminated record in `chunks`, in order,
+    // under one lock so the batch gets consecutive sequence numbers.
+    // Returns the last one, or 0 when the journal is closed.
+    uint64_t appendBatch(const std::vector<std::string>& chunks);
+
+    // Writes and syncs everything appended so far, to the mirror too if
+    // there is one. Returns the highest durable sequence number; records
+    // a failed flush could not store stay buffered for the next one.
+    uint64_t flush();
+
+    uint64_t lastSeq();
+    uint64_t durableSeq() const { return durable.load(std::memory_order_acquire); }
+
+    // Sequence numbers continue after `seq`; used after replay.
+    void setLastSeq(uint64_t seq);
+
+    // After every durable flush, also appends the flushed records to
+    // `mirrorPath` (the change feed), which truncate() never touches.
+    // `backlog` is written first, for records the mirror missed.
+    bool openMirror(const std::string& mirrorPath, const std::string& backlog);
+    bool isMirrored() const { return mirrorFd >= 0; }
+
+    // Flushes, then renames the journal file to `archivePath` and
+    // continues in a fresh file, so records up to now can be dropped
+    // separately once a background snapshot covers them.
+    bool rotate(const std::string& archivePath);
+
+    // Drops all records; called once a snapshot covers them. With a
+    // mirror, flushes first and does nothing if the mirror cannot take
+    // every record.
+    void truncate();
+
+    // Calls fn(seq, record) for every complete record in the file at
+    // `path`. A torn final line is ignored.
+    static void replay(const std::string& path,
+                       const std::function<void(uint64_t, const std::string&)>& fn);
+};
+
+// ========================================
+// JournalBuffers
+// ========================================
+
+struct JournalBufferStats
+{
+    uint64_t batches = 0;
+    uint64_t records = 0;
+    // Batches published early so another thread's record could follow
+    // them (see publishBefore()).
+    uint64_t handoffs = 0;
+    // How long a batch's first record waited to reach the journal.
+    uint64_t windowNs = 0;
+    uint64_t maxWindowNs = 0;
+
+    double recordsPerBatch() const { return batches ? double(records) / batches : 0.0; }
+    double meanWindowUs() const { return batches ? windowNs / 1e3 / batches : 0.0; }
+};
+
+// Per-thread staging buffers for a Journal. add() takes only the
+// calling thread's buffer lock, and a buffer holding `batch` records
+// goes to Journal::appendBatch() in one piece, so writers meet on the
+// journal's lock once per batch rather than once per record.
+//
+// Records of one buffer stay in order. A record that must follow one
+// in another buffer (the same account's previous change) asks for that
+// buffer to be published first with publishBefore(), using the ticket
+// add() returned for it.
+//
+// Staged records are not in the journal yet: publishAll() must come
+// before reading Journal::lastSeq() or flushing.
+class JournalBuffers
+{
+private:
+    struct alignas(64) Buffer
+    {
+        std::mutex mutex;
+        std::string records;
+        size_t count = 0;
+        // Numbers the batch being filled; tickets carry it.
+        uint32_t batch = 1;
+        std::chrono::steady_clock::time_point opened;
+    };
+
+    Journal& journal;
+    const size_t batchSize;
+    const size_t count;
+    std::unique_ptr<Buffer[]> buffers;
+
+    std::atomic<uint64_t> batchCount{0};
+    std::atomic<uint64_t> recordCount{0};
+    std::atomic<uint64_t> handoffCount{0};
+    std::atomic<uint64_t> windowNsTotal{0};
+    std::atomic<uint64_t> maxWindow{0};
+
+    size_t localIndex() const;
+    // Requires the buffer's lock.
+    void publishLocked(Buffer& b);
+
+public:
+    // One buffer per hardware thread unless told otherwise.
+    explicit JournalBuffers(Journal& journal, size_t batch = 64, size_t buffers = 0);
+
+    JournalBuffers(const JournalBuffers&) = delete;
+    JournalBuffers& operator=(const JournalBuffers&) = delete;
+
+    // Stages `record` (no newline) in the calling thread's buffer.
+    // Returns a ticket for publishBefore(); never 0.
+    uint64_t add(std::string_view record);
+    // Makes the records staged under `ticket` reach the journal before
+    // anything the calling thread adds next. Free when they are in the
+    // caller's own buffer or already published; 0 is ignored.
+    void publishBefore(uint64_t ticket);
+    void publishAll();
+
+    JournalBufferStats stats() const;
+};
@@ -0,0 +1,768 @@
+#include "lsm.h"
+
+#include "storage.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <unordered_set>
+
+using namespace std;
+
+static const char RUN_MAGIC[8] = {'B', 'A', 'N', 'K', 'L', 'S', 'M', '1'};
+
+// A new index block starts once the current one holds this many bytes.
+static const size_t BLOCK_BYTES = 4096;
+static const size_t WRITE_BUFFER = 1 << 20;
+
+// An entry: u64 key, f64 amount, u8 timestamp length, u8 type length,
+// then the two strings.
+static const size_t ENTRY_HEADER = 18;
+
+// Last in the file; before it, in order: the entries, indexCount
+// (first key, offset) pairs, the filter, and replacedCount run numbers.
+struct RunFooter
+{
+    uint64_t level;
+    uint64_t entries;
+    // Distinct accounts, which sized the filter.
+    uint64_t ids;
+    uint64_t dataBytes;
+    uint64_t indexCount;
+    uint64_t filterBytes;
+    uint64_t replacedCount;
+    uint64_t minKey;
+    uint64_t maxKey;
+    char magic[8];
+};
+
+static uint64_t readU64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static size_t entrySize(const char* p)
+{
+    return ENTRY_HEADER + static_cast<unsigned char>(p[16]) + static_cast<unsigned char>(p[17]);
+}
+
+static void encodeEntry(string& out, uint64_t key, const Transaction& t)
+{
+    size_t tsLen = min<size_t>(t.timestamp.size(), 255);
+    size_t typeLen = min<size_t>(t.type.size(), 255);
+    out.append(reinterpret_cast<const char*>(&key), 8);
+    out.append(reinterpret_cast<const char*>(&t.amount), 8);
+    out += static_cast<char>(tsLen);
+    out += static_cast<char>(typeLen);
+    out.append(t.timestamp.data(), tsLen);
+    out.append(t.type.data(), typeLen);
+}
+
+static Transaction decodeEntry(const char* p)
+{
+    size_t tsLen = static_cast<unsigned char>(p[16]);
+    size_t typeLen = static_cast<unsigned char>(p[17]);
+    Transaction t;
+    memcpy(&t.amount, p + 8, 8);
+    t.timestamp.assign(p + ENTRY_HEADER, tsLen);
+    t.type.assign(p + ENTRY_HEADER + tsLen, typeLen);
+    return t;
+}
+
+static int accountOf(uint64_t key)
+{
+    return static_cast<int>(static_cast<uint32_t>(key >> 32));
+}
+
+static bool syncDirectory(const string& dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// ========================================
+// Runs
+// ========================================
+
+struct HistoryRun
+{
+    uint64_t number = 0;
+    uint64_t level = 0;
+    string path;
+    const char* base = nullptr;
+    size_t length = 0;
+
+    uint64_t entries = 0;
+    uint64_t ids = 0;
+    uint64_t dataBytes = 0;
+    // indexCount pairs of u64, unaligned.
+    const char* index = nullptr;
+    uint64_t indexCount = 0;
+    uint64_t minKey = 0;
+    uint64_t maxKey = 0;
+    unique_ptr<BlockedBloomFilter> filter;
+    vector<uint64_t> replaced;
+
+    // Set once a compaction replaced the run: the last reader to let go
+    // of it deletes the file.
+    atomic<bool> obsolete{false};
+
+    HistoryRun() = default;
+    HistoryRun(const HistoryRun&) = delete;
+    HistoryRun& operator=(const HistoryRun&) = delete;
+
+    ~HistoryRun()
+    {
+        if (base)
+            munmap(const_cast<char*>(base), length);
+        if (obsolete.load())
+            remove(path.c_str());
+    }
+
+    bool load(const string& file, uint64_t runNumber)
+    {
+        number = runNumber;
+        path = file;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RunFooter))
+        {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        base = static_cast<const char*>(mapped);
+
+        RunFooter footer;
+        memcpy(&footer, base + length - sizeof(footer), sizeof(footer));
+        if (memcmp(footer.magic, RUN_MAGIC, sizeof(RUN_MAGIC)) != 0
+            || footer.dataBytes + footer.indexCount * 16 + footer.filterBytes + footer.replacedCount * 8
+                   != length - sizeof(footer))
+            return false;
+        level = footer.level;
+        entries = footer.entries;
+        ids = footer.ids;
+        dataBytes = footer.dataBytes;
+        index = base + dataBytes;
+        indexCount = footer.indexCount;
+        minKey = footer.minKey;
+        maxKey = footer.maxKey;
+        const char* filterBits = index + indexCount * 16;
+        filter = make_unique<BlockedBloomFilter>(string_view(filterBits, footer.filterBytes));
+        const char* numbers = filterBits + footer.filterBytes;
+        for (uint64_t i = 0; i < footer.replacedCount; ++i)
+            replaced.push_back(readU64(numbers + i * 8));
+        return true;
+    }
+
+    // Offset of the block that holds `key` if any block does.
+    uint64_t blockFor(uint64_t key) const
+    {
+        uint64_t lo = 0;
+        uint64_t hi = indexCount;
+        // The last block whose first key is <= key (or block 0).
+        while (hi - lo > 1)
+        {
+            uint64_t mid = (lo + hi) / 2;
+            if (readU64(index + mid * 16) <= key)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return readU64(index + lo * 16 + 8);
+    }
+
+    bool mayHold(int id) const
+    {
+        return historyKey(id, UINT32_MAX) >= minKey && historyKey(id, 0) <= maxKey
+               && filter->mayContain(static_cast<uint64_t>(static_cast<uint32_t>(id)));
+    }
+
+    // The largest key in [from, to]; false if there is none.
+    bool last(uint64_t from, uint64_t to, uint64_t& key) const
+    {
+        bool found = false;
+        // The block for `to` starts at or below it, so holds the answer.
+        for (uint64_t at = blockFor(to); at < dataBytes; at += entrySize(base + at))
+        {
+            uint64_t k = readU64(base + at);
+            if (k > to)
+                break;
+            if (k >= from)
+            {
+                key = k;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Calls fn(key, entry) for each key in [from, to], in order.
+    template <typename Fn>
+    void scan(uint64_t from, uint64_t to, Fn&& fn) const
+    {
+        for (uint64_t at = blockFor(from); at < dataBytes; at += entrySize(base + at))
+        {
+            uint64_t key = readU64(base + at);
+            if (key > to)
+                break;
+            if (key >= from)
+                fn(key, base + at);
+        }
+    }
+};
+
+// Writes one run: to <path>.tmp, synced, then renamed into place.
+class RunWriter
+{
+private:
+    string path;
+    string tmpPath;
+    int fd = -1;
+    bool ok = true;
+    string buffer;
+    uint64_t dataBytes = 0;
+    uint64_t blockStart = 0;
+    uint64_t entries = 0;
+    uint64_t minKey = UINT64_MAX;
+    uint64_t maxKey = 0;
+    vector<uint64_t> index;
+    BlockedBloomFilter filter;
+    uint64_t ids;
+
+    void write(const char* data, size_t n)
+    {
+        buffer.append(data, n);
+        if (buffer.size() >= WRITE_BUFFER)
+            drain();
+    }
+
+    void drain()
+    {
+        size_t done = 0;
+        while (ok && done < buffer.size())
+        {
+            ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+            if (n < 0)
+                ok = errno == EINTR;
+            else
+                done += static_cast<size_t>(n);
+        }
+        buffer.clear();
+    }
+
+public:
+    // `ids`: how many distinct accounts at most, to size the filter.
+    RunWriter(const string& path, uint64_t ids, double bitsPerKey)
+        : path(path), tmpPath(path + ".tmp"), filter(static_cast<size_t>(ids), bitsPerKey), ids(ids)
+    {
+        fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ok = fd >= 0;
+        buffer.reserve(WRITE_BUFFER + BLOCK_BYTES);
+    }
+
+    ~RunWriter()
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+            remove(tmpPath.c_str());
+        }
+    }
+
+    RunWriter(const RunWriter&) = delete;
+    RunWriter& operator=(const RunWriter&) = delete;
+
+    // Keys must come in ascending order. `entry` is an encoded entry.
+    void add(uint64_t key, const char* entry, size_t size)
+    {
+        if (entries == 0 || dataBytes - blockStart >= BLOCK_BYTES)
+        {
+            blockStart = dataBytes;
+            index.push_back(key);
+            index.push_back(dataBytes);
+        }
+        if (entries == 0 || accountOf(key) != accountOf(maxKey))
+            filter.insert(key >> 32);
+        minKey = min(minKey, key);
+        maxKey = key;
+        ++entries;
+        write(entry, size);
+        dataBytes += size;
+    }
+
+    // Writes the index, filter and footer and puts the file in place.
+    bool finish(uint64_t level, const vector<uint64_t>& replaced, const string& dir)
+    {
+        write(reinterpret_cast<const char*>(index.data()), index.size() * 8);
+        string bits;
+        filter.save(bits);
+        write(bits.data(), bits.size());
+        write(reinterpret_cast<const char*>(replaced.data()), replaced.size() * 8);
+        RunFooter footer{level, entries, ids, dataBytes, index.size() / 2, bits.size(),
+                         replaced.size(), minKey, maxKey, {}};
+        memcpy(footer.magic, RUN_MAGIC, sizeof(RUN_MAGIC));
+        write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        drain();
+        ok = ok && fdatasync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+        if (ok && rename(tmpPath.c_str(), path.c_str()) == 0 && syncDirectory(dir))
+            return true;
+        remove(tmpPath.c_str());
+        return false;
+    }
+};
+
+// ========================================
+// Open and close
+// ========================================
+
+HistoryStore::~HistoryStore()
+{
+    close();
+}
+
+string HistoryStore::runPath(uint64_t number) const
+{
+    return dir + "/run-" + to_string(number) + ".lsm";
+}
+
+bool HistoryStore::open(const string& d, const HistoryStoreOptions& opts)
+{
+    close();
+    if (mkdir(d.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+    DIR* listing = opendir(d.c_str());
+    if (!listing)
+        return false;
+    dir = d;
+    options = opts;
+    options.runsPerTier = max<size_t>(2, options.runsPerTier);
+
+    vector<pair<uint64_t, string>> files;
+    while (dirent* e = readdir(listing))
+    {
+        string_view name = e->d_name;
+        if (name.substr(0, 4) != "run-")
+            continue;
+        // Left by a run write that never finished.
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".tmp")
+        {
+            remove((dir + "/" + string(name)).c_str());
+            continue;
+        }
+        uint64_t number = 0;
+        auto [end, ec] = from_chars(name.data() + 4, name.data() + name.size(), number);
+        if (ec == errc() && string_view(end, static_cast<size_t>(name.data() + name.size() - end)) == ".lsm")
+            files.emplace_back(number, dir + "/" + string(name));
+    }
+    closedir(listing);
+    sort(files.begin(), files.end());
+
+    vector<shared_ptr<HistoryRun>> loaded;
+    unordered_set<uint64_t> replaced;
+    for (const auto& [number, file] : files)
+    {
+        auto run = make_shared<HistoryRun>();
+        if (!run->load(file, number))
+            return false;
+        replaced.insert(run->replaced.begin(), run->replaced.end());
+        loaded.push_back(move(run));
+        nextRun = number + 1;
+    }
+    runs.clear();
+    for (auto& run : loaded)
+    {
+        // A compaction finished but crashed before deleting its inputs.
+        if (replaced.count(run->number))
+            run->obsolete = true;
+        else
+            runs.push_back(move(run));
+    }
+
+    for (AppendShard& shard : appendShards)
+        shard.nextSeq.clear();
+    active = make_shared<Memtable>();
+    frozen.clear();
+    frozenCount = 0;
+    stopping = false;
+    failed = false;
+    idle = false;
+    worker = thread(&HistoryStore::runWorker, this);
+    return true;
+}
+
+void HistoryStore::close()
+{
+    if (!active)
+        return;
+    flush();
+    {
+        lock_guard<mutex> work(workMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    workDone.notify_all();
+    if (worker.joinable())
+        worker.join();
+    unique_lock<shared_mutex> state(stateMutex);
+    active.reset();
+    frozen.clear();
+    runs.clear();
+}
+
+// ========================================
+// Appends and reads
+// ========================================
+
+uint32_t HistoryStore::nextSeqInRuns(int id) const
+{
+    uint64_t from = historyKey(id, 0);
+    uint64_t to = historyKey(id, UINT32_MAX);
+    uint32_t next = 0;
+    for (const auto& run : runs)
+    {
+        if (!run->mayHold(id))
+            continue;
+        uint64_t last;
+        if (run->last(from, to, last))
+            next = max(next, static_cast<uint32_t>(last) + 1);
+    }
+    return next;
+}
+
+uint32_t HistoryStore::append(int id, const Transaction& t)
+{
+    size_t s = static_cast<uint32_t>(id) % SHARDS;
+    size_t slot = static_cast<uint32_t>(id) / SHARDS;
+    uint32_t seq;
+    bool full;
+    {
+        shared_lock<shared_mutex> state(stateMutex);
+        if (!active)
+            return UINT32_MAX;
+        AppendShard& shard = appendShards[s];
+        lock_guard<mutex> lock(shard.mutex);
+        if (slot >= shard.nextSeq.size())
+            shard.nextSeq.resize(max(slot + 1, shard.nextSeq.size() * 2));
+        // Entries of `id` made since open() carry on from this, so only
+        // the runs can hold earlier ones.
+        uint32_t& next = shard.nextSeq[slot];
+        if (next == 0)
+            next = nextSeqInRuns(id) + 1;
+        seq = next - 1;
+        ++next;
+        MemtableShard& table = active->shards[s];
+        size_t before = table.entries.size();
+        table.offsets.push_back(before);
+        encodeEntry(table.entries, historyKey(id, seq), t);
+        size_t added = table.entries.size() - before + sizeof(size_t);
+        full = active->bytes.fetch_add(added) + added >= options.memtableBytes;
+    }
+    appendCount.fetch_add(1, memory_order_relaxed);
+    if (full)
+        freezeActive(false);
+    return seq;
+}
+
+void HistoryStore::collect(const Memtable& m, uint64_t from, uint64_t to, vector<Entry>& out)
+{
+    const MemtableShard& shard = m.shards[accountOf(from) % SHARDS];
+    for (size_t offset : shard.offsets)
+    {
+        const char* entry = shard.entries.data() + offset;
+        uint64_t key = readU64(entry);
+        if (key >= from && key <= to)
+            out.push_back({static_cast<uint32_t>(key), decodeEntry(entry)});
+    }
+}
+
+size_t HistoryStore::read(int id, vector<Transaction>& out, uint32_t from, uint32_t to) const
+{
+    if (from > to)
+        return 0;
+    uint64_t lo = historyKey(id, from);
+    uint64_t hi = historyKey(id, to);
+    vector<shared_ptr<HistoryRun>> searched;
+    vector<shared_ptr<Memtable>> tables;
+    vector<Entry> found;
+    {
+        // Runs and memtables never change once made, so copies of the
+        // lists can be read without the lock, except the active shard.
+        shared_lock<shared_mutex> state(stateMutex);
+        if (!active)
+            return 0;
+        for (const auto& run : runs)
+        {
+            if (run->mayHold(id))
+                searched.push_back(run);
+            else
+                skippedCount.fetch_add(1, memory_order_relaxed);
+        }
+        tables = frozen;
+        lock_guard<mutex> lock(appendShards[static_cast<uint32_t>(id) % SHARDS].mutex);
+        collect(*active, lo, hi, found);
+    }
+    searchedCount.fetch_add(searched.size(), memory_order_relaxed);
+
+    for (const auto& run : searched)
+    {
+        run->scan(lo, hi, [&](uint64_t key, const char* entry) {
+            found.push_back({static_cast<uint32_t>(key), decodeEntry(entry)});
+        });
+    }
+    for (const auto& table : tables)
+        collect(*table, lo, hi, found);
+
+    sort(found.begin(), found.end(), [](const Entry& a, const Entry& b) { return a.seq < b.seq; });
+    for (Entry& e : found)
+        out.push_back(move(e.t));
+    return found.size();
+}
+
+// ========================================
+// Flushes
+// ========================================
+
+void HistoryStore::wakeWorker()
+{
+    {
+        lock_guard<mutex> work(workMutex);
+        idle = false;
+    }
+    workReady.notify_one();
+}
+
+void HistoryStore::freezeActive(bool force)
+{
+    if (!force && frozenCount.load() >= MAX_FROZEN)
+    {
+        auto start = chrono::steady_clock::now();
+        unique_lock<mutex> work(workMutex);
+        workDone.wait(work, [&] { return frozenCount.load() < MAX_FROZEN || failed || stopping; });
+        stallCount.fetch_add(1, memory_order_relaxed);
+        stallNsTotal.fetch_add(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - start).count()),
+                               memory_order_relaxed);
+    }
+    {
+        unique_lock<shared_mutex> state(stateMutex);
+        size_t bytes = active->bytes.load();
+        // Another append may have frozen it already.
+        if (bytes == 0 || (!force && bytes < options.memtableBytes))
+            return;
+        frozen.push_back(move(active));
+        active = make_shared<Memtable>();
+        ++frozenCount;
+    }
+    wakeWorker();
+}
+
+bool HistoryStore::flush()
+{
+    if (!active)
+        return false;
+    freezeActive(true);
+    unique_lock<mutex> work(workMutex);
+    workDone.wait(work, [&] { return frozenCount.load() == 0 || failed; });
+    return !failed;
+}
+
+void HistoryStore::waitIdle()
+{
+    unique_lock<mutex> work(workMutex);
+    workDone.wait(work, [&] { return (idle && frozenCount.load() == 0) || failed || stopping; });
+}
+
+shared_ptr<HistoryRun> HistoryStore::writeMemtable(const Memtable& m, uint64_t number)
+{
+    vector<pair<uint64_t, const char*>> entries;
+    size_t ids = 0;
+    for (const MemtableShard& shard : m.shards)
+    {
+        for (size_t offset : shard.offsets)
+        {
+            const char* entry = shard.entries.data() + offset;
+            entries.emplace_back(readU64(entry), entry);
+        }
+    }
+    sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (i == 0 || accountOf(entries[i].first) != accountOf(entries[i - 1].first))
+            ++ids;
+    }
+
+    RunWriter out(runPath(number), ids, options.bloomBitsPerKey);
+    for (const auto& [key, entry] : entries)
+        out.add(key, entry, entrySize(entry));
+    auto run = make_shared<HistoryRun>();
+    if (!out.finish(0, {}, dir) || !run->load(runPath(number), number))
+        return nullptr;
+    return run;
+}
+
+// ========================================
+// Compaction
+// ========================================
+
+vector<shared_ptr<HistoryRun>> HistoryStore::pickCompaction() const
+{
+    // runs is in number order, so oldest first within each tier.
+    vector<shared_ptr<HistoryRun>> best;
+    for (const auto& run : runs)
+    {
+        if (!best.empty() && run->level >= best.front()->level)
+            continue;
+        vector<shared_ptr<HistoryRun>> tier;
+        for (const auto& other : runs)
+        {
+            if (other->level == run->level && tier.size() < options.runsPerTier)
+                tier.push_back(other);
+        }
+        if (tier.size() == options.runsPerTier)
+            best = move(tier);
+    }
+    return best;
+}
+
+shared_ptr<HistoryRun> HistoryStore::merge(const vector<shared_ptr<HistoryRun>>& inputs, uint64_t number)
+{
+    uint64_t ids = 0;
+    uint64_t level = 0;
+    vector<uint64_t> replaced;
+    for (const auto& run : inputs)
+    {
+        ids += run->ids;
+        level = max(level, run->level + 1);
+        replaced.push_back(run->number);
+    }
+
+    // Inputs never share a key, so each step takes the smallest head.
+    using Head = pair<uint64_t, size_t>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    vector<uint64_t> offsets(inputs.size(), 0);
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        if (inputs[i]->dataBytes > 0)
+            heads.emplace(readU64(inputs[i]->base), i);
+    }
+
+    RunWriter out(runPath(number), ids, options.bloomBitsPerKey);
+    while (!heads.empty())
+    {
+        auto [key, i] = heads.top();
+        heads.pop();
+        const HistoryRun& run = *inputs[i];
+        const char* entry = run.base + offsets[i];
+        size_t size = entrySize(entry);
+        out.add(key, entry, size);
+        offsets[i] += size;
+        if (offsets[i] < run.dataBytes)
+            heads.emplace(readU64(run.base + offsets[i]), i);
+    }
+    auto run = make_shared<HistoryRun>();
+    if (!out.finish(level, replaced, dir) || !run->load(runPath(number), number))
+        return nullptr;
+    return run;
+}
+
+void HistoryStore::runWorker()
+{
+    unique_lock<mutex> work(workMutex);
+    for (;;)
+    {
+        shared_ptr<Memtable> table;
+        vector<shared_ptr<HistoryRun>> inputs;
+        {
+            shared_lock<shared_mutex> state(stateMutex);
+            if (!frozen.empty())
+                table = frozen.front();
+            else if (!stopping)
+                inputs = pickCompaction();
+        }
+        if (failed || (!table && inputs.empty()))
+        {
+            if (stopping)
+                break;
+            idle = true;
+            workDone.notify_all();
+            workReady.wait(work, [&] { return !idle || stopping; });
+            continue;
+        }
+        work.unlock();
+
+        uint64_t number = nextRun++;
+        shared_ptr<HistoryRun> made = table ? writeMemtable(*table, number) : merge(inputs, number);
+        if (made)
+        {
+            unique_lock<shared_mutex> state(stateMutex);
+            if (table)
+            {
+                frozen.erase(frozen.begin());
+                --frozenCount;
+            }
+            for (const auto& input : inputs)
+            {
+                input->obsolete = true;
+                runs.erase(find(runs.begin(), runs.end(), input));
+            }
+            runs.push_back(made);
+        }
+        if (made && table)
+        {
+            flushCount.fetch_add(1, memory_order_relaxed);
+            flushedByteCount.fetch_add(made->length, memory_order_relaxed);
+        }
+        else if (made)
+        {
+            compactionCount.fetch_add(1, memory_order_relaxed);
+            compactedByteCount.fetch_add(made->length, memory_order_relaxed);
+        }
+
+        work.lock();
+        failed = failed || !made;
+        workDone.notify_all();
+    }
+    workDone.notify_all();
+}
+
+HistoryStoreStats HistoryStore::stats() const
+{
+    HistoryStoreStats s;
+    s.appends = appendCount.load(memory_order_relaxed);
+    s.flushes = flushCount.load(memory_order_relaxed);
+    s.compactions = compactionCount.load(memory_order_relaxed);
+    s.flushedBytes = flushedByteCount.load(memory_order_relaxed);
+    s.compactedBytes = compactedByteCount.load(memory_order_relaxed);
+    s.stalls = stallCount.load(memory_order_relaxed);
+    s.stallNs = stallNsTotal.load(memory_order_relaxed);
+    s.runsSearched = searchedCount.load(memory_order_relaxed);
+    s.runsSkipped = skippedCount.load(memory_order_relaxed);
+    shared_lock<shared_mutex> state(stateMutex);
+    s.runs = runs.size();
+    return s;
+}
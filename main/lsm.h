@@ -0,0 +1,201 @@
+/*
+    LSM history store
+    --------------------------------
+    Transaction histories in a log-structured merge tree, for
+    append-heavy loads. Appends go to an in-memory memtable. Once it is
+    full it is frozen and a background thread writes it out as a
+    sorted, immutable run file. Keys are historyKey(id, seq)
+    (storage.h), so one account's transactions are adjacent and in
+    order in every run.
+
+    Runs are merged size-tiered: when runsPerTier runs of about the
+    same size exist, the background thread merges them into one run of
+    the next tier. Histories are append-only and keys never repeat, so
+    merging is a plain k-way merge, with nothing to overwrite or
+    delete. Appends only wait, counted as stalls, if the background
+    thread falls two memtables behind.
+
+    Each run keeps a sparse index of its blocks and a Bloom filter
+    (bloom.h) over the account ids it holds. A history read therefore
+    skips runs that never saw the account, and seeks straight to the
+    account's first block in the others.
+
+    Files, in the store's directory:
+        run-<n>.lsm     one run: entries in key order, block index,
+                        Bloom filter, and the numbers of the runs it
+                        replaced, so open() can drop inputs that a
+                        compaction interrupted by a crash left behind
+
+    Appends are durable only once their memtable is written; flush()
+    forces that. A Bank keeps every transaction in its journal anyway.
+
+    Thread safety: append and read may be called from any number of
+    threads.
+*/
+
+#pragma once
+
+#include "account.h"
+#include "bloom.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct HistoryStoreOptions
+{
+    // Memory a memtable may use before it is frozen (approximate).
+    size_t memtableBytes = 16 << 20;
+    size_t runsPerTier = 4;
+    double bloomBitsPerKey = 10.0;
+};
+
+struct HistoryStoreStats
+{
+    uint64_t appends = 0;
+    uint64_t flushes = 0;
+    uint64_t compactions = 0;
+    size_t runs = 0;
+    // Bytes written by flushes and by compactions; their sum over the
+    // flushed bytes is the write amplification.
+    uint64_t flushedBytes = 0;
+    uint64_t compactedBytes = 0;
+    // Appends that waited for a memtable to be written, and for how long.
+    uint64_t stalls = 0;
+    uint64_t stallNs = 0;
+    // Runs a read searched, and runs its Bloom filter let it skip.
+    uint64_t runsSearched = 0;
+    uint64_t runsSkipped = 0;
+
+    double writeAmplification() const
+    {
+        return flushedBytes ? double(flushedBytes + compactedBytes) / double(flushedBytes) : 0.0;
+    }
+};
+
+struct HistoryRun;
+
+class HistoryStore
+{
+private:
+    static constexpr size_t SHARDS = 16;
+    // Frozen memtables not yet written before appends wait.
+    static constexpr size_t MAX_FROZEN = 2;
+
+    struct Entry
+    {
+        uint32_t seq;
+        Transaction t;
+    };
+
+    // Appends in arrival order, encoded as in a run file; sorted by key
+    // only when written out. A shard holds the accounts id % SHARDS.
+    struct MemtableShard
+    {
+        std::string entries;
+        std::vector<size_t> offsets;
+    };
+
+    struct Memtable
+    {
+        std::array<MemtableShard, SHARDS> shards;
+        std::atomic<size_t> bytes{0};
+    };
+
+    // Guards one shard of the active memtable, and the next sequence
+    // number of the accounts in it (index id / SHARDS; 0 = not yet
+    // known, else next + 1).
+    struct AppendShard
+    {
+        mutable std::mutex mutex;
+        std::vector<uint32_t> nextSeq;
+    };
+
+    std::string dir;
+    HistoryStoreOptions options;
+    std::array<AppendShard, SHARDS> appendShards;
+
+    // Guards the three lists below; appends and reads hold it shared.
+    mutable std::shared_mutex stateMutex;
+    std::shared_ptr<Memtable> active;
+    // Oldest first.
+    std::vector<std::shared_ptr<Memtable>> frozen;
+    std::vector<std::shared_ptr<HistoryRun>> runs;
+    // Used by the background thread only.
+    uint64_t nextRun = 1;
+
+    // Frozen memtables, for appends to wait on without stateMutex.
+    std::atomic<size_t> frozenCount{0};
+
+    std::mutex workMutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    bool stopping = false;
+    bool idle = true;
+    // A run could not be written; nothing more is written.
+    bool failed = false;
+    std::thread worker;
+
+    std::atomic<uint64_t> appendCount{0};
+    std::atomic<uint64_t> flushCount{0};
+    std::atomic<uint64_t> compactionCount{0};
+    std::atomic<uint64_t> flushedByteCount{0};
+    std::atomic<uint64_t> compactedByteCount{0};
+    std::atomic<uint64_t> stallCount{0};
+    std::atomic<uint64_t> stallNsTotal{0};
+    mutable std::atomic<uint64_t> searchedCount{0};
+    mutable std::atomic<uint64_t> skippedCount{0};
+
+    // Appends the entries of `m` with keys in [from, to], which must
+    // belong to one account, to `out`.
+    static void collect(const Memtable& m, uint64_t from, uint64_t to, std::vector<Entry>& out);
+    // The first unused sequence number of `id` in the runs. Requires
+    // stateMutex, shared or exclusive.
+    uint32_t nextSeqInRuns(int id) const;
+    void freezeActive(bool force);
+    void wakeWorker();
+    void runWorker();
+    // The oldest runsPerTier runs of the lowest tier that has that many.
+    std::vector<std::shared_ptr<HistoryRun>> pickCompaction() const;
+    std::shared_ptr<HistoryRun> writeMemtable(const Memtable& m, uint64_t number);
+    std::shared_ptr<HistoryRun> merge(const std::vector<std::shared_ptr<HistoryRun>>& inputs,
+                                      uint64_t number);
+    std::string runPath(uint64_t number) const;
+
+public:
+    HistoryStore() = default;
+    ~HistoryStore();
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    // Opens the store in directory `dir`, creating it if needed.
+    bool open(const std::string& dir, const HistoryStoreOptions& options = {});
+    // Writes out the memtable and stops the background thread.
+    void close();
+    bool isOpen() const { return active != nullptr; }
+
+    // Appends `t` to account `id`'s history; returns its sequence
+    // number, counting from 0 per account; UINT32_MAX if the store is
+    // not open.
+    uint32_t append(int id, const Transaction& t);
+    // Appends transactions with sequence numbers in [from, to] to
+    // `out`, in order; returns how many.
+    size_t read(int id, std::vector<Transaction>& out, uint32_t from = 0,
+                uint32_t to = UINT32_MAX) const;
+
+    // Writes out everything appended so far.
+    bool flush();
+    // Waits until no flush or compaction is pending.
+    void waitIdle();
+
+    HistoryStoreStats stats() const;
+};
@@ -1,215 +1,109 @@
 /*
-    Console Banking System (C++17)
+    Console Banking System (C++20)
     --------------------------------
     Features:
     - Create accounts
+    - Bulk account import (CSV or binary)
+    - Columnar export for analytics
+    - Month-end statements
     - Deposit / Withdraw
     - Transfer between accounts
     - Transaction history
+    - Multi-currency accounts with FX conversion
     - Persistent storage (file-based)
+    - Change feed for downstream consumers (bank_data.txt.cdc)
+
+    This file is the interactive front end only; the banking logic is
+    in the core library (bank.h).
 */
 
+#include "bank.h"
+
 #include <iostream>
-#include <vector>
-#include <string>
-#include <fstream>
-#include <sstream>
 #include <iomanip>
 #include <algorithm>
-#include <ctime>
+#include <cctype>
 
 using namespace std;
 
 // ========================================
-// Utility
-// ========================================
-
-string currentTime()
-{
-    time_t now = time(nullptr);
-    tm* ltm = localtime(&now);
-
-    stringstream ss;
-    ss << 1900 + ltm->tm_year << "-"
-       << setw(2) << setfill('0') << 1 + ltm->tm_mon << "-"
-       << setw(2) << setfill('0') << ltm->tm_mday << " "
-       << setw(2) << setfill('0') << ltm->tm_hour << ":"
-       << setw(2) << setfill('0') << ltm->tm_min << ":"
-       << setw(2) << setfill('0') << ltm->tm_sec;
-
-    return ss.str();
-}
-
-// ========================================
-// Transaction
-// ========================================
-
-struct Transaction
-{
-    string timestamp;
-    string type;
-    double amount;
-
-    string serialize() const
-    {
-        stringstream ss;
-        ss << timestamp << "|" << type << "|" << amount;
-        return ss.str();
-    }
-
-    static Transaction deserialize(const string& line)
-    {
-        stringstream ss(line);
-        string token;
-
-        Transaction t;
-        getline(ss, t.timestamp, '|');
-        getline(ss, t.type, '|');
-        getline(ss, token, '|');
-        t.amount = stod(token);
-
-        return t;
-    }
-};
-
-// ========================================
-// Account
+// Console
 // ========================================
 
-class Account
+class Console
 {
 private:
-    int id;
-    string owner;
-    double balance;
-    vector<Transaction> history;
-
-public:
-    Account() : id(0), balance(0.0) {}
+    Bank& bank;
+    // Damaged records already reported, and whether the background
+    // history load had finished when they were counted.
+    size_t reportedErrors = 0;
+    bool historyChecked = false;
 
-    Account(int id, const string& owner)
-        : id(id), owner(owner), balance(0.0) {}
-
-    int getId() const { return id; }
-    string getOwner() const { return owner; }
-    double getBalance() const { return balance; }
-
-    void deposit(double amount)
+    static bool readCurrency(const string& prompt, Currency& out)
     {
-        balance += amount;
-        history.push_back({currentTime(), "DEPOSIT", amount});
-    }
+        string code;
+        cout << prompt;
+        cin >> code;
+        transform(code.begin(), code.end(), code.begin(), ::toupper);
 
-    bool withdraw(double amount)
-    {
-        if (amount > balance)
+        if (!parseCurrency(code, out))
+        {
+            cout << "Unknown currency.\n";
             return false;
-
-        balance -= amount;
-        history.push_back({currentTime(), "WITHDRAW", amount});
+        }
         return true;
     }
 
-    void transferOut(double amount)
+    // Successful mutations are made durable before they are confirmed.
+    void report(Result r, const char* success)
     {
-        balance -= amount;
-        history.push_back({currentTime(), "TRANSFER_OUT", amount});
+        if (r == Result::Ok)
+            bank.syncJournal();
+        cout << (r == Result::Ok ? success : resultMessage(r)) << "\n";
     }
 
-    void transferIn(double amount)
+    static void printSummary(const Account& acc)
     {
-        balance += amount;
-        history.push_back({currentTime(), "TRANSFER_IN", amount});
+        cout << "ID: " << acc.getId()
+             << " | Owner: " << acc.getOwner()
+             << " | Balance: " << fixed << setprecision(2)
+             << acc.getBalance() << " " << currencyCode(acc.getCurrency()) << endl;
     }
 
-    void printSummary() const
-    {
-        cout << "ID: " << id
-             << " | Owner: " << owner
-             << " | Balance: $" << fixed << setprecision(2)
-             << balance << endl;
-    }
-
-    void printHistory() const
+    static void printHistory(const vector<Transaction>& history, Currency currency)
     {
         cout << "\n--- Transaction History ---\n";
         for (const auto& t : history)
         {
             cout << t.timestamp << " | "
                  << setw(15) << left << t.type
-                 << " | $" << fixed << setprecision(2)
-                 << t.amount << endl;
+                 << " | " << fixed << setprecision(2)
+                 << t.amount << " " << currencyCode(currency) << endl;
         }
     }
 
-    string serialize() const
-    {
-        stringstream ss;
-        ss << id << ";" << owner << ";" << balance << endl;
-
-        for (const auto& t : history)
-        {
-            ss << "T:" << t.serialize() << endl;
-        }
-
-        ss << "END" << endl;
-        return ss.str();
-    }
+public:
+    explicit Console(Bank& bank) : bank(bank) {}
 
-    static Account deserialize(ifstream& file, const string& header)
+    // Histories load in the background after startup and can turn up
+    // damaged records of their own, so this runs before every menu
+    // until the load is done.
+    void reportLoadErrors()
     {
-        stringstream ss(header);
-        string token;
-
-        getline(ss, token, ';');
-        int id = stoi(token);
-
-        string owner;
-        getline(ss, owner, ';');
-
-        getline(ss, token, ';');
-        double balance = stod(token);
-
-        Account acc(id, owner);
-        acc.balance = balance;
+        if (historyChecked)
+            return;
 
-        string line;
-        while (getline(file, line))
+        // Read before the errors, so none found before it finished are missed.
+        bool complete = bank.isHistoryLoaded();
+        size_t damaged = bank.loadErrors().size();
+        if (damaged > reportedErrors)
         {
-            if (line == "END")
-                break;
-
-            if (line.rfind("T:", 0) == 0)
-            {
-                string data = line.substr(2);
-                acc.history.push_back(Transaction::deserialize(data));
-            }
+            cout << "Warning: " << damaged - reportedErrors
+                 << " damaged record(s) in bank_data.txt were skipped; "
+                 << "see bank_data.txt.quarantine.\n";
         }
-
-        return acc;
-    }
-};
-
-// ========================================
-// Bank System
-// ========================================
-
-class Bank
-{
-private:
-    vector<Account> accounts;
-    int nextId = 1;
-    const string filename = "bank_data.txt";
-
-public:
-    Bank()
-    {
-        load();
-    }
-
-    ~Bank()
-    {
-        save();
+        reportedErrors = damaged;
+        historyChecked = complete;
     }
 
     void createAccount()
@@ -219,18 +113,17 @@ public:
         cout << "Owner name: ";
         getline(cin, name);
 
-        accounts.emplace_back(nextId++, name);
-        cout << "Account created successfully.\n";
-    }
+        Currency currency;
+        if (!readCurrency("Currency (USD, EUR, GBP, JPY, CHF, CAD): ", currency))
+            return;
 
-    Account* findAccount(int id)
-    {
-        for (auto& acc : accounts)
+        if (bank.createAccount(name, currency) == 0)
         {
-            if (acc.getId() == id)
-                return &acc;
+            cout << "Account could not be created.\n";
+            return;
         }
-        return nullptr;
+        bank.syncJournal();
+        cout << "Account created successfully.\n";
     }
 
     void deposit()
@@ -243,15 +136,7 @@ public:
         cout << "Amount: ";
         cin >> amount;
 
-        Account* acc = findAccount(id);
-        if (!acc)
-        {
-            cout << "Account not found.\n";
-            return;
-        }
-
-        acc->deposit(amount);
-        cout << "Deposit successful.\n";
+        report(bank.deposit(id, amount), "Deposit successful.");
     }
 
     void withdraw()
@@ -264,21 +149,7 @@ public:
         cout << "Amount: ";
         cin >> amount;
 
-        Account* acc = findAccount(id);
-        if (!acc)
-        {
-            cout << "Account not found.\n";
-            return;
-        }
-
-        if (!acc->withdraw(amount))
-        {
-            cout << "Insufficient funds.\n";
-        }
-        else
-        {
-            cout << "Withdrawal successful.\n";
-        }
+        report(bank.withdraw(id, amount), "Withdrawal successful.");
     }
 
     void transfer()
@@ -293,33 +164,100 @@ public:
         cout << "Amount: ";
         cin >> amount;
 
-        Account* accFrom = findAccount(from);
-        Account* accTo = findAccount(to);
+        report(bank.transfer(from, to, amount), "Transfer completed.");
+    }
+
+    void importAccounts()
+    {
+        string path;
+        cout << "Import file (CSV or binary): ";
+        cin >> path;
 
-        if (!accFrom || !accTo)
+        ImportReport report = bank.importAccounts(path);
+        if (!report.readable)
         {
-            cout << "Invalid account ID.\n";
+            cout << "Cannot read file.\n";
             return;
         }
+        if (report.imported > 0)
+            bank.syncJournal();
+
+        cout << "Imported " << report.imported << " account(s)";
+        if (report.imported > 0)
+            cout << " (IDs " << report.firstId << "-"
+                 << report.firstId + static_cast<int>(report.imported) - 1 << ")";
+        cout << ".\n";
+        if (report.rejected > 0)
+        {
+            cout << "Rejected " << report.rejected << " row(s); first at line/record "
+                 << report.firstRejected << ".\n";
+        }
+    }
+
+    void exportColumnar()
+    {
+        string prefix;
+        cout << "Export path prefix: ";
+        cin >> prefix;
 
-        if (accFrom->getBalance() < amount)
+        ExportReport report = bank.exportColumnar(prefix);
+        if (!report.ok)
         {
-            cout << "Insufficient funds.\n";
+            cout << "Export failed.\n";
             return;
         }
+        cout << "Exported " << report.accounts << " account(s) and "
+             << report.transactions << " transaction(s) in "
+             << report.rowGroups << " row group(s) to "
+             << prefix << ".accounts.col / " << prefix << ".transactions.col.\n";
+    }
 
-        accFrom->transferOut(amount);
-        accTo->transferIn(amount);
+    void statements()
+    {
+        string month;
+        cout << "Month (YYYY-MM): ";
+        cin >> month;
 
-        cout << "Transfer completed.\n";
+        StatementPeriod period;
+        if (!monthPeriod(month, period))
+        {
+            cout << "Invalid month.\n";
+            return;
+        }
+
+        string prefix = "statements-" + month;
+        StatementReport report = bank.generateStatements(period, prefix);
+        if (!report.ok)
+        {
+            cout << "Statement generation failed.\n";
+            return;
+        }
+        cout << "Wrote " << report.statements << " statement(s) with "
+             << report.transactions << " transaction(s) to " << prefix << ".*.stmt ("
+             << report.shards << " file(s), " << fixed << setprecision(0)
+             << report.statementsPerSecond() << " statements/s).\n";
+    }
+
+    void checkpoint()
+    {
+        CheckpointReport report = bank.checkpointInBackground();
+        if (!report.started)
+        {
+            cout << (bank.checkpointInProgress() ? "A checkpoint is already running.\n"
+                                                 : "Checkpoint could not be started.\n");
+            return;
+        }
+        cout << "Checkpoint at journal record " << report.snapshotSeq
+             << " started in the background (paused " << fixed << setprecision(2)
+             << report.pauseMs << " ms).\n";
     }
 
     void listAccounts() const
     {
         cout << "\n--- Accounts ---\n";
-        for (const auto& acc : accounts)
+        for (const auto& acc : bank.getAccounts())
         {
-            acc.printSummary();
+            printSummary(acc);
         }
     }
 
@@ -329,46 +267,95 @@ public:
         cout << "Account ID: ";
         cin >> id;
 
-        Account* acc = findAccount(id);
-        if (!acc)
+        vector<Transaction> history;
+        Result r = bank.history(id, history);
+        if (r != Result::Ok)
         {
-            cout << "Account not found.\n";
+            cout << resultMessage(r) << "\n";
             return;
         }
 
-        acc->printHistory();
+        printHistory(history, bank.findAccount(id)->getCurrency());
     }
 
-    void save()
+    void setExchangeRate()
     {
-        ofstream file(filename);
+        Currency c;
+        if (!readCurrency("Currency: ", c))
+            return;
 
-        for (const auto& acc : accounts)
+        if (c == Currency::USD)
         {
-            file << acc.serialize();
+            cout << "USD is the quote currency.\n";
+            return;
         }
 
-        file.close();
+        double value;
+        cout << "Value of 1 " << currencyCode(c) << " in USD: ";
+        cin >> value;
+
+        report(bank.setExchangeRate(c, value), "Rate updated.");
     }
 
-    void load()
+    void revalueBalances()
     {
-        ifstream file(filename);
-        if (!file.is_open())
+        Currency reporting;
+        if (!readCurrency("Reporting currency: ", reporting))
             return;
 
-        string line;
-        while (getline(file, line))
+        vector<double> converted;
+        bank.revalueBalances(reporting, converted);
+
+        const auto& accounts = bank.getAccounts();
+        const RateTable& rates = bank.getRates();
+
+        cout << "\n--- Balances in " << currencyCode(reporting) << " ---\n";
+        double total = 0.0;
+        for (size_t i = 0; i < accounts.size(); ++i)
         {
-            if (line.empty())
+            Currency c = accounts[i].getCurrency();
+            cout << "ID: " << accounts[i].getId() << " | ";
+            if (!rates.canConvert(c, reporting))
+            {
+                cout << "no rate for " << currencyCode(c) << endl;
                 continue;
+            }
+            cout << fixed << setprecision(2) << converted[i]
+                 << " " << currencyCode(reporting) << endl;
+            total += converted[i];
+        }
+        cout << "Total: " << fixed << setprecision(2) << total
+             << " " << currencyCode(reporting) << endl;
+    }
 
-            Account acc = Account::deserialize(file, line);
-            accounts.push_back(acc);
-            nextId = max(nextId, acc.getId() + 1);
+    void accrueInterest()
+    {
+        double percent;
+        cout << "Interest rate (%): ";
+        cin >> percent;
+
+        size_t credited = bank.accrueInterest(percent / 100.0);
+        if (credited > 0)
+            bank.syncJournal();
+        cout << "Interest credited to " << credited << " account(s).\n";
+    }
+
+    void audit()
+    {
+        vector<AuditFinding> findings = bank.audit();
+        if (findings.empty())
+        {
+            cout << "Audit passed: all balances match their history.\n";
+            return;
         }
 
-        file.close();
+        cout << "\n--- Audit Findings ---\n";
+        for (const auto& f : findings)
+        {
+            cout << "ID: " << f.id
+                 << " | Balance: " << fixed << setprecision(2) << f.balance
+                 << " | History: " << f.replayed << endl;
+        }
     }
 
     void menu()
@@ -380,6 +367,14 @@ public:
         cout << "4. Transfer\n";
         cout << "5. List Accounts\n";
         cout << "6. Show History\n";
+        cout << "7. Set Exchange Rate\n";
+        cout << "8. Revalue Balances\n";
+        cout << "9. Accrue Interest\n";
+        cout << "10. Audit Balances\n";
+        cout << "11. Import Accounts\n";
+        cout << "12. Export for Analytics\n";
+        cout << "13. Background Checkpoint\n";
+        cout << "14. Month-End Statements\n";
         cout << "0. Exit\n";
         cout << "Select: ";
     }
@@ -390,8 +385,13 @@ public:
 
         while (true)
         {
+            reportLoadErrors();
             menu();
-            cin >> choice;
+            if (!(cin >> choice))
+            {
+                bank.save();
+                return;
+            }
 
             switch (choice)
             {
@@ -401,8 +401,16 @@ public:
             case 4: transfer(); break;
             case 5: listAccounts(); break;
             case 6: showHistory(); break;
+            case 7: setExchangeRate(); break;
+            case 8: revalueBalances(); break;
+            case 9: accrueInterest(); break;
+            case 10: audit(); break;
+            case 11: importAccounts(); break;
+            case 12: exportColumnar(); break;
+            case 13: checkpoint(); break;
+            case 14: statements(); break;
             case 0:
-                save();
+                bank.save();
                 cout << "Goodbye.\n";
                 return;
             default:
@@ -419,6 +427,8 @@ public:
 int main()
 {
     Bank bank;
-    bank.run();
+    bank.enableChangeFeed();
+    Console console(bank);
+    console.run();
     return 0;
 }
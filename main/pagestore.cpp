@@ -0,0 +1,414 @@
+#include "pagestore.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+
+// ========================================
+// PageFile
+// ========================================
+
+PageFile::~PageFile()
+{
+    close();
+}
+
+bool PageFile::open(const string& path)
+{
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close();
+        return false;
+    }
+    pages.store((static_cast<uint64_t>(st.st_size) + PAGE_SIZE - 1) / PAGE_SIZE, memory_order_release);
+    return true;
+}
+
+void PageFile::close()
+{
+    if (fd < 0)
+        return;
+    ::close(fd);
+    fd = -1;
+    pages.store(0, memory_order_release);
+}
+
+bool PageFile::read(uint64_t page, char* out) const
+{
+    size_t done = 0;
+    off_t offset = static_cast<off_t>(page * PAGE_SIZE);
+    while (done < PAGE_SIZE)
+    {
+        ssize_t n = pread(fd, out + done, PAGE_SIZE - done, offset + static_cast<off_t>(done));
+        if (n < 0)
+            return false;
+        if (n == 0)
+        {
+            memset(out + done, 0, PAGE_SIZE - done);
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool PageFile::write(uint64_t page, const char* data)
+{
+    size_t done = 0;
+    off_t offset = static_cast<off_t>(page * PAGE_SIZE);
+    while (done < PAGE_SIZE)
+    {
+        ssize_t n = pwrite(fd, data + done, PAGE_SIZE - done, offset + static_cast<off_t>(done));
+        if (n < 0)
+            return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool PageFile::sync()
+{
+    return fd >= 0 && fdatasync(fd) == 0;
+}
+
+// ========================================
+// BufferPool
+// ========================================
+
+BufferPool::BufferPool(PageFile& file, size_t n, CachePolicy policy, bool steal)
+    : file(file),
+      capacity(max<size_t>(n, 2)),
+      policy(policy),
+      steal(steal),
+      frames(make_unique<Frame[]>(capacity))
+{
+    freeFrames.reserve(capacity);
+    for (size_t i = capacity; i-- > 0;)
+    {
+        frames[i].data = make_unique<char[]>(PAGE_SIZE);
+        freeFrames.push_back(static_cast<uint32_t>(i));
+    }
+    table.reserve(capacity);
+}
+
+BufferPool::~BufferPool()
+{
+    flush();
+}
+
+void BufferPool::link(uint32_t f, uint8_t list)
+{
+    FrameList& l = listOf(list);
+    Frame& frame = frames[f];
+    frame.list = list;
+    frame.prev = l.tail;
+    frame.next = NIL;
+    if (l.tail != NIL)
+        frames[l.tail].next = f;
+    else
+        l.head = f;
+    l.tail = f;
+    ++l.size;
+}
+
+void BufferPool::unlink(uint32_t f)
+{
+    Frame& frame = frames[f];
+    FrameList& l = listOf(frame.list);
+    if (frame.prev != NIL)
+        frames[frame.prev].next = frame.next;
+    else
+        l.head = frame.next;
+    if (frame.next != NIL)
+        frames[frame.next].prev = frame.prev;
+    else
+        l.tail = frame.prev;
+    --l.size;
+    frame.list = NONE;
+    frame.prev = frame.next = NIL;
+}
+
+void BufferPool::remember(uint64_t page, uint8_t list)
+{
+    std::list<uint64_t>& l = list == B1 ? b1 : b2;
+    l.push_back(page);
+    ghosts[page] = {list, prev(l.end())};
+}
+
+void BufferPool::forget(uint64_t page)
+{
+    auto it = ghosts.find(page);
+    if (it == ghosts.end())
+        return;
+    (it->second.list == B1 ? b1 : b2).erase(it->second.pos);
+    ghosts.erase(it);
+}
+
+// ARC keeps T1 + B1 within the cache size and all four lists within
+// twice it; the oldest ghosts go first.
+void BufferPool::trimGhosts()
+{
+    while (!b1.empty() && t1.size + b1.size() > capacity)
+        forget(b1.front());
+    while (t1.size + t2.size + b1.size() + b2.size() > 2 * capacity)
+        forget(!b2.empty() ? b2.front() : b1.front());
+}
+
+uint32_t BufferPool::firstUnpinned(const FrameList& list) const
+{
+    uint32_t f = list.head;
+    while (f != NIL
+           && (frames[f].pins || frames[f].loading
+               || (!steal && frames[f].dirty.load(memory_order_relaxed))))
+        f = frames[f].next;
+    return f;
+}
+
+// Takes a frame from T1 while T1 is over its target, else from T2, and
+// remembers its page as a ghost. NIL if every frame is pinned.
+uint32_t BufferPool::replace(bool ghostInB2, bool& failed)
+{
+    bool fromT1 = policy == CachePolicy::Lru
+                  || (t1.size > 0 && (t1.size > target || (ghostInB2 && t1.size == target)));
+    uint32_t victim = firstUnpinned(fromT1 ? t1 : t2);
+    if (victim == NIL)
+    {
+        fromT1 = !fromT1;
+        victim = firstUnpinned(fromT1 ? t1 : t2);
+    }
+    if (victim == NIL)
+        return NIL;
+
+    // Unpinned, so no one holds the latch and no one can pin it while
+    // the pool lock is held. The write lands in the OS page cache.
+    Frame& frame = frames[victim];
+    if (frame.dirty.load(memory_order_acquire))
+    {
+        if (!file.write(frame.page, frame.data.get()))
+        {
+            failed = true;
+            return NIL;
+        }
+        frame.dirty.store(false, memory_order_relaxed);
+        dirtyCount.fetch_sub(1, memory_order_relaxed);
+        writebackCount.fetch_add(1, memory_order_relaxed);
+    }
+    unlink(victim);
+    table.erase(frame.page);
+    evictionCount.fetch_add(1, memory_order_relaxed);
+    if (policy == CachePolicy::Arc)
+        remember(frame.page, fromT1 ? B1 : B2);
+    return victim;
+}
+
+// A frame for `page` and the list it joins: T2 if ARC remembers the
+// page, T1 otherwise.
+uint32_t BufferPool::claimFrame(uint64_t page, uint8_t& list, bool& failed)
+{
+    auto ghost = ghosts.find(page);
+    uint8_t was = ghost == ghosts.end() ? uint8_t(NONE) : ghost->second.list;
+
+    // A ghost hit in B1 means T1 was too small; in B2, too large.
+    size_t grow = was == B1 ? max<size_t>(b2.size() / b1.size(), 1) : 0;
+    size_t shrink = was == B2 ? max<size_t>(b1.size() / b2.size(), 1) : 0;
+
+    uint32_t f = NIL;
+    if (!freeFrames.empty())
+    {
+        f = freeFrames.back();
+        freeFrames.pop_back();
+    }
+    else
+    {
+        f = replace(was == B2, failed);
+        if (f == NIL)
+            return NIL;
+    }
+
+    target = min(capacity, target + grow);
+    target -= min(target, shrink);
+    if (was != NONE)
+        forget(page);
+    list = was != NONE && policy == CachePolicy::Arc ? T2 : T1;
+    return f;
+}
+
+BufferPool::PageRef BufferPool::fetch(uint64_t page)
+{
+    return pin(page, false);
+}
+
+BufferPool::PageRef BufferPool::allocate()
+{
+    return pin(file.allocate(), true);
+}
+
+BufferPool::PageRef BufferPool::pin(uint64_t page, bool fresh)
+{
+    unique_lock<mutex> lock(poolMutex);
+    uint32_t f;
+    uint8_t list;
+    for (;;)
+    {
+        auto it = table.find(page);
+        if (it != table.end())
+        {
+            Frame& frame = frames[it->second];
+            if (frame.loading)
+            {
+                loaded.wait(lock);
+                continue;
+            }
+            // A second use moves the page to T2 under ARC.
+            ++frame.pins;
+            unlink(it->second);
+            link(it->second, policy == CachePolicy::Arc ? T2 : T1);
+            hitCount.fetch_add(1, memory_order_relaxed);
+            return PageRef(this, &frame);
+        }
+
+        bool failed = false;
+        f = claimFrame(page, list, failed);
+        if (failed)
+            return {};
+        if (f != NIL)
+            break;
+        ++waitingForFrame;
+        released.wait(lock);
+        --waitingForFrame;
+    }
+
+    Frame& frame = frames[f];
+    frame.page = page;
+    frame.pins = 1;
+    link(f, list);
+    table[page] = f;
+    trimGhosts();
+
+    if (fresh)
+    {
+        memset(frame.data.get(), 0, PAGE_SIZE);
+        PageRef ref(this, &frame);
+        ref.markDirty();
+        return ref;
+    }
+
+    frame.loading = true;
+    lock.unlock();
+    auto start = chrono::steady_clock::now();
+    bool ok = file.read(page, frame.data.get());
+    uint64_t ns = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    lock.lock();
+
+    frame.loading = false;
+    loaded.notify_all();
+    if (!ok)
+    {
+        unlink(f);
+        table.erase(page);
+        frame.pins = 0;
+        freeFrames.push_back(f);
+        return {};
+    }
+
+    faultCount.fetch_add(1, memory_order_relaxed);
+    faultNsTotal.fetch_add(ns, memory_order_relaxed);
+    uint64_t longest = faultNsMax.load(memory_order_relaxed);
+    while (ns > longest && !faultNsMax.compare_exchange_weak(longest, ns, memory_order_relaxed))
+    {
+    }
+    return PageRef(this, &frame);
+}
+
+void BufferPool::unpin(Frame* frame)
+{
+    lock_guard<mutex> lock(poolMutex);
+    if (--frame->pins == 0 && waitingForFrame)
+        released.notify_all();
+}
+
+// Latches are taken only after the pool lock is released: a latch
+// holder may be waiting in fetch().
+vector<uint32_t> BufferPool::pinDirty()
+{
+    vector<uint32_t> dirty;
+    lock_guard<mutex> lock(poolMutex);
+    for (uint32_t f = 0; f < capacity; ++f)
+    {
+        Frame& frame = frames[f];
+        if (frame.list != NONE && !frame.loading && frame.dirty.load(memory_order_acquire))
+        {
+            ++frame.pins;
+            dirty.push_back(f);
+        }
+    }
+    return dirty;
+}
+
+bool BufferPool::flush()
+{
+    // Write each page under its latch so no writer is halfway through
+    // a change.
+    vector<uint32_t> dirty = pinDirty();
+    bool ok = true;
+    for (uint32_t f : dirty)
+    {
+        Frame& frame = frames[f];
+        {
+            shared_lock<shared_mutex> latch(frame.latch);
+            if (frame.dirty.exchange(false, memory_order_acq_rel))
+            {
+                if (file.write(frame.page, frame.data.get()))
+                {
+                    dirtyCount.fetch_sub(1, memory_order_relaxed);
+                    writebackCount.fetch_add(1, memory_order_relaxed);
+                }
+                else
+                {
+                    frame.dirty.store(true, memory_order_release);
+                    ok = false;
+                }
+            }
+        }
+        unpin(&frame);
+    }
+    return file.sync() && ok;
+}
+
+void BufferPool::copyDirty(vector<pair<uint64_t, string>>& out)
+{
+    for (uint32_t f : pinDirty())
+    {
+        Frame& frame = frames[f];
+        {
+            shared_lock<shared_mutex> latch(frame.latch);
+            out.emplace_back(frame.page, string(frame.data.get(), PAGE_SIZE));
+        }
+        unpin(&frame);
+    }
+}
+
+BufferPoolStats BufferPool::stats() const
+{
+    BufferPoolStats s;
+    s.hits = hitCount.load(memory_order_relaxed);
+    s.faults = faultCount.load(memory_order_relaxed);
+    s.evictions = evictionCount.load(memory_order_relaxed);
+    s.writebacks = writebackCount.load(memory_order_relaxed);
+    s.faultNs = faultNsTotal.load(memory_order_relaxed);
+    s.maxFaultNs = faultNsMax.load(memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,260 @@
+/*
+    Page file and buffer pool
+    --------------------------------
+    A PageFile is a file of fixed PAGE_SIZE pages, read and written
+    with pread/pwrite. A BufferPool keeps a bounded number of them in
+    memory frames.
+
+    fetch() pins a page and returns a PageRef; the page stays in its
+    frame until every PageRef to it is gone. Unpinned pages are
+    replaced by ARC (adaptive replacement cache): pages seen once and
+    pages seen again live in separate lists, and the split between
+    them follows the workload, steered by the numbers of recently
+    replaced pages. A long scan therefore cannot push out the pages
+    that are used over and over. Plain LRU is available for
+    comparison.
+
+    Dirty pages are written back when replaced and by flush(). A miss
+    reads outside the pool lock; other threads wanting the same page
+    wait for that read. Page contents are guarded by the frame latch,
+    which callers take themselves and only while they hold the pin.
+    The pool must have more frames than pages pinned at once, or
+    fetch() waits for one to be released.
+
+    Without steal, dirty pages are never replaced: the file changes
+    only in flush(), which lets an owner with a log decide when the
+    file moves forward. The owner must flush before dirty pages fill
+    the pool.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr size_t PAGE_SIZE = 4096;
+
+class PageFile
+{
+private:
+    int fd = -1;
+    std::atomic<uint64_t> pages{0};
+
+public:
+    PageFile() = default;
+    ~PageFile();
+
+    PageFile(const PageFile&) = delete;
+    PageFile& operator=(const PageFile&) = delete;
+
+    // Opens `path`, creating an empty file if there is none.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    uint64_t pageCount() const { return pages.load(std::memory_order_acquire); }
+    // Reserves the next page number. The file grows when it is written.
+    uint64_t allocate() { return pages.fetch_add(1, std::memory_order_acq_rel); }
+
+    // A page past the end of the file reads as zeros.
+    bool read(uint64_t page, char* out) const;
+    bool write(uint64_t page, const char* data);
+    bool sync();
+};
+
+enum class CachePolicy
+{
+    Lru,
+    Arc
+};
+
+struct BufferPoolStats
+{
+    uint64_t hits = 0;
+    uint64_t faults = 0;
+    uint64_t evictions = 0;
+    uint64_t writebacks = 0;
+    // Time spent reading faulted pages, in total and the longest one.
+    uint64_t faultNs = 0;
+    uint64_t maxFaultNs = 0;
+
+    double hitRate() const { return hits + faults ? double(hits) / double(hits + faults) : 0.0; }
+    double meanFaultUs() const { return faults ? faultNs / 1e3 / double(faults) : 0.0; }
+};
+
+class BufferPool
+{
+private:
+    static constexpr uint32_t NIL = static_cast<uint32_t>(-1);
+
+    // Lists a frame (or, for ghosts, a replaced page's number) is on.
+    // T1: seen once recently; T2: seen at least twice. B1 and B2
+    // remember pages recently replaced from T1 and T2.
+    enum : uint8_t
+    {
+        NONE,
+        T1,
+        T2,
+        B1,
+        B2
+    };
+
+    struct Frame
+    {
+        std::unique_ptr<char[]> data;
+        uint64_t page = 0;
+        // Pool state; guarded by the pool mutex.
+        uint32_t pins = 0;
+        bool loading = false;
+        uint8_t list = NONE;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+
+        std::atomic<bool> dirty{false};
+        std::shared_mutex latch;
+    };
+
+    // Frames in recency order, least recent at the head.
+    struct FrameList
+    {
+        uint32_t head = NIL;
+        uint32_t tail = NIL;
+        size_t size = 0;
+    };
+
+    struct Ghost
+    {
+        uint8_t list;
+        std::list<uint64_t>::iterator pos;
+    };
+
+    PageFile& file;
+    const size_t capacity;
+    const CachePolicy policy;
+    const bool steal;
+    std::unique_ptr<Frame[]> frames;
+
+    mutable std::mutex poolMutex;
+    std::condition_variable loaded;
+    std::condition_variable released;
+    std::unordered_map<uint64_t, uint32_t> table;
+    std::vector<uint32_t> freeFrames;
+    FrameList t1;
+    FrameList t2;
+    // Least recent at the front.
+    std::list<uint64_t> b1;
+    std::list<uint64_t> b2;
+    std::unordered_map<uint64_t, Ghost> ghosts;
+    // ARC's target size for T1.
+    size_t target = 0;
+    size_t waitingForFrame = 0;
+
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> faultCount{0};
+    std::atomic<uint64_t> evictionCount{0};
+    std::atomic<uint64_t> writebackCount{0};
+    std::atomic<uint64_t> faultNsTotal{0};
+    std::atomic<uint64_t> faultNsMax{0};
+    std::atomic<size_t> dirtyCount{0};
+
+    // All of these require poolMutex.
+    FrameList& listOf(uint8_t list) { return list == T1 ? t1 : t2; }
+    void link(uint32_t f, uint8_t list);
+    void unlink(uint32_t f);
+    void forget(uint64_t page);
+    void remember(uint64_t page, uint8_t list);
+    void trimGhosts();
+    uint32_t firstUnpinned(const FrameList& list) const;
+    uint32_t replace(bool ghostInB2, bool& failed);
+    uint32_t claimFrame(uint64_t page, uint8_t& list, bool& failed);
+
+    void unpin(Frame* frame);
+    // Pins every dirty page and returns their frames.
+    std::vector<uint32_t> pinDirty();
+
+public:
+    // A pinned page. Move-only; releasing it unpins the page.
+    class PageRef
+    {
+    private:
+        friend class BufferPool;
+        BufferPool* pool = nullptr;
+        Frame* frame = nullptr;
+
+        PageRef(BufferPool* pool, Frame* frame) : pool(pool), frame(frame) {}
+
+    public:
+        PageRef() = default;
+        PageRef(PageRef&& other) noexcept : pool(other.pool), frame(other.frame)
+        {
+            other.frame = nullptr;
+        }
+        PageRef& operator=(PageRef&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                pool = other.pool;
+                frame = other.frame;
+                other.frame = nullptr;
+            }
+            return *this;
+        }
+        ~PageRef() { release(); }
+
+        explicit operator bool() const { return frame != nullptr; }
+
+        void release()
+        {
+            if (frame)
+                pool->unpin(frame);
+            frame = nullptr;
+        }
+
+        uint64_t page() const { return frame->page; }
+        char* data() { return frame->data.get(); }
+        const char* data() const { return frame->data.get(); }
+        std::shared_mutex& latch() { return frame->latch; }
+        // Call after changing the page, while holding the latch.
+        void markDirty()
+        {
+            if (!frame->dirty.exchange(true, std::memory_order_acq_rel))
+                pool->dirtyCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    BufferPool(PageFile& file, size_t frames, CachePolicy policy = CachePolicy::Arc,
+               bool steal = true);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Pins `page`, reading it in on a miss. Empty if the read failed.
+    PageRef fetch(uint64_t page);
+    // Pins a new zeroed page at the end of the file.
+    PageRef allocate();
+
+    // Writes back every dirty page and syncs the file.
+    bool flush();
+    // Copies of every dirty page, for a caller that must save them
+    // elsewhere before flush() overwrites the file.
+    void copyDirty(std::vector<std::pair<uint64_t, std::string>>& out);
+
+    size_t frameCount() const { return capacity; }
+    size_t dirtyPages() const { return dirtyCount.load(std::memory_order_relaxed); }
+    BufferPoolStats stats() const;
+
+private:
+    PageRef pin(uint64_t page, bool fresh);
+};
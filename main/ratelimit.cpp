@@ -0,0 +1,195 @@
+#include "ratelimit.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+using namespace std;
+
+uint64_t admissionClock()
+{
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// ========================================
+// RateLimiter
+// ========================================
+
+RateLimiter::RateLimiter(const RateLimit& limit, size_t n)
+{
+    if (limit.perSecond > 0.0)
+    {
+        interval = max<uint64_t>(1, static_cast<uint64_t>(1e9 / limit.perSecond));
+        capacity = static_cast<uint64_t>(max(1.0, limit.burst) * static_cast<double>(interval));
+    }
+    // A disabled limiter needs no table.
+    size_t count = enabled() ? bit_ceil(max<size_t>(1, n)) : 1;
+    mask = count - 1;
+    slots = make_unique<atomic<uint64_t>[]>(count);
+}
+
+bool RateLimiter::tryAcquire(uint64_t key, uint64_t now)
+{
+    if (!enabled())
+        return true;
+
+    // A slot holds the time its bucket is full again (0 = full). Taking
+    // a token pushes that time one interval later; there is a token
+    // while it stays within `capacity` of now.
+    atomic<uint64_t>& slot = slots[key & mask];
+    uint64_t full = slot.load(memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        next = max(full, now) + interval;
+        if (next - now > capacity)
+            return false;
+    } while (!slot.compare_exchange_weak(full, next, memory_order_relaxed));
+    return true;
+}
+
+// ========================================
+// Latency histogram
+// ========================================
+
+// Four buckets per power of two of nanoseconds: within 19% of the value.
+static size_t latencyBucket(uint64_t ns)
+{
+    if (ns < 4)
+        return static_cast<size_t>(ns);
+    unsigned octave = static_cast<unsigned>(bit_width(ns)) - 1;
+    size_t sub = static_cast<size_t>((ns >> (octave - 2)) & 3);
+    return min<size_t>(255, octave * 4 + sub);
+}
+
+// Upper end of a bucket's range.
+static uint64_t bucketLimit(size_t bucket)
+{
+    // Buckets 4-7 are never used.
+    if (bucket < 8)
+        return min<uint64_t>(bucket, 7);
+    unsigned octave = static_cast<unsigned>(bucket / 4);
+    uint64_t sub = bucket % 4;
+    return ((4 + sub + 1) << (octave - 2)) - 1;
+}
+
+// ========================================
+// AdmissionControl
+// ========================================
+
+AdmissionControl::AdmissionControl(const AdmissionPolicy& policy)
+    : policy(policy),
+      accounts(policy.perAccount, policy.slots),
+      clients(policy.perClient, policy.slots),
+      windowStart(admissionClock()),
+      windowLength(static_cast<uint64_t>(max(1.0, policy.windowMs) * 1e6))
+{
+    for (Window& w : windows)
+    {
+        for (auto& c : w.counts)
+            c.store(0, memory_order_relaxed);
+    }
+}
+
+// Client ids may be anything, so they are mixed before indexing.
+static uint64_t mixClient(uint64_t client)
+{
+    client ^= client >> 33;
+    client *= 0xff51afd7ed558ccdULL;
+    client ^= client >> 33;
+    return client;
+}
+
+AdmissionControl::Ticket AdmissionControl::admit(uint64_t client, int account, int other)
+{
+    uint64_t now = admissionClock();
+    if (now - windowStart.load(memory_order_relaxed) >= windowLength)
+        rotate(now);
+
+    Ticket ticket;
+    if ((policy.maxInFlight && inFlightCount.load(memory_order_relaxed) >= policy.maxInFlight)
+        || (policy.maxP99Ms > 0.0 && p99Ms() > policy.maxP99Ms))
+    {
+        ticket.verdict = Admission::Overloaded;
+        overloadedCount.fetch_add(1, memory_order_relaxed);
+        return ticket;
+    }
+    if (client && !clients.tryAcquire(mixClient(client), now))
+    {
+        ticket.verdict = Admission::ClientLimited;
+        clientLimitedCount.fetch_add(1, memory_order_relaxed);
+        return ticket;
+    }
+    if ((account > 0 && !accounts.tryAcquire(static_cast<uint64_t>(account), now))
+        || (other > 0 && other != account && !accounts.tryAcquire(static_cast<uint64_t>(other), now)))
+    {
+        ticket.verdict = Admission::AccountLimited;
+        accountLimitedCount.fetch_add(1, memory_order_relaxed);
+        return ticket;
+    }
+
+    inFlightCount.fetch_add(1, memory_order_relaxed);
+    admittedCount.fetch_add(1, memory_order_relaxed);
+    ticket.owner = this;
+    ticket.start = now;
+    return ticket;
+}
+
+void AdmissionControl::finish(uint64_t start)
+{
+    uint64_t now = admissionClock();
+    inFlightCount.fetch_sub(1, memory_order_relaxed);
+    windows[current.load(memory_order_relaxed)].counts[latencyBucket(now - start)].fetch_add(
+        1, memory_order_relaxed);
+    if (now - windowStart.load(memory_order_relaxed) >= windowLength)
+        rotate(now);
+}
+
+void AdmissionControl::rotate(uint64_t now)
+{
+    // One caller wins the window; the rest carry on.
+    uint64_t start = windowStart.load(memory_order_relaxed);
+    if (now - start < windowLength
+        || !windowStart.compare_exchange_strong(start, now, memory_order_relaxed))
+        return;
+
+    unsigned closed = current.load(memory_order_relaxed);
+    current.store(closed ^ 1, memory_order_relaxed);
+
+    // Requests still recording into the closed window are counted in
+    // this p99 or cleared with it; either is fine for shedding. An
+    // empty window gives 0, so shedding stops once nothing completes.
+    Window& w = windows[closed];
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total = 0;
+    for (size_t b = 0; b < LATENCY_BUCKETS; ++b)
+    {
+        counts[b] = w.counts[b].exchange(0, memory_order_relaxed);
+        total += counts[b];
+    }
+    uint64_t p99 = 0;
+    uint64_t rank = total - total / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LATENCY_BUCKETS && total; ++b)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+            p99 = bucketLimit(b);
+            break;
+        }
+    }
+    p99Ns.store(p99, memory_order_relaxed);
+}
+
+AdmissionStats AdmissionControl::stats() const
+{
+    AdmissionStats s;
+    s.admitted = admittedCount.load(memory_order_relaxed);
+    s.accountLimited = accountLimitedCount.load(memory_order_relaxed);
+    s.clientLimited = clientLimitedCount.load(memory_order_relaxed);
+    s.overloaded = overloadedCount.load(memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,163 @@
+/*
+    Rate limiting and admission control
+    --------------------------------
+    RateLimiter keeps a token bucket per key in a fixed table of 8-byte
+    slots. Each slot holds the bucket as a "theoretical arrival time"
+    (the generic cell rate algorithm): the time at which the bucket
+    would be full again. Taking a token is one compare-and-swap on that
+    word, so the table needs no lock and no per-key allocation.
+
+    AdmissionControl combines a limiter per account and one per client
+    with global load shedding. It rejects new work while too many
+    requests are in flight or while the p99 latency of recently
+    finished requests is above a threshold. Latency is kept in a
+    lock-free log-scale histogram, and p99 is recomputed once per
+    window.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// 0 requests per second means unlimited. `burst` is how many requests
+// a key that has been idle may make back to back.
+struct RateLimit
+{
+    double perSecond = 0.0;
+    double burst = 1.0;
+};
+
+// Nanoseconds on the steady clock.
+uint64_t admissionClock();
+
+class RateLimiter
+{
+private:
+    uint64_t interval = 0;
+    uint64_t capacity = 0;
+    size_t mask = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+
+public:
+    // `slots` is rounded up to a power of two. Keys equal modulo the
+    // table size share a bucket: account ids are dense, so they only do
+    // beyond the table size.
+    RateLimiter(const RateLimit& limit, size_t slots);
+
+    bool enabled() const { return interval != 0; }
+    // Takes a token for `key` if one is available at `now`.
+    bool tryAcquire(uint64_t key, uint64_t now);
+    size_t slotCount() const { return mask + 1; }
+};
+
+// ========================================
+// AdmissionControl
+// ========================================
+
+struct AdmissionPolicy
+{
+    RateLimit perAccount;
+    RateLimit perClient;
+    // Shed new requests while this many are in flight; 0 disables.
+    size_t maxInFlight = 0;
+    // Shed new requests while the last window's p99 is above this;
+    // 0 disables.
+    double maxP99Ms = 0.0;
+    double windowMs = 100.0;
+    size_t slots = 1 << 16;
+};
+
+enum class Admission
+{
+    Admitted,
+    AccountLimited,
+    ClientLimited,
+    Overloaded
+};
+
+struct AdmissionStats
+{
+    uint64_t admitted = 0;
+    uint64_t accountLimited = 0;
+    uint64_t clientLimited = 0;
+    uint64_t overloaded = 0;
+};
+
+class AdmissionControl
+{
+private:
+    static constexpr size_t LATENCY_BUCKETS = 256;
+
+    struct Window
+    {
+        std::atomic<uint32_t> counts[LATENCY_BUCKETS];
+    };
+
+    AdmissionPolicy policy;
+    RateLimiter accounts;
+    RateLimiter clients;
+
+    std::atomic<size_t> inFlightCount{0};
+    Window windows[2];
+    std::atomic<unsigned> current{0};
+    std::atomic<uint64_t> windowStart;
+    uint64_t windowLength;
+    std::atomic<uint64_t> p99Ns{0};
+
+    std::atomic<uint64_t> admittedCount{0};
+    std::atomic<uint64_t> accountLimitedCount{0};
+    std::atomic<uint64_t> clientLimitedCount{0};
+    std::atomic<uint64_t> overloadedCount{0};
+
+    void rotate(uint64_t now);
+    void finish(uint64_t start);
+
+public:
+    // Held for the duration of an admitted request; its destructor
+    // records the request's latency.
+    class Ticket
+    {
+    private:
+        AdmissionControl* owner = nullptr;
+        uint64_t start = 0;
+        Admission verdict = Admission::Admitted;
+
+        friend class AdmissionControl;
+
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept
+            : owner(std::exchange(other.owner, nullptr)), start(other.start), verdict(other.verdict)
+        {
+        }
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        ~Ticket()
+        {
+            if (owner)
+                owner->finish(start);
+        }
+
+        explicit operator bool() const { return verdict == Admission::Admitted; }
+        Admission result() const { return verdict; }
+    };
+
+    explicit AdmissionControl(const AdmissionPolicy& policy = {});
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    // Checks load, then `client` (0 is anonymous and never limited),
+    // then each non-zero account id.
+    Ticket admit(uint64_t client, int account, int other = 0);
+
+    size_t inFlight() const { return inFlightCount.load(std::memory_order_relaxed); }
+    // p99 of the last complete window.
+    double p99Ms() const { return p99Ns.load(std::memory_order_relaxed) / 1e6; }
+    AdmissionStats stats() const;
+};
@@ -0,0 +1,18 @@
+#include "result.h"
+
+const char* resultMessage(Result r)
+{
+    switch (r)
+    {
+    case Result::Ok: return "OK.";
+    case Result::AccountNotFound: return "Account not found.";
+    case Result::InsufficientFunds: return "Insufficient funds.";
+    case Result::InvalidAmount: return "Invalid amount.";
+    case Result::NoExchangeRate: return "No exchange rate.";
+    case Result::RateLimited: return "Too many requests; try again later.";
+    case Result::Overloaded: return "Server busy; try again later.";
+    case Result::Cancelled: return "Cancelled.";
+    case Result::StorageError: return "Storage error.";
+    }
+    return "Unknown error.";
+}
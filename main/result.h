@@ -0,0 +1,28 @@
+/*
+    Operation results
+    --------------------------------
+    The outcome codes every store in the core library reports, kept
+    apart from bank.h so stores that are not a Bank need not pull it in.
+*/
+
+#pragma once
+
+enum class Result
+{
+    Ok,
+    AccountNotFound,
+    InsufficientFunds,
+    InvalidAmount,
+    NoExchangeRate,
+    // Refused by admission control (see ratelimit.h) before reaching
+    // the bank.
+    RateLimited,
+    Overloaded,
+    // A batch was cancelled before this item ran.
+    Cancelled,
+    // A disk-backed store (accountstore.h) could not read or write.
+    StorageError
+};
+
+// Human-readable text for a Result, e.g. "Insufficient funds."
+const char* resultMessage(Result r);
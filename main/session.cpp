@@ -0,0 +1,298 @@
+#include "session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+using namespace std;
+
+// ========================================
+// Frame accounting
+// ========================================
+
+static atomic<size_t> liveBytes{0};
+static atomic<size_t> peakBytes{0};
+
+void* FramePromiseBase::operator new(size_t size)
+{
+    size_t now = liveBytes.fetch_add(size, memory_order_relaxed) + size;
+    size_t peak = peakBytes.load(memory_order_relaxed);
+    while (now > peak && !peakBytes.compare_exchange_weak(peak, now, memory_order_relaxed))
+    {
+    }
+    return ::operator new(size);
+}
+
+void FramePromiseBase::operator delete(void* p, size_t size)
+{
+    liveBytes.fetch_sub(size, memory_order_relaxed);
+    ::operator delete(p);
+}
+
+size_t liveFrameBytes()
+{
+    return liveBytes.load(memory_order_relaxed);
+}
+
+size_t peakFrameBytes()
+{
+    return peakBytes.load(memory_order_relaxed);
+}
+
+void resetFramePeak()
+{
+    peakBytes.store(liveBytes.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+// ========================================
+// EventLoop
+// ========================================
+
+// The loop and worker owning the current thread, if it is a loop thread.
+static thread_local const EventLoop* currentLoop = nullptr;
+static thread_local void* currentWorker = nullptr;
+
+EventLoop::EventLoop(size_t threads)
+{
+    threads = max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i)
+        workers.push_back(make_unique<Worker>());
+
+    for (auto& w : workers)
+    {
+        Worker* worker = w.get();
+        worker->thread = thread([this, worker] { runWorker(*worker); });
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    waitIdle();
+    stopping.store(true);
+    for (auto& w : workers)
+    {
+        {
+            lock_guard<mutex> lock(w->mutex);
+        }
+        w->ready.notify_all();
+    }
+    for (auto& w : workers)
+        w->thread.join();
+}
+
+void EventLoop::runWorker(Worker& w)
+{
+    currentLoop = this;
+    currentWorker = &w;
+    deque<coroutine_handle<>> batch;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(w.mutex);
+            w.ready.wait(lock, [&] { return !w.queue.empty() || stopping.load(); });
+            if (w.queue.empty())
+                return;
+            batch.swap(w.queue);
+        }
+
+        // Resume the whole batch without holding the queue lock.
+        while (!batch.empty())
+        {
+            coroutine_handle<> h = batch.front();
+            batch.pop_front();
+            h.resume();
+        }
+    }
+}
+
+void EventLoop::post(coroutine_handle<> h)
+{
+    Worker* w = static_cast<Worker*>(currentWorker);
+    if (currentLoop != this)
+        w = workers[nextWorker.fetch_add(1, memory_order_relaxed) % workers.size()].get();
+
+    {
+        lock_guard<mutex> lock(w->mutex);
+        w->queue.push_back(h);
+    }
+    w->ready.notify_one();
+}
+
+EventLoop::Detached EventLoop::runDetached(EventLoop& loop, Task<void> task)
+{
+    try
+    {
+        co_await task;
+    }
+    catch (...)
+    {
+        // A failed session ends only itself.
+    }
+    loop.sessionFinished();
+}
+
+void EventLoop::spawn(Task<void> session)
+{
+    size_t now = active.fetch_add(1, memory_order_relaxed) + 1;
+    size_t peak = peakActive.load(memory_order_relaxed);
+    while (now > peak && !peakActive.compare_exchange_weak(peak, now, memory_order_relaxed))
+    {
+    }
+
+    Detached root = runDetached(*this, move(session));
+    post(root.handle);
+}
+
+void EventLoop::sessionFinished()
+{
+    if (active.fetch_sub(1, memory_order_acq_rel) == 1)
+    {
+        lock_guard<mutex> lock(idleMutex);
+        idle.notify_all();
+    }
+}
+
+void EventLoop::waitIdle()
+{
+    unique_lock<mutex> lock(idleMutex);
+    idle.wait(lock, [&] { return active.load(memory_order_acquire) == 0; });
+}
+
+// ========================================
+// PersistenceQueue
+// ========================================
+
+PersistenceQueue::PersistenceQueue(Bank& bank, EventLoop& loop)
+    : bank(bank), loop(loop)
+{
+    flusher = thread([this] { run(); });
+}
+
+PersistenceQueue::~PersistenceQueue()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    pending.notify_all();
+    flusher.join();
+}
+
+bool PersistenceQueue::enqueue(coroutine_handle<> h)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        waiters.push_back(h);
+    }
+    pending.notify_one();
+    return true;
+}
+
+void PersistenceQueue::run()
+{
+    vector<coroutine_handle<>> batch;
+    chrono::milliseconds backoff{0};
+
+    while (true)
+    {
+        {
+            unique_lock<std::mutex> lock(mutex);
+            pending.wait(lock, [&] { return !waiters.empty() || stopping; });
+            if (waiters.empty())
+                return;
+            batch.swap(waiters);
+        }
+
+        // One publish and flush covers every waiter that queued before
+        // it started.
+        uint64_t target = bank.journalSeq();
+        if (bank.syncJournal() >= target)
+        {
+            for (coroutine_handle<> h : batch)
+                loop.post(h);
+            batch.clear();
+            backoff = chrono::milliseconds(0);
+            continue;
+        }
+
+        // The flush fell short, so it failed; retry after a pause that
+        // doubles up to MAX_BACKOFF rather than spinning on the disk.
+        backoff = min(max(2 * backoff, chrono::milliseconds(1)), MAX_BACKOFF);
+        unique_lock<std::mutex> lock(mutex);
+        waiters.insert(waiters.end(), batch.begin(), batch.end());
+        batch.clear();
+        pending.wait_for(lock, backoff, [&] { return stopping; });
+    }
+}
+
+// ========================================
+// SessionServer
+// ========================================
+
+SessionServer::SessionServer(Bank& bank, size_t threads, const AdmissionPolicy& policy)
+    : bank(bank), loop(threads), persistence(bank, loop), admission(policy)
+{
+}
+
+Task<int> SessionServer::createAccount(string owner, Currency currency)
+{
+    co_return bank.createAccount(owner, currency);
+}
+
+Task<Result> SessionServer::deposit(int id, double amount, uint64_t client)
+{
+    if (!bank.accountMayExist(id))
+        co_return Result::AccountNotFound;
+    auto ticket = admission.admit(client, id);
+    if (!ticket)
+        co_return refusal(ticket);
+    co_return bank.deposit(id, amount);
+}
+
+Task<Result> SessionServer::withdraw(int id, double amount, uint64_t client)
+{
+    if (!bank.accountMayExist(id))
+        co_return Result::AccountNotFound;
+    auto ticket = admission.admit(client, id);
+    if (!ticket)
+        co_return refusal(ticket);
+    co_return bank.withdraw(id, amount);
+}
+
+Task<Result> SessionServer::transfer(int from, int to, double amount, uint64_t client)
+{
+    if (!bank.accountMayExist(from) || !bank.accountMayExist(to))
+        co_return Result::AccountNotFound;
+    auto ticket = admission.admit(client, from, to);
+    if (!ticket)
+        co_return refusal(ticket);
+    co_return bank.transfer(from, to, amount);
+}
+
+Task<optional<double>> SessionServer::balance(int id, uint64_t client)
+{
+    if (!bank.accountMayExist(id))
+        co_return nullopt;
+    auto ticket = admission.admit(client, id);
+    if (!ticket)
+        co_return nullopt;
+    double out;
+    if (bank.balance(id, out) != Result::Ok)
+        co_return nullopt;
+    co_return out;
+}
+
+Task<vector<Transaction>> SessionServer::history(int id)
+{
+    vector<Transaction> out;
+    if (!bank.accountMayExist(id))
+        co_return out;
+    bank.history(id, out);
+    co_return out;
+}
+
+Task<void> SessionServer::persist()
+{
+    co_await persistence.sync();
+}
@@ -0,0 +1,358 @@
+/*
+    Coroutine-based client sessions
+    --------------------------------
+    A client conversation (create, deposit, check history, ...) is
+    written as one sequential C++20 coroutine. Thousands of them are
+    multiplexed over a small EventLoop: a session that waits for its
+    writes to become durable is parked as a coroutine frame (a few
+    hundred bytes) instead of blocking a thread. Bank calls themselves
+    run on the loop thread (see SessionServer).
+
+        Task<void> conversation(SessionServer& s)
+        {
+            int id = co_await s.createAccount("Alice", Currency::USD);
+            co_await s.deposit(id, 100.0);
+            co_await s.persist();
+            auto history = co_await s.history(id);
+        }
+
+        SessionServer server(bank, 4);
+        server.spawn(conversation(server));
+        server.waitIdle();
+*/
+
+#pragma once
+
+#include "bank.h"
+#include "ratelimit.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ========================================
+// Frame accounting
+// ========================================
+
+// Every coroutine frame in this module is allocated through this base,
+// so the cost of a parked session can be measured.
+struct FramePromiseBase
+{
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+};
+
+size_t liveFrameBytes();
+size_t peakFrameBytes();
+void resetFramePeak();
+
+// ========================================
+// Task
+// ========================================
+
+struct TaskPromiseBase : FramePromiseBase
+{
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            return h.promise().continuation;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+// Lazily started coroutine; awaiting it runs it to completion and
+// resumes the awaiter by symmetric transfer.
+template <typename T>
+class Task
+{
+public:
+    struct promise_type : TaskPromiseBase
+    {
+        std::optional<T> value;
+
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_value(T v) { value = std::move(v); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&&) = delete;
+
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+        return std::move(*handle.promise().value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <>
+class Task<void>
+{
+public:
+    struct promise_type : TaskPromiseBase
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_void() {}
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&&) = delete;
+
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    void await_resume()
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// ========================================
+// EventLoop
+// ========================================
+
+class EventLoop
+{
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::coroutine_handle<>> queue;
+        std::thread thread;
+    };
+
+    // Root frame for spawned sessions; destroys itself on completion.
+    struct Detached
+    {
+        struct promise_type : FramePromiseBase
+        {
+            Detached get_return_object()
+            {
+                return {std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> active{0};
+    std::atomic<size_t> peakActive{0};
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    void runWorker(Worker& w);
+    void sessionFinished();
+    static Detached runDetached(EventLoop& loop, Task<void> task);
+
+public:
+    explicit EventLoop(size_t threads);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Queues h for resumption. From a loop thread it stays on that
+    // thread's queue; otherwise queues are picked round-robin.
+    void post(std::coroutine_handle<> h);
+
+    // co_await loop.schedule() continues on a loop thread.
+    auto schedule()
+    {
+        struct Awaiter
+        {
+            EventLoop& loop;
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { loop.post(h); }
+            void await_resume() noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // Starts a session; it owns its frame and cleans up when done.
+    void spawn(Task<void> session);
+
+    // Blocks the calling (non-loop) thread until all sessions finish.
+    void waitIdle();
+
+    size_t threadCount() const { return workers.size(); }
+    size_t activeSessions() const { return active.load(std::memory_order_relaxed); }
+    size_t peakSessions() const { return peakActive.load(std::memory_order_relaxed); }
+    void resetPeak() { peakActive.store(activeSessions(), std::memory_order_relaxed); }
+};
+
+// ========================================
+// PersistenceQueue
+// ========================================
+
+// Awaitable durability with group commit: sessions that co_await sync()
+// are parked until a single journal flush covers all of their writes.
+// A session's writes were staged before it parked, so any flush that
+// starts after it queued covers them; parking needs no sequence number
+// and so never publishes the per-thread journal buffers itself.
+class PersistenceQueue
+{
+private:
+
+    // Longest pause between retries after a failed flush.
+    static constexpr std::chrono::milliseconds MAX_BACKOFF{100};
+
+    Bank& bank;
+    EventLoop& loop;
+    std::mutex mutex;
+    std::condition_variable pending;
+    std::vector<std::coroutine_handle<>> waiters;
+    bool stopping = false;
+    std::thread flusher;
+
+    bool enqueue(std::coroutine_handle<> h);
+    void run();
+
+public:
+    PersistenceQueue(Bank& bank, EventLoop& loop);
+    ~PersistenceQueue();
+
+    auto sync()
+    {
+        struct Awaiter
+        {
+            PersistenceQueue& q;
+
+            bool await_ready() { return !q.bank.isJournaled(); }
+            bool await_suspend(std::coroutine_handle<> h) { return q.enqueue(h); }
+            void await_resume() noexcept {}
+        };
+        return Awaiter{*this};
+    }
+};
+
+// ========================================
+// SessionServer
+// ========================================
+
+// Session-facing Bank operations, which call Bank's thread-safe
+// operations directly on the loop thread. They are short, except that
+// while an exclusive Bank operation (save, audit, export, a
+// checkpoint's cut) holds the bank, every loop thread that calls into
+// it blocks until it is done, and so do the sessions queued behind
+// them. Run those operations off-peak or give the loop threads to
+// spare.
+//
+// Deposits, withdrawals, transfers and balance reads pass admission
+// control first (see ratelimit.h): `client` identifies the caller for
+// per-client limits (0 for none), and every account touched is charged
+// to its own limit. Refused requests return Result::RateLimited or
+// Result::Overloaded (nullopt for balance) without waiting for the
+// bank. Account creation and history reads are not limited.
+//
+// Ids the bank's account filter rules out are answered with
+// Result::AccountNotFound (nullopt, or an empty history) before
+// admission.
+class SessionServer
+{
+private:
+    Bank& bank;
+    EventLoop loop;
+    PersistenceQueue persistence;
+    AdmissionControl admission;
+
+    static Result refusal(const AdmissionControl::Ticket& ticket)
+    {
+        return ticket.result() == Admission::Overloaded ? Result::Overloaded : Result::RateLimited;
+    }
+
+public:
+    SessionServer(Bank& bank, size_t threads, const AdmissionPolicy& policy = {});
+    ~SessionServer() { loop.waitIdle(); }
+
+    Task<int> createAccount(std::string owner, Currency currency);
+    Task<Result> deposit(int id, double amount, uint64_t client = 0);
+    Task<Result> withdraw(int id, double amount, uint64_t client = 0);
+    Task<Result> transfer(int from, int to, double amount, uint64_t client = 0);
+    Task<std::optional<double>> balance(int id, uint64_t client = 0);
+    Task<std::vector<Transaction>> history(int id);
+
+    // Resumes once every write issued so far is durable.
+    Task<void> persist();
+
+    void spawn(Task<void> session) { loop.spawn(std::move(session)); }
+    void waitIdle() { loop.waitIdle(); }
+    EventLoop& eventLoop() { return loop; }
+    const AdmissionControl& admissionControl() const { return admission; }
+};
@@ -0,0 +1,127 @@
+#include "statement.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cstdio>
+
+using namespace std;
+
+bool monthPeriod(string_view month, StatementPeriod& out)
+{
+    int year = 0;
+    int mon = 0;
+    if (month.size() != 7 || month[4] != '-')
+        return false;
+    auto y = from_chars(month.data(), month.data() + 4, year);
+    auto m = from_chars(month.data() + 5, month.data() + 7, mon);
+    if (y.ptr != month.data() + 4 || m.ptr != month.data() + 7 || mon < 1 || mon > 12)
+        return false;
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04d-%02d-01 00:00:00", year, mon);
+    out.from = buf;
+    snprintf(buf, sizeof(buf), "%04d-%02d-01 00:00:00", mon == 12 ? year + 1 : year,
+             mon == 12 ? 1 : mon + 1);
+    out.to = buf;
+    return true;
+}
+
+static void appendAmount(string& out, double value, bool sign = false)
+{
+    char buf[64];
+    char* p = buf;
+    if (sign && value >= 0.0)
+        *p++ = '+';
+    auto r = to_chars(p, buf + sizeof(buf), value, chars_format::fixed, 2);
+    out.append(buf, r.ptr);
+}
+
+void appendStatementHeader(string& out, int id, string_view owner, Currency currency,
+                           const StatementPeriod& period, double opening)
+{
+    out += "STATEMENT ";
+    out += to_string(id);
+    out += ' ';
+    out += owner;
+    out += " (";
+    out += currencyCode(currency);
+    out += ")\nPeriod: ";
+    out += period.from;
+    out += " to ";
+    out += period.to;
+    out += "\nOpening balance: ";
+    appendAmount(out, opening);
+    out += '\n';
+}
+
+void appendStatementLine(string& out, const Transaction& t, double effect, double balance)
+{
+    out += t.timestamp;
+    out += " | ";
+    out += t.type;
+    if (t.type.size() < 15)
+        out.append(15 - t.type.size(), ' ');
+    out += " | ";
+    appendAmount(out, effect, true);
+    out += " | ";
+    appendAmount(out, balance);
+    out += '\n';
+}
+
+void appendStatementFooter(string& out, const StatementTotals& totals)
+{
+    out += "Credits: ";
+    appendAmount(out, totals.credits);
+    out += " (";
+    out += to_string(totals.creditCount);
+    out += ") | Debits: ";
+    appendAmount(out, totals.debits);
+    out += " (";
+    out += to_string(totals.debitCount);
+    out += ")\nClosing balance: ";
+    appendAmount(out, totals.closing);
+    out += "\n\n";
+}
+
+// ========================================
+// StatementFile
+// ========================================
+
+StatementFile::StatementFile(const string& path)
+{
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    pending.reserve(STATEMENT_WRITE_CHUNK + STATEMENT_WRITE_CHUNK / 4);
+}
+
+StatementFile::~StatementFile()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+void StatementFile::writeOut()
+{
+    size_t done = 0;
+    while (!failed && done < pending.size())
+    {
+        ssize_t n = ::write(fd, pending.data() + done, pending.size() - done);
+        if (n < 0)
+            failed = true;
+        else
+            done += static_cast<size_t>(n);
+    }
+    written += done;
+    pending.clear();
+}
+
+bool StatementFile::finish()
+{
+    if (fd < 0)
+        return false;
+    writeOut();
+    failed = ::close(fd) != 0 || failed;
+    fd = -1;
+    return !failed;
+}
@@ -0,0 +1,93 @@
+/*
+    Account statements
+    --------------------------------
+    Plain-text statements written by Bank::generateStatements(). Each
+    shard file holds the statements of a contiguous range of accounts,
+    one after another:
+
+        STATEMENT <id> <owner> (<currency>)
+        Period: <from> to <to>
+        Opening balance: <amount>
+        <timestamp> | <type> | <signed amount> | <running balance>
+        ...
+        Credits: <amount> (<count>) | Debits: <amount> (<count>)
+        Closing balance: <amount>
+        <blank line>
+
+    Amounts have two decimals.
+*/
+
+#pragma once
+
+#include "account.h"
+#include "currency.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Transactions with from <= timestamp < to. Timestamps are
+// "YYYY-MM-DD HH:MM:SS" as Transaction records them, which sort as text.
+struct StatementPeriod
+{
+    std::string from;
+    std::string to;
+};
+
+// The period of a calendar month given as "YYYY-MM"; false if `month`
+// is not one.
+bool monthPeriod(std::string_view month, StatementPeriod& out);
+
+struct StatementTotals
+{
+    double opening = 0.0;
+    double closing = 0.0;
+    double credits = 0.0;
+    double debits = 0.0;
+    size_t creditCount = 0;
+    size_t debitCount = 0;
+};
+
+void appendStatementHeader(std::string& out, int id, std::string_view owner, Currency currency,
+                           const StatementPeriod& period, double opening);
+// `effect` is the signed change to the balance, `balance` the result.
+void appendStatementLine(std::string& out, const Transaction& t, double effect, double balance);
+void appendStatementFooter(std::string& out, const StatementTotals& totals);
+
+// ========================================
+// StatementFile
+// ========================================
+
+// A shard being written: statements are appended to buffer() and go to
+// the file in writes of about STATEMENT_WRITE_CHUNK bytes.
+class StatementFile
+{
+private:
+    int fd = -1;
+    bool failed = false;
+    size_t written = 0;
+    std::string pending;
+
+    void writeOut();
+
+public:
+    static constexpr size_t STATEMENT_WRITE_CHUNK = 1 << 20;
+
+    explicit StatementFile(const std::string& path);
+    ~StatementFile();
+
+    StatementFile(const StatementFile&) = delete;
+    StatementFile& operator=(const StatementFile&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    std::string& buffer() { return pending; }
+    // Writes the buffer out once it holds a full chunk.
+    void flushIfFull()
+    {
+        if (pending.size() >= STATEMENT_WRITE_CHUNK)
+            writeOut();
+    }
+    // Writes what is left and closes the file; false if any write failed.
+    bool finish();
+    size_t bytesWritten() const { return written; }
+};
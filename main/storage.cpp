@@ -0,0 +1,433 @@
+#include "storage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+using namespace std;
+
+static const char CATALOGUE_MAGIC[8] = {'B', 'A', 'N', 'K', 'S', 'T', 'O', 'R'};
+static const char DWB_MAGIC[8] = {'B', 'A', 'N', 'K', 'D', 'W', 'B', '1'};
+static const uint32_t CATALOGUE_VERSION = 1;
+
+// Below this the pool cannot hold half a cache of dirty pages plus the
+// pins of a deep insert.
+static const size_t MIN_CACHE_PAGES = 64;
+
+// Page 0: this header, then one CatalogueTable per table.
+struct CatalogueHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t tableCount;
+    uint64_t checkpointSeq;
+};
+
+struct CatalogueTable
+{
+    uint64_t root;
+    uint64_t entries;
+    uint32_t valueSize;
+    uint32_t reserved;
+};
+
+static const size_t MAX_TABLES = (PAGE_SIZE - sizeof(CatalogueHeader)) / sizeof(CatalogueTable);
+
+// FNV-1a, to tell a complete .dwb file from a torn one.
+static uint64_t checksum(const char* data, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; ++i)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void appendHex(string& out, const char* data, size_t n)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        out += DIGITS[c >> 4];
+        out += DIGITS[c & 15];
+    }
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+StorageEngine::~StorageEngine()
+{
+    close();
+}
+
+// ========================================
+// Open and recovery
+// ========================================
+
+// The .dwb file: (u64 page, page image) per page, then u64 count,
+// u64 checksum of everything before it, and DWB_MAGIC.
+bool StorageEngine::restorePages()
+{
+    string dwbPath = path + ".dwb";
+    ifstream in(dwbPath, ios::binary | ios::ate);
+    if (!in.is_open())
+        return true;
+
+    string data(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(data.data(), static_cast<streamsize>(data.size()));
+    in.close();
+
+    const size_t RECORD = 8 + PAGE_SIZE;
+    const size_t TRAILER = 16 + sizeof(DWB_MAGIC);
+    bool complete = false;
+    uint64_t count = 0;
+    if (data.size() >= TRAILER && (data.size() - TRAILER) % RECORD == 0)
+    {
+        size_t body = data.size() - TRAILER;
+        uint64_t sum;
+        memcpy(&count, data.data() + body, 8);
+        memcpy(&sum, data.data() + body + 8, 8);
+        complete = count == body / RECORD && sum == checksum(data.data(), body)
+                   && memcmp(data.data() + body + 16, DWB_MAGIC, sizeof(DWB_MAGIC)) == 0;
+    }
+
+    // A torn file means the checkpoint never touched the page file.
+    if (complete)
+    {
+        PageFile target;
+        if (!target.open(path))
+            return false;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t page;
+            memcpy(&page, data.data() + i * RECORD, 8);
+            if (!target.write(page, data.data() + i * RECORD + 8))
+                return false;
+        }
+        if (!target.sync())
+            return false;
+        restoredCount = count;
+    }
+    remove(dwbPath.c_str());
+    return true;
+}
+
+bool StorageEngine::open(const string& p, const vector<size_t>& valueSizes, size_t cachePages)
+{
+    close();
+    if (valueSizes.empty() || valueSizes.size() > MAX_TABLES)
+        return false;
+    for (size_t size : valueSizes)
+    {
+        // A leaf must hold a few entries.
+        if (size == 0 || size > PAGE_SIZE / 4)
+            return false;
+    }
+
+    path = p;
+    replayedCount = restoredCount = 0;
+    if (!restorePages() || !file.open(path))
+        return false;
+
+    bool created = file.pageCount() == 0;
+    pool = make_unique<BufferPool>(file, max(cachePages, MIN_CACHE_PAGES), CachePolicy::Arc, false);
+    BufferPool::PageRef catalogue = created ? pool->allocate() : pool->fetch(0);
+    if (!catalogue || catalogue.page() != 0)
+    {
+        catalogue.release();
+        pool.reset();
+        file.close();
+        return false;
+    }
+
+    CatalogueHeader header;
+    memcpy(&header, catalogue.data(), sizeof(header));
+    bool valid = created
+                 || (memcmp(header.magic, CATALOGUE_MAGIC, sizeof(CATALOGUE_MAGIC)) == 0
+                     && header.version == CATALOGUE_VERSION && header.tableCount == valueSizes.size());
+    for (size_t t = 0; t < valueSizes.size() && valid; ++t)
+    {
+        CatalogueTable entry{};
+        if (!created)
+        {
+            memcpy(&entry, catalogue.data() + sizeof(header) + t * sizeof(entry), sizeof(entry));
+            valid = entry.valueSize == valueSizes[t];
+        }
+        tables.push_back(make_unique<BTree>(*pool, valueSizes[t], entry.root, entry.entries));
+    }
+    catalogue.release();
+    if (!valid)
+    {
+        tables.clear();
+        pool.reset();
+        file.close();
+        return false;
+    }
+    checkpointSeq = created ? 0 : header.checkpointSeq;
+
+    // Replay what the pages do not have yet. Nothing is appended to the
+    // log meanwhile, so a full cache only moves the pages forward.
+    unique_lock<shared_mutex> lock(engineMutex);
+    if (created)
+        writePages(0);
+    uint64_t last = checkpointSeq;
+    Journal::replay(path + ".wal", [&](uint64_t seq, const string& record) {
+        if (seq <= checkpointSeq)
+            return;
+        if (pagesFull())
+            writePages(last);
+        if (apply(record))
+            ++replayedCount;
+        last = seq;
+    });
+
+    if (!wal.open(path + ".wal"))
+    {
+        lock.unlock();
+        close();
+        return false;
+    }
+    wal.setLastSeq(last);
+    return true;
+}
+
+// "P|<table>|<key>|<hex value>" or "E|<table>|<key>".
+bool StorageEngine::apply(const string& record)
+{
+    if (record.size() < 5 || record[1] != '|')
+        return false;
+    const char* p = record.data() + 2;
+    const char* end = record.data() + record.size();
+
+    size_t table;
+    auto [afterTable, ec1] = from_chars(p, end, table);
+    if (ec1 != errc() || afterTable == end || *afterTable != '|' || table >= tables.size())
+        return false;
+    uint64_t key;
+    auto [afterKey, ec2] = from_chars(afterTable + 1, end, key);
+    if (ec2 != errc())
+        return false;
+
+    if (record[0] == 'E')
+        return afterKey == end && tables[table]->erase(key);
+
+    size_t valueSize = 0;
+    string value;
+    if (record[0] != 'P' || afterKey == end || *afterKey != '|')
+        return false;
+    valueSize = static_cast<size_t>(end - afterKey - 1) / 2;
+    value.resize(valueSize);
+    for (size_t i = 0; i < valueSize; ++i)
+    {
+        int hi = hexDigit(afterKey[1 + 2 * i]);
+        int lo = hexDigit(afterKey[2 + 2 * i]);
+        if (hi < 0 || lo < 0)
+            return false;
+        value[i] = static_cast<char>(hi << 4 | lo);
+    }
+    return tables[table]->put(key, value.data());
+}
+
+void StorageEngine::close()
+{
+    if (!pool)
+        return;
+    {
+        unique_lock<shared_mutex> lock(engineMutex);
+        if (wal.isOpen())
+            checkpointLocked();
+    }
+    wal.close();
+    tables.clear();
+    pool.reset();
+    file.close();
+}
+
+// ========================================
+// Checkpoints
+// ========================================
+
+bool StorageEngine::writeCatalogue(uint64_t seq)
+{
+    BufferPool::PageRef catalogue = pool->fetch(0);
+    if (!catalogue)
+        return false;
+
+    unique_lock<shared_mutex> latch(catalogue.latch());
+    CatalogueHeader header;
+    memcpy(header.magic, CATALOGUE_MAGIC, sizeof(CATALOGUE_MAGIC));
+    header.version = CATALOGUE_VERSION;
+    header.tableCount = static_cast<uint32_t>(tables.size());
+    header.checkpointSeq = seq;
+    memcpy(catalogue.data(), &header, sizeof(header));
+    for (size_t t = 0; t < tables.size(); ++t)
+    {
+        CatalogueTable entry{};
+        entry.root = tables[t]->root();
+        entry.entries = tables[t]->size();
+        entry.valueSize = static_cast<uint32_t>(tables[t]->valueBytes());
+        memcpy(catalogue.data() + sizeof(header) + t * sizeof(entry), &entry, sizeof(entry));
+    }
+    catalogue.markDirty();
+    return true;
+}
+
+bool StorageEngine::writePages(uint64_t seq)
+{
+    if (!writeCatalogue(seq))
+        return false;
+
+    vector<pair<uint64_t, string>> images;
+    pool->copyDirty(images);
+
+    // First every image, synced, where a crash cannot tear them...
+    string dwb;
+    dwb.reserve(images.size() * (8 + PAGE_SIZE) + 16 + sizeof(DWB_MAGIC));
+    for (const auto& [page, image] : images)
+    {
+        dwb.append(reinterpret_cast<const char*>(&page), 8);
+        dwb += image;
+    }
+    uint64_t count = images.size();
+    uint64_t sum = checksum(dwb.data(), dwb.size());
+    dwb.append(reinterpret_cast<const char*>(&count), 8);
+    dwb.append(reinterpret_cast<const char*>(&sum), 8);
+    dwb.append(DWB_MAGIC, sizeof(DWB_MAGIC));
+
+    string dwbPath = path + ".dwb";
+    int fd = ::open(dwbPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    size_t done = 0;
+    while (done < dwb.size())
+    {
+        ssize_t n = ::write(fd, dwb.data() + done, dwb.size() - done);
+        if (n < 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    bool synced = fdatasync(fd) == 0;
+    ::close(fd);
+    if (!synced)
+        return false;
+
+    // ...then in place.
+    if (!pool->flush())
+        return false;
+    remove(dwbPath.c_str());
+    checkpointSeq = seq;
+    return true;
+}
+
+bool StorageEngine::checkpointLocked()
+{
+    auto start = chrono::steady_clock::now();
+    wal.flush();
+    uint64_t seq = wal.lastSeq();
+    if (!writePages(seq))
+        return false;
+    wal.truncate();
+
+    ++checkpointCount;
+    lastCheckpointMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool StorageEngine::pagesFull() const
+{
+    return pool->dirtyPages() * 2 >= pool->frameCount();
+}
+
+bool StorageEngine::checkpoint()
+{
+    unique_lock<shared_mutex> lock(engineMutex);
+    return pool && checkpointLocked();
+}
+
+// ========================================
+// Operations
+// ========================================
+
+bool StorageEngine::get(size_t table, uint64_t key, char* value) const
+{
+    shared_lock<shared_mutex> lock(engineMutex);
+    return pool && table < tables.size() && tables[table]->get(key, value);
+}
+
+bool StorageEngine::put(size_t table, uint64_t key, const char* value)
+{
+    unique_lock<shared_mutex> lock(engineMutex);
+    if (!pool || table >= tables.size())
+        return false;
+    if (pagesFull() && !checkpointLocked())
+        return false;
+
+    string record = "P|" + to_string(table) + "|" + to_string(key) + "|";
+    appendHex(record, value, tables[table]->valueBytes());
+    wal.append(record);
+    return tables[table]->put(key, value);
+}
+
+bool StorageEngine::erase(size_t table, uint64_t key)
+{
+    unique_lock<shared_mutex> lock(engineMutex);
+    if (!pool || table >= tables.size())
+        return false;
+    if (pagesFull() && !checkpointLocked())
+        return false;
+
+    wal.append("E|" + to_string(table) + "|" + to_string(key));
+    return tables[table]->erase(key);
+}
+
+bool StorageEngine::scan(size_t table, uint64_t from, uint64_t to,
+                         const function<bool(uint64_t, const char*)>& fn) const
+{
+    shared_lock<shared_mutex> lock(engineMutex);
+    return pool && table < tables.size() && tables[table]->scan(from, to, fn);
+}
+
+uint64_t StorageEngine::size(size_t table) const
+{
+    shared_lock<shared_mutex> lock(engineMutex);
+    return pool && table < tables.size() ? tables[table]->size() : 0;
+}
+
+uint64_t StorageEngine::sync()
+{
+    return wal.flush();
+}
+
+StorageStats StorageEngine::stats() const
+{
+    shared_lock<shared_mutex> lock(engineMutex);
+    StorageStats s;
+    s.checkpoints = checkpointCount;
+    s.lastCheckpointMs = lastCheckpointMs;
+    s.replayed = replayedCount;
+    s.restoredPages = restoredCount;
+    if (pool)
+        s.cache = pool->stats();
+    return s;
+}
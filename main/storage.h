@@ -0,0 +1,123 @@
+/*
+    Storage engine
+    --------------------------------
+    Tables of B+trees (btree.h) in one page file, behind a buffer pool
+    and a write-ahead log. Data stays on disk: opening a store reads
+    only the log written since the last checkpoint, not the data, and
+    memory use is bounded by the cache size.
+
+    Files, for a store at <path>:
+
+        <path>          the pages; page 0 is the catalogue (each
+                        table's root and size, and the log sequence
+                        number the pages are consistent with)
+        <path>.wal      puts and erases since the last checkpoint, as
+                        Journal records (journal.h)
+        <path>.dwb      page images of a checkpoint in progress
+
+    Every put and erase is logged before the tree changes; sync() makes
+    everything logged so far durable with one fdatasync. The page file
+    changes only at a checkpoint, since the pool runs without steal. A
+    checkpoint writes all dirty pages to the .dwb file and syncs it,
+    writes them in place and syncs, then clears the log. If one is
+    interrupted, open() rewrites the pages from a complete .dwb file
+    (or ignores a torn one) and replays the log from the last
+    checkpoint. A checkpoint also runs by itself once half the cache is
+    dirty, and on close().
+
+    For a bank: accounts in one table keyed by id, and history in
+    another keyed by historyKey(id, seq), which keeps each account's
+    transactions together and in order for scan().
+
+    Thread safety: get, scan and sync may run together from any number
+    of threads; put, erase and checkpoint run alone.
+*/
+
+#pragma once
+
+#include "btree.h"
+#include "journal.h"
+#include "pagestore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+inline uint64_t historyKey(int id, uint32_t seq)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(id)) << 32) | seq;
+}
+
+struct StorageStats
+{
+    uint64_t checkpoints = 0;
+    double lastCheckpointMs = 0.0;
+    // Log records applied by the last open().
+    uint64_t replayed = 0;
+    // Pages restored from an interrupted checkpoint by the last open().
+    uint64_t restoredPages = 0;
+    BufferPoolStats cache;
+};
+
+class StorageEngine
+{
+private:
+    std::string path;
+    PageFile file;
+    std::unique_ptr<BufferPool> pool;
+    std::vector<std::unique_ptr<BTree>> tables;
+    Journal wal;
+    uint64_t checkpointSeq = 0;
+    mutable std::shared_mutex engineMutex;
+
+    uint64_t checkpointCount = 0;
+    double lastCheckpointMs = 0.0;
+    uint64_t replayedCount = 0;
+    uint64_t restoredCount = 0;
+
+    bool restorePages();
+    bool apply(const std::string& record);
+    // Require engineMutex held exclusively.
+    bool writeCatalogue(uint64_t seq);
+    // Moves the page file forward to log sequence `seq`.
+    bool writePages(uint64_t seq);
+    bool checkpointLocked();
+    bool pagesFull() const;
+
+public:
+    StorageEngine() = default;
+    ~StorageEngine();
+
+    StorageEngine(const StorageEngine&) = delete;
+    StorageEngine& operator=(const StorageEngine&) = delete;
+
+    // Opens or creates the store at `path` with one table per entry of
+    // `valueSizes` (bytes per value), caching up to `cachePages` pages.
+    // False if the files cannot be opened or hold different tables.
+    bool open(const std::string& path, const std::vector<size_t>& valueSizes, size_t cachePages);
+    // Checkpoints and closes.
+    void close();
+    bool isOpen() const { return pool != nullptr; }
+
+    // Copies the value for `key` into `value`; false if absent.
+    bool get(size_t table, uint64_t key, char* value) const;
+    // Inserts or replaces. False on a bad table or an I/O error.
+    bool put(size_t table, uint64_t key, const char* value);
+    bool erase(size_t table, uint64_t key);
+    // Calls fn(key, value) for each key in [from, to], in order, until
+    // it returns false.
+    bool scan(size_t table, uint64_t from, uint64_t to,
+              const std::function<bool(uint64_t, const char*)>& fn) const;
+    uint64_t size(size_t table) const;
+
+    // Makes every put and erase so far durable. Returns the last
+    // durable log sequence number.
+    uint64_t sync();
+    bool checkpoint();
+
+    StorageStats stats() const;
+};
@@ -0,0 +1,152 @@
+#include "textformat.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static string_view trimLineEnd(string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    return line;
+}
+
+// The whole of `field` must be the number.
+template <typename T>
+static bool parseNumber(string_view field, T& out)
+{
+    if (field.empty())
+        return false;
+    const char* end = field.data() + field.size();
+    auto r = from_chars(field.data(), end, out);
+    return r.ec == errc() && r.ptr == end;
+}
+
+const char* parseAccountHeader(string_view line, AccountHeader& out)
+{
+    line = trimLineEnd(line);
+
+    size_t idEnd = line.find(';');
+    if (idEnd == string_view::npos)
+        return "account header has no ';' separators";
+    if (!parseNumber(line.substr(0, idEnd), out.id))
+        return "account id is not an integer";
+
+    size_t ownerEnd = line.find(';', idEnd + 1);
+    if (ownerEnd == string_view::npos)
+        return "account header has no balance";
+    out.owner = line.substr(idEnd + 1, ownerEnd - idEnd - 1);
+
+    // Files written before multi-currency support have no currency
+    // field; those balances are USD.
+    size_t balanceEnd = line.find(';', ownerEnd + 1);
+    string_view balance = line.substr(ownerEnd + 1, balanceEnd == string_view::npos
+                                                        ? string_view::npos
+                                                        : balanceEnd - ownerEnd - 1);
+    if (!parseNumber(balance, out.balance) || !isfinite(out.balance))
+        return "account balance is not a number";
+
+    out.currency = Currency::USD;
+    if (balanceEnd != string_view::npos && !parseCurrency(line.substr(balanceEnd + 1), out.currency))
+        return "unknown currency";
+    return nullptr;
+}
+
+const char* parseTransactionLine(string_view line, TransactionFields& out)
+{
+    line = trimLineEnd(line);
+
+    size_t timeEnd = line.find('|');
+    if (timeEnd == string_view::npos || timeEnd == 0)
+        return "transaction has no timestamp";
+    size_t typeEnd = line.find('|', timeEnd + 1);
+    if (typeEnd == string_view::npos || typeEnd == timeEnd + 1)
+        return "transaction has no type";
+
+    out.timestamp = line.substr(0, timeEnd);
+    out.type = line.substr(timeEnd + 1, typeEnd - timeEnd - 1);
+    if (!parseNumber(line.substr(typeEnd + 1), out.amount) || !isfinite(out.amount))
+        return "transaction amount is not a number";
+    return nullptr;
+}
+
+void appendNumber(string& out, double value)
+{
+    char buf[32];
+    auto r = to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, r.ptr);
+}
+
+// ========================================
+// SnapshotReader
+// ========================================
+
+bool SnapshotReader::peekLine(string_view& line, size_t& next) const
+{
+    if (pos >= data.size())
+        return false;
+    const char* start = data.data() + pos;
+    const char* eol = static_cast<const char*>(memchr(start, '\n', data.size() - pos));
+    size_t len = eol ? static_cast<size_t>(eol - start) : data.size() - pos;
+    line = trimLineEnd(string_view(start, len));
+    next = pos + len + (eol ? 1 : 0);
+    return true;
+}
+
+SnapshotReader::Status SnapshotReader::next(Block& block, ParseError& error)
+{
+    string_view line;
+    size_t after;
+
+    // Skip to the next header.
+    while (true)
+    {
+        if (!peekLine(line, after))
+            return Status::End;
+        if (!line.empty() && line.compare(0, 5, "#seq ") != 0)
+            break;
+        if (!line.empty())
+            parseNumber(line.substr(5), seqValue);
+        pos = after;
+        ++lineNumber;
+    }
+
+    block = Block();
+    block.line = ++lineNumber;
+    block.begin = pos;
+    const char* problem = parseAccountHeader(line, block.account);
+    error = {block.line, pos, problem ? problem : ""};
+    pos = after;
+    block.historyBegin = pos;
+
+    while (true)
+    {
+        if (!peekLine(line, after))
+        {
+            block.historyEnd = block.end = pos;
+            if (!problem)
+                error = {lineNumber + 1, pos, "account block is cut off before END"};
+            return Status::Corrupt;
+        }
+        if (line == "END")
+        {
+            block.historyEnd = pos;
+            block.end = after;
+            pos = after;
+            ++lineNumber;
+            return problem ? Status::Corrupt : Status::Block;
+        }
+        if (!line.empty() && line.compare(0, 2, "T:") != 0)
+        {
+            // Leave this line for the next block.
+            block.historyEnd = block.end = pos;
+            if (!problem)
+                error = {lineNumber + 1, pos, "account block is not terminated by END"};
+            return Status::Corrupt;
+        }
+        pos = after;
+        ++lineNumber;
+    }
+}
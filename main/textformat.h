@@ -0,0 +1,107 @@
+/*
+    Snapshot text format
+    --------------------------------
+    A snapshot (Bank::save) is line-based text:
+
+        #seq <last journal record included>
+        <id>;<owner>;<balance>[;<currency>]
+        T:<timestamp>|<type>|<amount>
+        ...
+        END
+
+    The parsers here work on string_views into the file, allocate
+    nothing, and report what is wrong instead of throwing, so one bad
+    line costs one account (or one transaction) rather than the load.
+    Lines may end in "\r\n".
+*/
+
+#pragma once
+
+#include "currency.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Where a snapshot stops making sense. `line` is 1-based and `offset`
+// is the byte offset of that line's start.
+struct ParseError
+{
+    size_t line = 0;
+    size_t offset = 0;
+    const char* message = "";
+};
+
+struct AccountHeader
+{
+    int id = 0;
+    std::string_view owner;
+    double balance = 0.0;
+    Currency currency = Currency::USD;
+};
+
+struct TransactionFields
+{
+    std::string_view timestamp;
+    std::string_view type;
+    double amount = 0.0;
+};
+
+// Each returns nullptr on success or a description of the problem.
+const char* parseAccountHeader(std::string_view line, AccountHeader& out);
+// `line` is what follows "T:".
+const char* parseTransactionLine(std::string_view line, TransactionFields& out);
+
+// Appends the shortest text that reads back as exactly `value`.
+void appendNumber(std::string& out, double value);
+
+// ========================================
+// SnapshotReader
+// ========================================
+
+// One pass over a whole snapshot, block by block. History lines are
+// only checked for their "T:" prefix here (blank lines are allowed);
+// their fields are parsed when the history is loaded.
+class SnapshotReader
+{
+public:
+    struct Block
+    {
+        AccountHeader account;
+        // Line number of the header; the history starts on the next.
+        size_t line = 0;
+        // The whole block, END line included, and its history lines.
+        size_t begin = 0;
+        size_t end = 0;
+        size_t historyBegin = 0;
+        size_t historyEnd = 0;
+    };
+
+    enum class Status
+    {
+        Block,
+        // A block with an unreadable header or no END line. `block`
+        // still gives its extent, and reading resumes after it: a line
+        // that is neither history nor END starts the next block.
+        Corrupt,
+        End
+    };
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+    size_t lineNumber = 0;
+    uint64_t seqValue = 0;
+
+    // The line at `pos` without its terminator; false at the end.
+    bool peekLine(std::string_view& line, size_t& next) const;
+
+public:
+    explicit SnapshotReader(std::string_view data) : data(data) {}
+
+    Status next(Block& block, ParseError& error);
+
+    // From the "#seq" line, once next() has passed it.
+    uint64_t seq() const { return seqValue; }
+};